@@ -0,0 +1,324 @@
+/*
+Microbenchmark of the storage engines of the server (motor.h), linked directly against
+libserverclaves.so (without sockets).
+For each dataset size the store is pre-populated and then exist(), get_value(), set_value(),
+modify_value() and delete_key() are timed separately. For each operation it reports ns/op,
+ops/s, latency percentiles and the bytes written per operation, and optionally (-c) the mean of the
+perf counters (cycles, instructions, cache misses, branch misses, context switches) per operation.
+With a tuple cache budget (-m, text engine only) it also reports the tuples cached and evicted, and the evictions and
+faults of each operation.
+The store of the engine (-e, text by default) is created in the current directory (or in the one given
+with -d), so any previous tuplas.txt (or tuplas_lsm) there is overwritten.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include "funciones_servidor/funciones_servidor.h"
+#include "funciones_servidor/motor.h"
+#include "funciones_histograma/funciones_histograma.h"
+#include "funciones_perf/funciones_perf.h"
+#include "funciones_dobles/funciones_dobles.h"
+
+#define N_OPS 5
+#define MAX_SIZES 16
+
+enum BENCH_OP {BENCH_EXIST, BENCH_GET, BENCH_SET, BENCH_MODIFY, BENCH_DELETE};
+const char *op_names[N_OPS] = {"exist", "get_value", "set_value", "modify_value", "delete_key"};
+
+long sizes[MAX_SIZES] = {1000, 100000, 10000000};   // Number of records of each dataset
+int n_sizes = 3;
+long max_iterations = 1000;     // Maximum number of calls timed for each operation
+double max_seconds = 2.0;       // Maximum time spent timing each operation
+int n_value2 = 8;               // Number of elements of V_value2 of each record
+int perf = 0;                   // Read the perf counters around each call
+double max_memory = 0.0;        // Memory budget of the tuples in memory (MiB, 0 if there is no limit)
+const Motor *engine;            // Storage engine measured
+ContadoresPerf counters;
+
+uint64_t rng = 88172645463325252ull;
+
+uint64_t now_ns(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+uint64_t next_random(){
+    // xorshift64*
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    return rng * 2685821657736338717ull;
+}
+
+long bytes_written(){
+    // Bytes passed to write() by this process so far (wchar in /proc/self/io), or -1 if it is not available
+    FILE *file = fopen("/proc/self/io", "r");
+    if (file == NULL){
+        return -1;
+    }
+    char line[128];
+    long wchar = -1;
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        if (sscanf(line, "wchar: %ld", &wchar) == 1){
+            break;
+        }
+    }
+    fclose(file);
+    return wchar;
+}
+
+void fill_value(long key, char *value1, double *V_value2){
+    sprintf(value1, "value_%ld", key);
+    for (int i = 0; i < n_value2; i++)
+    {
+        V_value2[i] = (double)(next_random() % 1000000) / 1000.0;
+    }
+}
+
+int populate(long size){
+    if (engine->init() < 0){
+        return -1;
+    }
+    char value1[256];
+    double V_value2[32];
+    if (strcmp(engine->name, "text") != 0){
+        for (long key = 0; key < size; key++)
+        {
+            fill_value(key, value1, V_value2);
+            if (engine->set_value(key, value1, n_value2, V_value2) < 0){
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    // Write the records 0 .. size - 1 directly in the format of FILE_NAME (inserting them one by one
+    // with set_value() would read the whole file for each of them)
+    FILE *file = fopen(FILE_NAME, "w");
+    if (file == NULL){
+        perror("Error creating the file\n");
+        return -1;
+    }
+    for (long key = 0; key < size; key++)
+    {
+        fill_value(key, value1, V_value2);
+        fprintf(file, "%ld %s %d", key, value1, n_value2);
+        for (int i = 0; i < n_value2; i++)
+        {
+            char value[DOBLES_MAX_LEN];
+            dobles_format(V_value2[i], value);
+            fprintf(file, " %s", value);
+        }
+        fprintf(file, "\n");
+    }
+    fclose(file);
+
+    // The first call reads the new file (it rebuilds the in-memory indexes), so it is not timed
+    return engine->exist(0) == 1 ? 0 : -1;
+}
+
+int run_op(int op, long key){
+    char value1[256];
+    int N_value2;
+    double V_value2[32];
+
+    switch (op)
+    {
+        case BENCH_EXIST:
+            return engine->exist(key) == 1 ? 0 : -1;
+        case BENCH_GET:
+            return engine->get_value(key, value1, &N_value2, V_value2);
+        case BENCH_SET:
+        case BENCH_MODIFY:
+            fill_value(key, value1, V_value2);
+            return op == BENCH_SET ? engine->set_value(key, value1, n_value2, V_value2)
+                                   : engine->modify_value(key, value1, n_value2, V_value2);
+        default:
+            return engine->delete_key(key);
+    }
+}
+
+void bench_size(long size){
+    printf("\n%ld records\n", size);
+    uint64_t start = now_ns();
+    if (populate(size) < 0){
+        printf("Error populating the store\n");
+        return;
+    }
+    printf("Populated in %.2f s\n", (now_ns() - start) / 1e9);
+    NivelesTuplas tiers;
+    if (max_memory > 0.0){
+        get_tiers(&tiers);
+        printf("Tuples in memory: %ld (%.1f MiB of %.1f MiB), in the file only: %ld\n", tiers.hot,
+               tiers.hot_bytes / 1048576.0, tiers.max_bytes / 1048576.0, tiers.cold);
+    }
+    printf("%-14s %10s %14s %12s %12s %12s %14s", "op", "calls", "ns/op", "ops/s", "p50(ns)", "p99(ns)", "bytes/op");
+    if (max_memory > 0.0){
+        printf(" %10s %10s", "evictions", "faults");
+    }
+    for (int i = 0; perf && i < PERF_N_COUNTERS; i++)
+    {
+        printf(" %16s", perf_counter_names[i]);
+    }
+    printf("\n");
+
+    long inserted = 0;  // Keys size .. size + inserted - 1 have been added by set_value()
+    for (int op = 0; op < N_OPS; op++)
+    {
+        Histograma latency;
+        histograma_init(&latency);
+        AcumuladorPerf perf_op;
+        perf_acc_init(&perf_op);
+        long errors = 0;
+        NivelesTuplas tiers_start;
+        get_tiers(&tiers_start);
+        long written = bytes_written();
+        uint64_t op_start = now_ns();
+        long calls = 0;
+
+        while (calls < max_iterations && (now_ns() - op_start) < max_seconds * 1e9)
+        {
+            // exist, get and modify use existing keys; set adds new ones, which delete removes afterwards
+            long key;
+            if (op == BENCH_SET){
+                key = size + calls;
+            } else if (op == BENCH_DELETE){
+                if (calls >= inserted){
+                    break;
+                }
+                key = size + calls;
+            } else {
+                key = next_random() % size;
+            }
+
+            LecturaPerf perf_start, perf_end;
+            if (perf){
+                perf_read(&counters, &perf_start);
+            }
+            uint64_t t0 = now_ns();
+            if (run_op(op, key) < 0){
+                errors++;
+            }
+            histograma_record(&latency, now_ns() - t0);
+            if (perf){
+                perf_read(&counters, &perf_end);
+                perf_acc_add(&perf_op, &perf_start, &perf_end);
+            }
+            calls++;
+        }
+        if (op == BENCH_SET){
+            inserted = calls;
+        }
+
+        double elapsed = (now_ns() - op_start) / 1e9;
+        long written_after = bytes_written();
+        printf("%-14s %10ld %14.0f %12.1f %12lu %12lu %14.0f", op_names[op], calls, histograma_mean(&latency),
+               calls / elapsed, (unsigned long)histograma_percentile(&latency, 50),
+               (unsigned long)histograma_percentile(&latency, 99),
+               written >= 0 && calls > 0 ? (double)(written_after - written) / calls : -1.0);
+        if (max_memory > 0.0){
+            get_tiers(&tiers);
+            printf(" %10ld %10ld", tiers.evictions - tiers_start.evictions, tiers.faults - tiers_start.faults);
+        }
+        for (int i = 0; perf && i < PERF_N_COUNTERS; i++)
+        {
+            if (perf_available(&counters, i)){
+                printf(" %16.1f", perf_acc_mean(&perf_op, i));
+            } else {
+                printf(" %16s", "n/a");
+            }
+        }
+        if (errors > 0){
+            printf("  (%ld errors)", errors);
+        }
+        printf("\n");
+    }
+}
+
+void usage(char *program){
+    printf("Usage: %s [options]\n", program);
+    printf("Options:\n");
+    printf("  -s <n1,n2,...>        dataset sizes (default 1000,100000,10000000)\n");
+    printf("  -i <calls>            maximum calls timed per operation (default %ld)\n", max_iterations);
+    printf("  -t <seconds>          maximum time per operation (default %.0f)\n", max_seconds);
+    printf("  -n <elements>         number of elements of V_value2 [1-32] (default %d)\n", n_value2);
+    printf("  -d <directory>        directory where the store is created (default current directory)\n");
+    printf("  -c                    report the mean of the perf counters per operation\n");
+    printf("  -m <MiB>              memory for the tuples cached by the text engine, not its indexes (default no limit)\n");
+    printf("  -e <engine>           storage engine: text, memory or lsm (default text)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    engine = motor_find("text");
+    int option;
+    while ((option = getopt(argc, argv, "s:i:t:n:d:cm:e:h")) != -1){
+        switch (option){
+            case 's':
+                n_sizes = 0;
+                for (char *token = strtok(optarg, ","); token != NULL && n_sizes < MAX_SIZES; token = strtok(NULL, ","))
+                {
+                    sizes[n_sizes++] = atol(token);
+                }
+                break;
+            case 'i': max_iterations = atol(optarg); break;
+            case 't': max_seconds = atof(optarg); break;
+            case 'n': n_value2 = atoi(optarg); break;
+            case 'c': perf = 1; break;
+            case 'm': max_memory = atof(optarg); break;
+            case 'e':
+                if ((engine = motor_find(optarg)) == NULL){
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'd':
+                if (chdir(optarg) != 0){
+                    perror("Error changing the directory\n");
+                    return -1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return -1;
+        }
+    }
+
+    if (n_sizes == 0 || max_iterations < 1 || max_seconds <= 0.0 || n_value2 < 1 || n_value2 > 32 || max_memory < 0.0 ||
+        (max_memory > 0.0 && strcmp(engine->name, "text") != 0)){
+        usage(argv[0]);
+        return -1;
+    }
+    for (int i = 0; i < n_sizes; i++)
+    {
+        if (sizes[i] < 1){
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (perf && perf_open(&counters) == 0){
+        printf("No perf counter is available (see /proc/sys/kernel/perf_event_paranoid)\n");
+        perf = 0;
+    }
+
+    set_max_memory((long)(max_memory * 1024 * 1024));
+    if (engine->open(NULL) < 0){
+        printf("Error opening the %s storage engine\n", engine->name);
+        return -1;
+    }
+    printf("Storage engine: %s (%s)\n", engine->name, engine->default_path != NULL ? engine->default_path : "no file");
+    for (int i = 0; i < n_sizes; i++)
+    {
+        bench_size(sizes[i]);
+    }
+    return 0;
+}
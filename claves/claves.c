@@ -8,8 +8,9 @@ Code that implements the functions defined in claves.h
 char* PORT_TUPLAS;  // Port where the server is listening
 char* IP_TUPLAS;    // IP where the server is listening
 
-struct sockaddr_in server_addr = {0};  // Server and client addresses
-int sd;                                // Server socket descriptor
+// The connection state is per thread, so that several threads can use the library at the same time
+__thread struct sockaddr_in server_addr = {0};  // Server and client addresses
+__thread int sd;                                // Server socket descriptor
 
 /*
 * Maximum size of a request message in a string:
@@ -29,12 +30,21 @@ int sd;                                // Server socket descriptor
 
 * Note:
 * A positive int requires a maximum of 12 characters
-* A double requires a maximum of 325 characters
+* A double requires a maximum of 325 characters with %f, but dobles_format() writes at most 31, so the optional
+* TTL of set_value_ttl() and modify_value_ttl() (1 space + 12 chars) always fits
 */
-char buffer[10706];                                 // Buffer for the messages
+__thread char buffer[10706];                        // Buffer for the messages (one per thread)
+__thread char *saveptr;                             // State of strtok_r() while parsing a response (one per thread)
 
 
 
+void append_double(char *buffer, double value) {
+    // Append " value" to the buffer, with the shortest text that converts back to exactly the same value
+    int len = strlen(buffer);
+    buffer[len] = ' ';
+    dobles_format(value, buffer + len + 1);
+}
+
 int get_env_variables() {
     PORT_TUPLAS = getenv("PORT_TUPLAS");
     IP_TUPLAS = getenv("IP_TUPLAS");
@@ -58,14 +68,13 @@ int establish_socket_connection() {
     // Get the environment variables for the PORT and the IP of the server
     if (get_env_variables() < 0) { return -1; }
 
-    if (strcmp(IP_TUPLAS, "localhost") == 0) {
-        strcpy(IP_TUPLAS, LOCALHOST);
-    }
+    // Translate localhost (without modifying the environment, which is shared by all the threads)
+    char *ip = strcmp(IP_TUPLAS, "localhost") == 0 ? LOCALHOST : IP_TUPLAS;
 
     // Fill the server address
     server_addr.sin_family = AF_INET;   // IPv4
     server_addr.sin_port = htons(atoi(PORT_TUPLAS));    // htons: host to network short (translates from host little-endian to network big-endian byte order)
-    server_addr.sin_addr.s_addr = inet_addr(IP_TUPLAS);
+    server_addr.sin_addr.s_addr = inet_addr(ip);
 
     // Connect to the server
     int retries = 0;
@@ -136,6 +145,11 @@ int init(){
 }
 
 int set_value(int key, char *value1, int N_value2, double *V_value2){
+    // Almacena la tupla sin tiempo de vida
+    return set_value_ttl(key, value1, N_value2, V_value2, 0);
+}
+
+int set_value_ttl(int key, char *value1, int N_value2, double *V_value2, int ttl_ms){
     // Almacena la tupla (key, value1, value2) en el servicio de elementos clave-valor1-valor2
     // Si ya existía una tupla con clave key, se sobreescribe con la nueva tupla
     // Devuelve 0 en caso de éxito y -1 en caso de error.
@@ -162,6 +176,11 @@ int set_value(int key, char *value1, int N_value2, double *V_value2){
         return -1;
     }
 
+    // If the time to live is negative, we return -1 (0 means no time to live)
+    if (ttl_ms < 0){
+        return -1;
+    }
+
     // Establish the connection
     int error = establish_socket_connection();
     if (error < 0) { return error; }
@@ -171,7 +190,12 @@ int set_value(int key, char *value1, int N_value2, double *V_value2){
 
     // Add the values of the vector V_value2 to the buffer next to the N_value2
     for (int i = 0; i < N_value2; i++) {
-        sprintf(buffer + strlen(buffer), " %lf", V_value2[i]);
+        append_double(buffer, V_value2[i]);
+    }
+
+    // Add the time to live, if any, after the vector
+    if (ttl_ms > 0) {
+        sprintf(buffer + strlen(buffer), " %d", ttl_ms);
     }
 
     // Send the message
@@ -241,7 +265,7 @@ int get_value(int key, char *value1, int *N_value2, double *V_value2){
     close(sd);
 
     // Parse the response
-    char *token = strtok(buffer, " ");  // Split the buffer into tokens separated by spaces
+    char *token = strtok_r(buffer, " ", &saveptr);  // Split the buffer into tokens separated by spaces
     int res = atoi(token);
 
     // If the response is an error, we return -1 without copying the values
@@ -250,17 +274,17 @@ int get_value(int key, char *value1, int *N_value2, double *V_value2){
     }
 
     // Copy the value1
-    token = strtok(NULL, " ");  // Get the next token
+    token = strtok_r(NULL, " ", &saveptr);  // Get the next token
     strcpy(value1, token);
 
     // Copy the N_value2
-    token = strtok(NULL, " ");
+    token = strtok_r(NULL, " ", &saveptr);
     *N_value2 = atoi(token);
 
     // Copy the V_value2
     for (int i = 0; i < *N_value2; i++) {
-        token = strtok(NULL, " ");
-        V_value2[i] = atof(token);  // Convert the token to a double
+        token = strtok_r(NULL, " ", &saveptr);
+        V_value2[i] = dobles_parse(token, NULL);  // Convert the token to a double
     }
 
     // Clean the buffer
@@ -271,6 +295,11 @@ int get_value(int key, char *value1, int *N_value2, double *V_value2){
 }
 
 int modify_value(int key, char *value1, int N_value2, double *V_value2){
+    // Modifica la tupla y le quita el tiempo de vida, si lo tenía
+    return modify_value_ttl(key, value1, N_value2, V_value2, 0);
+}
+
+int modify_value_ttl(int key, char *value1, int N_value2, double *V_value2, int ttl_ms){
     // Modifica los valores asociados a la clave key
     // Devuelve 0 en caso de éxito y -1 en caso de error, por ejemplo, si no existe un elemento con dicha clave o si se
     // produce un error en las comunicaciones. También se devolverá -1 si el valor N_value2 está fuera
@@ -298,6 +327,11 @@ int modify_value(int key, char *value1, int N_value2, double *V_value2){
         return -1;
     }
 
+    // If the time to live is negative, we return -1 (0 means no time to live)
+    if (ttl_ms < 0){
+        return -1;
+    }
+
     // Establish the connection
     int error = establish_socket_connection();
     if (error < 0) { return error; }
@@ -307,7 +341,12 @@ int modify_value(int key, char *value1, int N_value2, double *V_value2){
 
     // Add the values of the vector V_value2 to the buffer next to the N_value2
     for (int i = 0; i < N_value2; i++) {
-        sprintf(buffer + strlen(buffer), " %lf", V_value2[i]);
+        append_double(buffer, V_value2[i]);
+    }
+
+    // Add the time to live, if any, after the vector
+    if (ttl_ms > 0) {
+        sprintf(buffer + strlen(buffer), " %d", ttl_ms);
     }
 
     // Send the message
@@ -405,3 +444,723 @@ int exist(int key){
     // Return the response
     return res;
 }
+
+int get_fields(int key, int mask, int first, int count, char *value1, int *N_value2, double *V_value2, int *N_slice){
+    // Obtiene solo los campos indicados en mask de la tupla asociada a la clave key
+    // Devuelve 0 en caso de éxito y -1 en caso de error, por ejemplo, si no existe un elemento con dicha clave o si se
+    // produce un error de comunicaciones.
+
+    // Handling errors in arguments
+
+    // If no field is requested or the slice is not valid, we return -1
+    if (mask <= 0 || mask > (FIELD_VALUE1 | FIELD_N_VALUE2 | FIELD_V_VALUE2) || first < 0){
+        return -1;
+    }
+
+    // If a requested output argument is NULL, we return -1
+    if (((mask & FIELD_VALUE1) && value1 == NULL) || ((mask & FIELD_N_VALUE2) && N_value2 == NULL) ||
+        ((mask & FIELD_V_VALUE2) && (V_value2 == NULL || N_slice == NULL))){
+        return -1;
+    }
+
+    // Establish the connection
+    int error = establish_socket_connection();
+    if (error < 0) { return error; }
+
+    // Copy the Get_fields operation code, the key, the mask and the slice to the buffer
+    sprintf(buffer, "%d %d %d %d %d", GET_FIELDS, key, mask, first, count);
+
+    // Send the message
+    if (sendMessage(sd, buffer, (strlen(buffer) + 1)) < 0) {
+        perror("Error sending the message\n");
+        return -1;
+    }
+
+    // Receive the response
+    // The response is as follows (only the requested fields are sent):
+    // error_code [value1] [N_value2] [N_slice V_value2[first] ... V_value2[first + N_slice - 1]]
+    // It is never longer than the response of get_value() (10695 characters)
+    if (readLine(sd, buffer, 10695) < 0) {
+        perror("Error receiving the message\n");
+        return -1;
+    }
+
+    // Close the socket
+    close(sd);
+
+    // Parse the response
+    char *token = strtok_r(buffer, " ", &saveptr);
+    if (token == NULL) {
+        return -1;
+    }
+    int res = atoi(token);
+
+    // If the response is an error, we return -1 without copying the values
+    if (res == -1) {
+        return -1;
+    }
+
+    // Copy the value1
+    if (mask & FIELD_VALUE1) {
+        token = strtok_r(NULL, " ", &saveptr);
+        strcpy(value1, token);
+    }
+
+    // Copy the N_value2
+    if (mask & FIELD_N_VALUE2) {
+        token = strtok_r(NULL, " ", &saveptr);
+        *N_value2 = atoi(token);
+    }
+
+    // Copy the slice of V_value2
+    if (mask & FIELD_V_VALUE2) {
+        token = strtok_r(NULL, " ", &saveptr);
+        *N_slice = atoi(token);
+        for (int i = 0; i < *N_slice; i++) {
+            token = strtok_r(NULL, " ", &saveptr);
+            V_value2[i] = dobles_parse(token, NULL);
+        }
+    }
+
+    // Clean the buffer
+    memset(buffer, 0, sizeof(buffer));
+
+    // Return the response
+    return res;
+}
+
+int receive_keys(int max_keys, int *keys, int *N_keys, int *more, int *cursor){
+    // Receive a stream of keys (response of SCAN and FILTER) and close the socket
+    // The keys are received in several lines (chunks), each of them as follows:
+    // N_chunk key_0 ... key_(N_chunk - 1)
+    // The last line has N_chunk = 0 and is followed by the error code, the more flag and the next cursor:
+    // 0 error_code more next_cursor
+    // In N_keys the total number of keys received is returned, but only the first max_keys are copied to keys
+    *N_keys = 0;
+    while (1) {
+        if (readLine(sd, buffer, sizeof(buffer)) <= 0) {
+            perror("Error receiving the message\n");
+            close(sd);
+            return -1;
+        }
+
+        char *token = strtok_r(buffer, " ", &saveptr);
+        if (token == NULL) {
+            close(sd);
+            return -1;
+        }
+        int N_chunk = atoi(token);
+
+        // End of the stream
+        if (N_chunk == 0) {
+            break;
+        }
+
+        // Copy the keys of the chunk
+        for (int i = 0; i < N_chunk; i++) {
+            token = strtok_r(NULL, " ", &saveptr);
+            if (token != NULL && *N_keys < max_keys) {
+                keys[*N_keys] = atoi(token);
+            }
+            (*N_keys)++;
+        }
+    }
+
+    // Close the socket
+    close(sd);
+
+    // Parse the end of the stream
+    char *token = strtok_r(NULL, " ", &saveptr);
+    int res = token != NULL ? atoi(token) : -1;
+    token = strtok_r(NULL, " ", &saveptr);
+    *more = token != NULL ? atoi(token) : 0;
+    token = strtok_r(NULL, " ", &saveptr);
+    *cursor = token != NULL ? atoi(token) : 0;
+
+    // Clean the buffer
+    memset(buffer, 0, sizeof(buffer));
+
+    return res;
+}
+
+int scan_keys(int start_key, int end_key, int limit, int *cursor, int *keys, int *N_keys){
+    // Enumera las claves del estado actual
+    return scan_keys_at(0, start_key, end_key, limit, cursor, keys, N_keys);
+}
+
+int scan_keys_at(long snapshot, int start_key, int end_key, int limit, int *cursor, int *keys, int *N_keys){
+    // Enumera en orden las claves del rango [start_key, end_key], como mucho limit claves
+    // Devuelve 1 si quedan claves por obtener (continuando desde cursor), 0 si no quedan y -1 en caso de error.
+
+    // Handling errors in arguments
+
+    // If any argument is NULL, we return -1
+    if (cursor == NULL || keys == NULL || N_keys == NULL){
+        return -1;
+    }
+
+    // If limit is not positive or the snapshot is negative, we return -1
+    if (limit < 1 || snapshot < 0){
+        return -1;
+    }
+
+    // Establish the connection
+    int error = establish_socket_connection();
+    if (error < 0) { return error; }
+
+    // Copy the Scan operation code, the range, the limit, the cursor and the snapshot, if any, to the buffer
+    sprintf(buffer, "%d %d %d %d %d", SCAN, start_key, end_key, limit, *cursor);
+    if (snapshot > 0) {
+        sprintf(buffer + strlen(buffer), " %ld", snapshot);
+    }
+
+    // Send the message
+    if (sendMessage(sd, buffer, (strlen(buffer) + 1)) < 0) {
+        perror("Error sending the message\n");
+        return -1;
+    }
+
+    // Receive the keys
+    int more;
+    int next_cursor;
+    if (receive_keys(limit, keys, N_keys, &more, &next_cursor) < 0) {
+        return -1;
+    }
+    if (*N_keys > limit) {
+        *N_keys = limit;
+    }
+
+    // Return 1 if there are more keys to get (from the next cursor)
+    if (more) {
+        *cursor = next_cursor;
+        return 1;
+    }
+    return 0;
+}
+
+int aggregate_values(int element, long *count, double *sum, double *min, double *max){
+    // Agrega las tuplas del estado actual
+    return aggregate_values_at(0, element, count, sum, min, max);
+}
+
+int aggregate_values_at(long snapshot, int element, long *count, double *sum, double *min, double *max){
+    // Calcula en el servidor el número, la suma, el mínimo y el máximo de los elementos de V_value2 (o solo del
+    // elemento element si no es -1) de todas las tuplas
+    // Devuelve 0 en caso de éxito y -1 en caso de error.
+
+    // Handling errors in arguments
+
+    // If any argument is NULL, we return -1
+    if (count == NULL || sum == NULL || min == NULL || max == NULL){
+        return -1;
+    }
+
+    // If element is not between -1 and 31 or the snapshot is negative, we return -1
+    if (element < -1 || element > 31 || snapshot < 0){
+        return -1;
+    }
+
+    // Establish the connection
+    int error = establish_socket_connection();
+    if (error < 0) { return error; }
+
+    // Copy the Aggregate operation code, the element and the snapshot, if any, to the buffer
+    sprintf(buffer, "%d %d", AGGREGATE, element);
+    if (snapshot > 0) {
+        sprintf(buffer + strlen(buffer), " %ld", snapshot);
+    }
+
+    // Send the message
+    if (sendMessage(sd, buffer, (strlen(buffer) + 1)) < 0) {
+        perror("Error sending the message\n");
+        return -1;
+    }
+
+    // Receive the response
+    // error_code count sum min max
+    if (readLine(sd, buffer, sizeof(buffer)) < 0) {
+        perror("Error receiving the message\n");
+        return -1;
+    }
+
+    // Close the socket
+    close(sd);
+
+    // Parse the response
+    char *token = strtok_r(buffer, " ", &saveptr);
+    int res = token != NULL ? atoi(token) : -1;
+    if (res == -1) {
+        return -1;
+    }
+    *count = atol(strtok_r(NULL, " ", &saveptr));
+    *sum = dobles_parse(strtok_r(NULL, " ", &saveptr), NULL);
+    *min = dobles_parse(strtok_r(NULL, " ", &saveptr), NULL);
+    *max = dobles_parse(strtok_r(NULL, " ", &saveptr), NULL);
+
+    // Clean the buffer
+    memset(buffer, 0, sizeof(buffer));
+
+    return res;
+}
+
+int filter_keys(int element, int cmp, double threshold, int max_keys, int *keys, int *N_keys){
+    // Obtiene las claves de las tuplas en las que algún elemento de V_value2 (o el elemento element si no es -1)
+    // es mayor (FILTER_GREATER) o menor (FILTER_LESS) que threshold
+    // Devuelve 0 en caso de éxito y -1 en caso de error.
+
+    // Handling errors in arguments
+
+    // If any argument is NULL, we return -1
+    if (keys == NULL || N_keys == NULL){
+        return -1;
+    }
+
+    // If element is not between -1 and 31 or the predicate is not valid, we return -1
+    if (element < -1 || element > 31 || (cmp != FILTER_GREATER && cmp != FILTER_LESS)){
+        return -1;
+    }
+
+    // Establish the connection
+    int error = establish_socket_connection();
+    if (error < 0) { return error; }
+
+    // Copy the Filter operation code, the element, the predicate and the threshold to the buffer
+    sprintf(buffer, "%d %d %d", FILTER, element, cmp);
+    append_double(buffer, threshold);
+
+    // Send the message
+    if (sendMessage(sd, buffer, (strlen(buffer) + 1)) < 0) {
+        perror("Error sending the message\n");
+        return -1;
+    }
+
+    // Receive the keys
+    int more;
+    int cursor;
+    return receive_keys(max_keys, keys, N_keys, &more, &cursor) < 0 ? -1 : 0;
+}
+
+int knn_search(int k, int metric, int N_query, double *query, int *keys, double *distances, int *N_found){
+    // Busca las k tuplas cuyo vector V_value2 está más cerca de query según la métrica metric
+    // Devuelve 0 en caso de éxito y -1 en caso de error.
+
+    // Handling errors in arguments
+
+    // If any argument is NULL, we return -1
+    if (query == NULL || keys == NULL || distances == NULL || N_found == NULL){
+        return -1;
+    }
+
+    // If k, the metric or N_query are not valid, we return -1
+    if (k < 1 || k > KNN_MAX_K || (metric != KNN_L2 && metric != KNN_COSINE) || N_query < 1 || N_query > 32){
+        return -1;
+    }
+
+    // Establish the connection
+    int error = establish_socket_connection();
+    if (error < 0) { return error; }
+
+    // Copy the Knn operation code, k, the metric and the query vector to the buffer
+    sprintf(buffer, "%d %d %d %d", KNN, k, metric, N_query);
+    for (int i = 0; i < N_query; i++) {
+        append_double(buffer, query[i]);
+    }
+
+    // Send the message
+    if (sendMessage(sd, buffer, (strlen(buffer) + 1)) < 0) {
+        perror("Error sending the message\n");
+        return -1;
+    }
+
+    // Receive the response
+    // error_code N_found key_0 distance_0 ... key_(N_found - 1) distance_(N_found - 1)
+    // Each pair takes at most 1 + 11 + 1 + 24 characters, so KNN_MAX_K pairs fit in the buffer
+    if (readLine(sd, buffer, sizeof(buffer)) < 0) {
+        perror("Error receiving the message\n");
+        return -1;
+    }
+
+    // Close the socket
+    close(sd);
+
+    // Parse the response
+    char *token = strtok_r(buffer, " ", &saveptr);
+    int res = token != NULL ? atoi(token) : -1;
+    if (res == -1) {
+        return -1;
+    }
+    *N_found = atoi(strtok_r(NULL, " ", &saveptr));
+    for (int i = 0; i < *N_found; i++) {
+        keys[i] = atoi(strtok_r(NULL, " ", &saveptr));
+        distances[i] = dobles_parse(strtok_r(NULL, " ", &saveptr), NULL);
+    }
+
+    // Clean the buffer
+    memset(buffer, 0, sizeof(buffer));
+
+    return res;
+}
+
+int get_by_value1(char *value1, int max_keys, int *keys, int *N_keys){
+    // Obtiene las claves de las tuplas cuyo value1 es igual a value1
+    // Devuelve 0 en caso de éxito y -1 en caso de error.
+
+    // Handling errors in arguments
+
+    // If any argument is NULL, we return -1
+    if (value1 == NULL || keys == NULL || N_keys == NULL){
+        return -1;
+    }
+
+    // If value1 is empty or has more than 256 Bytes, we return -1
+    if (value1[0] == '\0' || strlen(value1) > 256){
+        return -1;
+    }
+
+    // Establish the connection
+    int error = establish_socket_connection();
+    if (error < 0) { return error; }
+
+    // Copy the Get_by_value1 operation code and the value1 to the buffer
+    sprintf(buffer, "%d %s", GET_BY_VALUE1, value1);
+
+    // Send the message
+    if (sendMessage(sd, buffer, (strlen(buffer) + 1)) < 0) {
+        perror("Error sending the message\n");
+        return -1;
+    }
+
+    // Receive the keys
+    int more;
+    int cursor;
+    return receive_keys(max_keys, keys, N_keys, &more, &cursor) < 0 ? -1 : 0;
+}
+
+int prefix_value1(char *prefix, int max_keys, int *keys, int *N_keys){
+    // Obtiene las claves de las tuplas cuyo value1 empieza por prefix, como mucho max_keys claves
+    // Devuelve 0 en caso de éxito y -1 en caso de error.
+
+    // Handling errors in arguments
+
+    // If any argument is NULL, we return -1
+    if (prefix == NULL || keys == NULL || N_keys == NULL){
+        return -1;
+    }
+
+    // If the prefix is empty or has more than 256 Bytes, or max_keys is not positive, we return -1
+    if (prefix[0] == '\0' || strlen(prefix) > 256 || max_keys < 1){
+        return -1;
+    }
+
+    // Establish the connection
+    int error = establish_socket_connection();
+    if (error < 0) { return error; }
+
+    // Copy the Prefix_value1 operation code, the prefix and the maximum number of keys to the buffer
+    sprintf(buffer, "%d %s %d", PREFIX_VALUE1, prefix, max_keys);
+
+    // Send the message
+    if (sendMessage(sd, buffer, (strlen(buffer) + 1)) < 0) {
+        perror("Error sending the message\n");
+        return -1;
+    }
+
+    // Receive the keys
+    int more;
+    int cursor;
+    return receive_keys(max_keys, keys, N_keys, &more, &cursor) < 0 ? -1 : 0;
+}
+
+int get_value_version(int key, char *value1, int *N_value2, double *V_value2, uint64_t *version){
+    // Obtiene el valor1, el valor2 y la versión de la clave key
+    // Devuelve 0 si existe, 1 si no existe (solo se obtiene la versión) y -1 en caso de error
+
+    // If any argument is NULL, we return -1
+    if (value1 == NULL || N_value2 == NULL || V_value2 == NULL || version == NULL){
+        return -1;
+    }
+
+    // Establish the connection
+    int error = establish_socket_connection();
+    if (error < 0) { return error; }
+
+    // Copy the Get_versioned operation code and the key to the buffer
+    sprintf(buffer, "%d %d", GET_VERSIONED, key);
+
+    // Send the message
+    if (sendMessage(sd, buffer, (strlen(buffer) + 1)) < 0) {
+        perror("Error sending the message\n");
+        return -1;
+    }
+
+    // Receive the response
+    // The response is as follows:
+    // error_code version [value1 N_value2 V_value2[0] V_value2[1] ... V_value2[N_value2 - 1]]
+    if (readLine(sd, buffer, sizeof(buffer)) < 0) {
+        perror("Error receiving the message\n");
+        return -1;
+    }
+
+    // Close the socket
+    close(sd);
+
+    // Parse the response
+    char *token = strtok_r(buffer, " ", &saveptr);
+    int res = atoi(token);
+    token = strtok_r(NULL, " ", &saveptr);
+    if (token == NULL) {
+        return -1;
+    }
+    *version = strtoull(token, NULL, 10);
+
+    // If the key does not exist, only the version is sent
+    if (res == -1) {
+        memset(buffer, 0, sizeof(buffer));
+        return 1;
+    }
+
+    // Copy the value1, the N_value2 and the V_value2
+    token = strtok_r(NULL, " ", &saveptr);
+    strcpy(value1, token);
+    token = strtok_r(NULL, " ", &saveptr);
+    *N_value2 = atoi(token);
+    for (int i = 0; i < *N_value2; i++) {
+        token = strtok_r(NULL, " ", &saveptr);
+        V_value2[i] = dobles_parse(token, NULL);
+    }
+
+    // Clean the buffer
+    memset(buffer, 0, sizeof(buffer));
+
+    // Return the response
+    return 0;
+}
+
+int transaction(int N_reads, int *read_keys, uint64_t *read_versions, int N_writes, Escritura *writes){
+    // Aplica las escrituras si las claves leídas siguen teniendo las versiones leídas
+    // Devuelve 0 si se aplicó, 1 si hubo un conflicto y -1 en caso de error
+
+    // Handling errors in arguments
+    if (N_reads < 0 || N_reads > TXN_MAX_KEYS || N_writes < 0 || N_writes > TXN_MAX_KEYS){
+        return -1;
+    }
+    if ((N_reads > 0 && (read_keys == NULL || read_versions == NULL)) || (N_writes > 0 && writes == NULL)){
+        return -1;
+    }
+    for (int i = 0; i < N_writes; i++) {
+        if (writes[i].kind == TXN_PUT && (strlen(writes[i].value1) > 255 || writes[i].N_value2 < 1 ||
+                                          writes[i].N_value2 > 32)){
+            return -1;
+        }
+        if (writes[i].kind != TXN_PUT && writes[i].kind != TXN_DELETE){
+            return -1;
+        }
+    }
+
+    // Copy the Transaction operation code, the read set and the write set to the buffer
+    // op N_reads key_0 version_0 ... N_writes kind_0 key_0 [value1_0 N_value2_0 V_value2_0[0] ...] ...
+    // Each element is checked to fit before it is added (a double takes at most DOBLES_MAX_LEN characters)
+    int len = sprintf(buffer, "%d %d", TRANSACTION, N_reads);
+    for (int i = 0; i < N_reads; i++) {
+        len += sprintf(buffer + len, " %d %llu", read_keys[i], (unsigned long long)read_versions[i]);
+    }
+    len += sprintf(buffer + len, " %d", N_writes);
+    for (int i = 0; i < N_writes; i++) {
+        Escritura *write = &writes[i];
+        int needed = 1 + 1 + 1 + 12 + (write->kind == TXN_PUT ? 1 + strlen(write->value1) + 1 + 2 +
+                                       write->N_value2 * DOBLES_MAX_LEN : 0) + 1;
+        if (len + needed > (int)sizeof(buffer)) {
+            return -1;
+        }
+        len += sprintf(buffer + len, " %d %d", write->kind, write->key);
+        if (write->kind == TXN_PUT) {
+            len += sprintf(buffer + len, " %s %d", write->value1, write->N_value2);
+            for (int j = 0; j < write->N_value2; j++) {
+                append_double(buffer, write->V_value2[j]);
+            }
+            len = strlen(buffer);
+        }
+    }
+
+    // Establish the connection
+    int error = establish_socket_connection();
+    if (error < 0) { return error; }
+
+    // Send the message
+    if (sendMessage(sd, buffer, (strlen(buffer) + 1)) < 0) {
+        perror("Error sending the message\n");
+        return -1;
+    }
+
+    // Receive the response
+    if (readLine(sd, buffer, 3) < 0) {
+        perror("Error receiving the message\n");
+        return -1;
+    }
+
+    // Close the socket
+    close(sd);
+
+    int res = atoi(buffer);
+
+    // Clean the buffer
+    memset(buffer, 0, sizeof(buffer));
+
+    // Return the response
+    return res;
+}
+
+int snapshot_open(long *snapshot){
+    // Abre una instantánea de todo el almacenamiento
+    // Devuelve 0 en caso de éxito y -1 en caso de error
+
+    // If the argument is NULL, we return -1
+    if (snapshot == NULL){
+        return -1;
+    }
+
+    // Establish the connection
+    int error = establish_socket_connection();
+    if (error < 0) { return error; }
+
+    // Copy the Snapshot operation code to the buffer
+    sprintf(buffer, "%d", SNAPSHOT);
+
+    // Send the message
+    if (sendMessage(sd, buffer, (strlen(buffer) + 1)) < 0) {
+        perror("Error sending the message\n");
+        return -1;
+    }
+
+    // Receive the response
+    // The response is as follows:
+    // error_code [snapshot]
+    if (readLine(sd, buffer, sizeof(buffer)) < 0) {
+        perror("Error receiving the message\n");
+        return -1;
+    }
+
+    // Close the socket
+    close(sd);
+
+    // Parse the response
+    char *token = strtok_r(buffer, " ", &saveptr);
+    int res = atoi(token);
+    if (res == 0) {
+        token = strtok_r(NULL, " ", &saveptr);
+        if (token == NULL) {
+            return -1;
+        }
+        *snapshot = atol(token);
+    }
+
+    // Clean the buffer
+    memset(buffer, 0, sizeof(buffer));
+
+    // Return the response
+    return res;
+}
+
+int snapshot_release(long snapshot){
+    // Libera la instantánea snapshot
+    // Devuelve 0 en caso de éxito y -1 en caso de error
+
+    // Establish the connection
+    int error = establish_socket_connection();
+    if (error < 0) { return error; }
+
+    // Copy the Release_snapshot operation code and the snapshot to the buffer
+    sprintf(buffer, "%d %ld", RELEASE_SNAPSHOT, snapshot);
+
+    // Send the message
+    if (sendMessage(sd, buffer, (strlen(buffer) + 1)) < 0) {
+        perror("Error sending the message\n");
+        return -1;
+    }
+
+    // Receive the response
+    if (readLine(sd, buffer, 3) < 0) {
+        perror("Error receiving the message\n");
+        return -1;
+    }
+
+    // Close the socket
+    close(sd);
+
+    int res = atoi(buffer);
+
+    // Clean the buffer
+    memset(buffer, 0, sizeof(buffer));
+
+    // Return the response
+    return res;
+}
+
+int get_stats(double *uptime, long *active_connections, long *queue_depth, long *malformed, int max_ops, EstadisticasOperacion *ops, int *N_ops){
+    // Obtiene las estadísticas del servidor (las de cada código de operación se copian en ops, como mucho max_ops)
+    // Devuelve 0 en caso de éxito y -1 en caso de error.
+
+    // Handling errors in arguments
+
+    // If any argument is NULL, we return -1
+    if (uptime == NULL || active_connections == NULL || queue_depth == NULL || malformed == NULL || ops == NULL || N_ops == NULL){
+        return -1;
+    }
+
+    // If max_ops is not positive, we return -1
+    if (max_ops < 1){
+        return -1;
+    }
+
+    // Establish the connection
+    int error = establish_socket_connection();
+    if (error < 0) { return error; }
+
+    // Copy the Stats operation code to the buffer
+    sprintf(buffer, "%d", STATS);
+
+    // Send the message
+    if (sendMessage(sd, buffer, (strlen(buffer) + 1)) < 0) {
+        perror("Error sending the message\n");
+        return -1;
+    }
+
+    // Receive the response
+    // 0 uptime active_connections queue_depth malformed N_ops requests_0 failed_0 mean_0 p50_0 p90_0 p99_0 p999_0 max_0 ...
+    if (readLine(sd, buffer, sizeof(buffer)) < 0) {
+        perror("Error receiving the message\n");
+        return -1;
+    }
+
+    // Close the socket
+    close(sd);
+
+    // Parse the response
+    char *token = strtok_r(buffer, " ", &saveptr);
+    int res = token != NULL ? atoi(token) : -1;
+    if (res == -1) {
+        return -1;
+    }
+    *uptime = atof(strtok_r(NULL, " ", &saveptr));
+    *active_connections = atol(strtok_r(NULL, " ", &saveptr));
+    *queue_depth = atol(strtok_r(NULL, " ", &saveptr));
+    *malformed = atol(strtok_r(NULL, " ", &saveptr));
+    int n_ops = atoi(strtok_r(NULL, " ", &saveptr));
+    *N_ops = n_ops < max_ops ? n_ops : max_ops;
+    for (int i = 0; i < *N_ops; i++)
+    {
+        ops[i].requests = atol(strtok_r(NULL, " ", &saveptr));
+        ops[i].failed = atol(strtok_r(NULL, " ", &saveptr));
+        ops[i].mean = atof(strtok_r(NULL, " ", &saveptr));
+        ops[i].p50 = atof(strtok_r(NULL, " ", &saveptr));
+        ops[i].p90 = atof(strtok_r(NULL, " ", &saveptr));
+        ops[i].p99 = atof(strtok_r(NULL, " ", &saveptr));
+        ops[i].p999 = atof(strtok_r(NULL, " ", &saveptr));
+        ops[i].max = atof(strtok_r(NULL, " ", &saveptr));
+    }
+
+    // Clean the buffer
+    memset(buffer, 0, sizeof(buffer));
+
+    return res;
+}
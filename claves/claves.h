@@ -16,11 +16,12 @@
 
 #include "../mensaje.h"
 #include "../funciones_sockets/funciones_sockets.h"
+#include "../funciones_dobles/funciones_dobles.h"
 
 
 #define MAX_RETRIES 3
 #define LOCALHOST "127.0.0.1"
-enum OPERATION_CODE {INIT, SET_VALUE, GET_VALUE, MODIFY_VALUE, DELETE_KEY, EXIST};
+enum OPERATION_CODE {INIT, SET_VALUE, GET_VALUE, MODIFY_VALUE, DELETE_KEY, EXIST, GET_FIELDS, SCAN, AGGREGATE, FILTER, KNN, GET_BY_VALUE1, PREFIX_VALUE1, STATS, GET_VERSIONED, TRANSACTION, SNAPSHOT, RELEASE_SNAPSHOT};
 
 
 /**
@@ -52,6 +53,22 @@ int init();
  */
 int set_value(int key, char *value1, int N_value2, double *V_value2);
 
+/**
+ * @brief Este servicio inserta el elemento <key, value-1, value-2> igual que set_value, pero el
+ * elemento expira (se borra) cuando pasan ttl_ms milisegundos. Si ttl_ms es 0, el elemento no
+ * expira. El tiempo de vida solo lo guarda el servidor en memoria y se pierde si se reinicia.
+ * 
+ * @param key clave.
+ * @param value1 valor1 [256].
+ * @param N_value2 dimensión del vector V_value2 [1-32].
+ * @param V_value2 vector de doubles [32].
+ * @param ttl_ms tiempo de vida en milisegundos [>= 0].
+ * @return int El servicio devuelve 0 si se insertó con éxito y -1 en caso de error.
+ * @retval 0 si se insertó con éxito.
+ * @retval -1 en caso de error.
+ */
+int set_value_ttl(int key, char *value1, int N_value2, double *V_value2, int ttl_ms);
+
 /**
  * @brief Este servicio permite obtener los valores asociados a la clave key. La cadena de caracteres
  * asociada se devuelve en value1. En N_Value2 se devuelve la dimensión del vector asociado al
@@ -89,6 +106,22 @@ int get_value(int key, char *value1, int *N_value2, double *V_value2);
  */
 int modify_value(int key, char *value1, int N_value2, double *V_value2);
 
+/**
+ * @brief Este servicio modifica los valores asociados a la clave key igual que modify_value y fija su
+ * tiempo de vida: el elemento expira (se borra) cuando pasan ttl_ms milisegundos. Si ttl_ms es 0,
+ * el elemento deja de expirar (como con modify_value).
+ * 
+ * @param key clave.
+ * @param value1 valor1 [256].
+ * @param N_value2 dimensión del vector V_value2 [1-32].
+ * @param V_value2 vector de doubles [32].
+ * @param ttl_ms tiempo de vida en milisegundos [>= 0].
+ * @return int El servicio devuelve 0 si se modificó con éxito y -1 en caso de error.
+ * @retval 0 si se modificó con éxito.
+ * @retval -1 en caso de error.
+ */
+int modify_value_ttl(int key, char *value1, int N_value2, double *V_value2, int ttl_ms);
+
 /**
  * @brief Este servicio permite borrar el elemento cuya clave es key. La
  * función devuelve 0 en caso de éxito y -1 en caso de error. En caso de que la clave no exista
@@ -115,5 +148,274 @@ int delete_key(int key);
  */
 int exist(int key);
 
+/**
+ * @brief Este servicio permite obtener solo algunos de los valores asociados a la clave key (proyección).
+ * En mask se indican los campos que se quieren obtener (FIELD_VALUE1, FIELD_N_VALUE2 y/o FIELD_V_VALUE2).
+ * Si se pide FIELD_V_VALUE2 solo se devuelven los elementos [first, first + count) del vector (count = -1
+ * para obtener hasta el final), que se copian al principio de V_value2, y en N_slice se devuelve el número
+ * de elementos copiados. Los campos no pedidos no se modifican. La función devuelve 0 en caso de éxito y -1
+ * en caso de error, por ejemplo, si no existe un elemento con dicha clave o si se produce un error de
+ * comunicaciones.
+ * 
+ * @param key clave.
+ * @param mask campos a obtener (FIELD_VALUE1 | FIELD_N_VALUE2 | FIELD_V_VALUE2).
+ * @param first primer elemento de V_value2 a obtener.
+ * @param count número de elementos de V_value2 a obtener (-1 para obtener hasta el final).
+ * @param value1 valor1 [256].
+ * @param N_value2 dimensión del vector V_value2 [1-32].
+ * @param V_value2 vector de doubles [32].
+ * @param N_slice número de elementos copiados en V_value2.
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ * @retval 0 en caso de éxito.
+ * @retval -1 en caso de error.
+ */
+int get_fields(int key, int mask, int first, int count, char *value1, int *N_value2, double *V_value2, int *N_slice);
+
+/**
+ * @brief Este servicio permite enumerar en orden ascendente las claves almacenadas en el rango
+ * [start_key, end_key]. Se obtienen como mucho limit claves, que se copian en keys, y en N_keys se
+ * devuelve el número de claves copiadas. El servidor envía las claves por partes, sin construir la
+ * respuesta completa. La enumeración empieza en la clave cursor (en la primera llamada se debe pasar
+ * start_key); si quedan claves por obtener la función devuelve 1 y actualiza cursor con la clave desde
+ * la que se debe continuar en la siguiente llamada. La función devuelve 0 si no quedan más claves en el
+ * rango y -1 en caso de error, por ejemplo, si se produce un error de comunicaciones.
+ * 
+ * @param start_key primera clave del rango (incluida).
+ * @param end_key última clave del rango (incluida).
+ * @param limit número máximo de claves a obtener [>= 1].
+ * @param cursor clave desde la que se continúa la enumeración (se actualiza).
+ * @param keys vector donde se copian las claves [limit].
+ * @param N_keys número de claves copiadas en keys.
+ * @return int La función devuelve 1 si quedan claves por obtener, 0 si no quedan y -1 en caso de error.
+ * @retval 1 si quedan claves por obtener.
+ * @retval 0 si no quedan claves por obtener.
+ * @retval -1 en caso de error.
+ */
+int scan_keys(int start_key, int end_key, int limit, int *cursor, int *keys, int *N_keys);
+
+/**
+ * @brief Este servicio enumera las claves del rango [start_key, end_key] igual que scan_keys, pero tal
+ * como estaban cuando se abrió la instantánea snapshot (ver snapshot_open), aunque se hayan escrito
+ * después. Si snapshot es 0, se enumeran las claves actuales.
+ * 
+ * @param snapshot instantánea (0 para el estado actual).
+ * @param start_key primera clave del rango (incluida).
+ * @param end_key última clave del rango (incluida).
+ * @param limit número máximo de claves a obtener [>= 1].
+ * @param cursor clave desde la que se continúa la enumeración (se actualiza).
+ * @param keys vector donde se copian las claves [limit].
+ * @param N_keys número de claves copiadas en keys.
+ * @return int La función devuelve 1 si quedan claves por obtener, 0 si no quedan y -1 en caso de error
+ * (también si la instantánea no está abierta).
+ * @retval 1 si quedan claves por obtener.
+ * @retval 0 si no quedan claves por obtener.
+ * @retval -1 en caso de error.
+ */
+int scan_keys_at(long snapshot, int start_key, int end_key, int limit, int *cursor, int *keys, int *N_keys);
+
+/**
+ * @brief Este servicio calcula en el servidor el número de elementos (count), la suma (sum), el mínimo (min)
+ * y el máximo (max) de los elementos de V_value2 de todas las tuplas almacenadas, sin transferir las tuplas.
+ * Si element es -1 se consideran todos los elementos de cada vector y si no solo el elemento element.
+ * Si no hay ningún elemento, count es 0 y min y max valen 0. La función devuelve 0 en caso de éxito y -1
+ * en caso de error, por ejemplo, si se produce un error de comunicaciones.
+ * 
+ * @param element elemento de V_value2 a considerar [0-31], o -1 para todos.
+ * @param count número de elementos agregados.
+ * @param sum suma de los elementos.
+ * @param min mínimo de los elementos.
+ * @param max máximo de los elementos.
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ * @retval 0 en caso de éxito.
+ * @retval -1 en caso de error.
+ */
+int aggregate_values(int element, long *count, double *sum, double *min, double *max);
+
+/**
+ * @brief Este servicio calcula el agregado de los elementos de V_value2 igual que aggregate_values, pero
+ * de las tuplas tal como estaban cuando se abrió la instantánea snapshot (ver snapshot_open). Las
+ * escrituras de otros clientes no esperan a que termine. Si snapshot es 0, se agregan las tuplas actuales.
+ * 
+ * @param snapshot instantánea (0 para el estado actual).
+ * @param element elemento de V_value2 a considerar [0-31], o -1 para todos.
+ * @param count número de elementos agregados.
+ * @param sum suma de los elementos.
+ * @param min mínimo de los elementos.
+ * @param max máximo de los elementos.
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error (también si la instantánea no
+ * está abierta).
+ * @retval 0 en caso de éxito.
+ * @retval -1 en caso de error.
+ */
+int aggregate_values_at(long snapshot, int element, long *count, double *sum, double *min, double *max);
+
+/**
+ * @brief Este servicio obtiene las claves de las tuplas en las que algún elemento de V_value2 (o el elemento
+ * element, si no es -1) es mayor (cmp = FILTER_GREATER) o menor (cmp = FILTER_LESS) que threshold. El filtro
+ * se evalúa en el servidor. En N_keys se devuelve el número de claves encontradas, pero solo se copian en keys
+ * las max_keys primeras. La función devuelve 0 en caso de éxito y -1 en caso de error, por ejemplo, si se
+ * produce un error de comunicaciones.
+ * 
+ * @param element elemento de V_value2 a considerar [0-31], o -1 para todos.
+ * @param cmp predicado (FILTER_GREATER o FILTER_LESS).
+ * @param threshold umbral.
+ * @param max_keys número máximo de claves a copiar en keys.
+ * @param keys vector donde se copian las claves [max_keys].
+ * @param N_keys número de claves encontradas.
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ * @retval 0 en caso de éxito.
+ * @retval -1 en caso de error.
+ */
+int filter_keys(int element, int cmp, double threshold, int max_keys, int *keys, int *N_keys);
+
+/**
+ * @brief Este servicio busca en el servidor las k tuplas cuyo vector V_value2 está más cerca del vector de
+ * consulta query (de dimensión N_query; solo se comparan vectores de la misma dimensión) según la métrica
+ * metric (KNN_L2: distancia euclídea, KNN_COSINE: 1 - similitud coseno). Las claves se copian en keys y las
+ * distancias en distances, ordenadas de menor a mayor distancia, y en N_found se devuelve el número de vecinos
+ * encontrados (como mucho k). La función devuelve 0 en caso de éxito y -1 en caso de error, por ejemplo, si
+ * se produce un error de comunicaciones.
+ * 
+ * @param k número de vecinos a buscar [1-KNN_MAX_K].
+ * @param metric métrica (KNN_L2 o KNN_COSINE).
+ * @param N_query dimensión del vector de consulta [1-32].
+ * @param query vector de consulta [32].
+ * @param keys vector donde se copian las claves [k].
+ * @param distances vector donde se copian las distancias [k].
+ * @param N_found número de vecinos encontrados.
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ * @retval 0 en caso de éxito.
+ * @retval -1 en caso de error.
+ */
+int knn_search(int k, int metric, int N_query, double *query, int *keys, double *distances, int *N_found);
+
+/**
+ * @brief Este servicio obtiene las claves de las tuplas cuyo value1 es igual a value1. En N_keys se devuelve
+ * el número de claves encontradas, pero solo se copian en keys las max_keys primeras. Si el servidor mantiene
+ * el índice sobre value1 la búsqueda no recorre todas las tuplas. La función devuelve 0 en caso de éxito y -1
+ * en caso de error, por ejemplo, si se produce un error de comunicaciones.
+ * 
+ * @param value1 valor1 a buscar [256].
+ * @param max_keys número máximo de claves a copiar en keys.
+ * @param keys vector donde se copian las claves [max_keys].
+ * @param N_keys número de claves encontradas.
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ * @retval 0 en caso de éxito.
+ * @retval -1 en caso de error.
+ */
+int get_by_value1(char *value1, int max_keys, int *keys, int *N_keys);
+
+/**
+ * @brief Este servicio obtiene las claves de las tuplas cuyo value1 empieza por prefix, como mucho max_keys
+ * claves, que se copian en keys (en N_keys se devuelve el número de claves copiadas). Si el servidor mantiene
+ * el índice sobre value1 la búsqueda no recorre todas las tuplas y las claves se devuelven ordenadas por
+ * value1. La función devuelve 0 en caso de éxito y -1 en caso de error, por ejemplo, si se produce un error
+ * de comunicaciones.
+ * 
+ * @param prefix prefijo a buscar [256].
+ * @param max_keys número máximo de claves a obtener [>= 1].
+ * @param keys vector donde se copian las claves [max_keys].
+ * @param N_keys número de claves copiadas.
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ * @retval 0 en caso de éxito.
+ * @retval -1 en caso de error.
+ */
+int prefix_value1(char *prefix, int max_keys, int *keys, int *N_keys);
+
+/**
+ * @brief Este servicio obtiene los valores asociados a la clave key, como get_value, junto con su versión
+ * (version), que cambia cada vez que se escribe la clave. La versión se devuelve también si la clave no
+ * existe, para poder usar su ausencia en una transacción.
+ * 
+ * @param key clave.
+ * @param value1 valor1 [256].
+ * @param N_value2 dimensión del vector V_value2 [1-32].
+ * @param V_value2 vector de doubles [32].
+ * @param version versión de la clave.
+ * @return int La función devuelve 0 si la clave existe, 1 si no existe y -1 en caso de error.
+ * @retval 0 si la clave existe.
+ * @retval 1 si la clave no existe (solo se devuelve version).
+ * @retval -1 en caso de error.
+ */
+int get_value_version(int key, char *value1, int *N_value2, double *V_value2, uint64_t *version);
+
+/**
+ * @brief Este servicio aplica de forma atómica las escrituras writes (TXN_PUT almacena la tupla, exista o
+ * no la clave, y TXN_DELETE borra la clave si existe) solo si ninguna de las claves read_keys se ha
+ * escrito desde que se leyó con get_value_version, es decir, si siguen teniendo las versiones
+ * read_versions. En caso contrario no se aplica nada y se devuelve 1 (conflicto): el cliente puede leer de
+ * nuevo las claves y repetir la transacción. Las claves escritas pierden su tiempo de vida.
+ * 
+ * @param N_reads número de claves leídas [0-TXN_MAX_KEYS].
+ * @param read_keys claves leídas [N_reads].
+ * @param read_versions versión de cada clave leída [N_reads].
+ * @param N_writes número de escrituras [0-TXN_MAX_KEYS].
+ * @param writes escrituras, que se aplican en orden [N_writes].
+ * @return int La función devuelve 0 si se aplicó la transacción, 1 si hubo un conflicto y -1 en caso de error
+ * (también si la petición no cabe en un mensaje).
+ * @retval 0 si se aplicó la transacción.
+ * @retval 1 si hubo un conflicto (no se aplicó nada).
+ * @retval -1 en caso de error.
+ */
+int transaction(int N_reads, int *read_keys, uint64_t *read_versions, int N_writes, Escritura *writes);
+
+/**
+ * @brief Este servicio abre en el servidor una instantánea de todas las tuplas, que se puede leer con
+ * scan_keys_at y aggregate_values_at mientras otros clientes siguen escribiendo. En snapshot se devuelve
+ * su identificador. La instantánea se debe liberar con snapshot_release; el servidor la libera solo si no
+ * se usa durante un minuto, y también con init. La función devuelve 0 en caso de éxito y -1 en caso de
+ * error, por ejemplo, si hay demasiadas instantáneas abiertas.
+ * 
+ * @param snapshot identificador de la instantánea.
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ * @retval 0 en caso de éxito.
+ * @retval -1 en caso de error.
+ */
+int snapshot_open(long *snapshot);
+
+/**
+ * @brief Este servicio libera la instantánea snapshot. La función devuelve 0 en caso de éxito y -1 en caso
+ * de error, por ejemplo, si la instantánea no está abierta.
+ * 
+ * @param snapshot identificador de la instantánea.
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ * @retval 0 en caso de éxito.
+ * @retval -1 en caso de error.
+ */
+int snapshot_release(long snapshot);
+
+// Statistics of an operation code returned by get_stats (latencies in microseconds)
+typedef struct {
+    long requests;      /* Requests processed */
+    long failed;        /* Requests that returned an error */
+    double mean;        /* Mean latency */
+    double p50;         /* Percentiles of the latency */
+    double p90;
+    double p99;
+    double p999;
+    double max;         /* Maximum latency */
+} EstadisticasOperacion;
+
+/**
+ * @brief Este servicio obtiene las estadísticas del servidor: el tiempo que lleva en marcha (uptime, en
+ * segundos), las conexiones activas, las peticiones a la espera del almacenamiento (queue_depth), las
+ * peticiones mal formadas y, para cada código de operación (el índice de ops), el número de peticiones,
+ * de errores y los percentiles de la latencia (como mucho max_ops operaciones; en N_ops se devuelve el
+ * número de operaciones copiadas). La función devuelve 0 en caso de éxito y -1 en caso de error, por
+ * ejemplo, si se produce un error de comunicaciones.
+ * 
+ * @param uptime segundos desde que se inició el servidor.
+ * @param active_connections conexiones activas (incluida la de esta petición).
+ * @param queue_depth peticiones a la espera del almacenamiento.
+ * @param malformed peticiones que no se han podido interpretar.
+ * @param max_ops número máximo de operaciones a obtener [>= 1].
+ * @param ops vector donde se copian las estadísticas de cada operación [max_ops].
+ * @param N_ops número de operaciones copiadas.
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ * @retval 0 en caso de éxito.
+ * @retval -1 en caso de error.
+ */
+int get_stats(double *uptime, long *active_connections, long *queue_depth, long *malformed, int max_ops, EstadisticasOperacion *ops, int *N_ops);
+
 
 #endif
\ No newline at end of file
@@ -1,166 +1,390 @@
+/*
+Load generator for the tuple service.
+Several threads send requests through claves.h with a configurable mix of operations (SET, GET, MODIFY,
+DELETE and EXIST), key distribution (uniform or Zipfian) and value size, either as fast as possible
+(closed loop) or at a fixed rate (open loop). At the end it reports the throughput and the latency
+percentiles of each operation, as text and optionally as JSON.
+*/
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>    /* For signal handling */
-#include <time.h>      /* For time() */
+#include <time.h>      /* For clock_gettime() */
+#include <math.h>      /* For pow() */
+#include <getopt.h>    /* For the command line options */
 
 #include "claves/claves.h"
+#include "funciones_histograma/funciones_histograma.h"
+
+#define N_OPS 5
+#define MAX_THREADS 1024
+
+enum LOAD_OP {LOAD_SET, LOAD_GET, LOAD_MODIFY, LOAD_DELETE, LOAD_EXIST};
+const char *op_names[N_OPS] = {"set", "get", "modify", "delete", "exist"};
+
+// Configuration of the load
+int n_threads = 4;              // Number of threads (each request uses its own connection)
+double duration = 10.0;         // Duration of the test (seconds)
+int keyspace = 1000;            // Keys are in [0, keyspace)
+double zipf_theta = 0.0;        // Skew of the Zipfian distribution (0 -> uniform keys)
+int mix[N_OPS] = {10, 70, 10, 5, 5};    // Weight of each operation
+int value1_len = 16;            // Length of value1
+int n_value2 = 8;               // Number of elements of V_value2
+double rate = 0.0;              // Total requests per second (0 -> closed loop)
+int populate = 0;               // Run init() and insert all the keys before the test
+char *json_file = NULL;         // File where the JSON report is written ("-" for stdout)
 
+volatile sig_atomic_t stop = 0; // Set by SIGINT to end the test early
+
+// Zipfian generator (Gray et al., "Quickly generating billion-record synthetic databases")
+double zipf_zetan, zipf_alpha, zipf_eta;
+
+typedef struct {
+    int id;
+    uint64_t rng;                   /* State of the random number generator of the thread */
+    Histograma latency[N_OPS];      /* Latency of each operation (ns) */
+    long failed[N_OPS];             /* Requests that returned an error */
+} Worker;
 
 void end(int sig){
-    // Signal handler for the SIGINT signal (Ctrl+C)
+    // Signal handler for the SIGINT signal (Ctrl+C): end the test and print the report
+    stop = 1;
+}
 
-    printf("Exiting the client...\n");
+uint64_t now_ns(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
 
-    // Exit the program    
-    exit(0);
+uint64_t next_random(uint64_t *state){
+    // xorshift64*
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ull;
 }
 
-int main(int argc, char *argv[])
-{
-    signal (SIGINT, end);
-    srand(time(NULL));  // Seed for the random number generator based on the current time
+double next_uniform(uint64_t *state){
+    // Uniform double in [0, 1)
+    return (next_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+void init_zipf(){
+    double zeta2 = 1.0 + pow(0.5, zipf_theta);
+    zipf_zetan = 0.0;
+    for (int i = 1; i <= keyspace; i++)
+    {
+        zipf_zetan += 1.0 / pow(i, zipf_theta);
+    }
+    zipf_alpha = 1.0 / (1.0 - zipf_theta);
+    zipf_eta = (1.0 - pow(2.0 / keyspace, 1.0 - zipf_theta)) / (1.0 - zeta2 / zipf_zetan);
+}
+
+int next_key(uint64_t *state){
+    if (zipf_theta <= 0.0){
+        return next_random(state) % keyspace;
+    }
+
+    double u = next_uniform(state);
+    double uz = u * zipf_zetan;
+    if (uz < 1.0){
+        return 0;
+    }
+    if (uz < 1.0 + pow(0.5, zipf_theta)){
+        return 1 % keyspace;
+    }
+    int key = (int)(keyspace * pow(zipf_eta * u - zipf_eta + 1.0, zipf_alpha));
+    return key < keyspace ? key : keyspace - 1;
+}
+
+int next_op(uint64_t *state){
+    int total = 0;
+    for (int i = 0; i < N_OPS; i++)
+    {
+        total += mix[i];
+    }
+    int r = next_random(state) % total;
+    for (int i = 0; i < N_OPS; i++)
+    {
+        if (r < mix[i]){
+            return i;
+        }
+        r -= mix[i];
+    }
+    return LOAD_GET;
+}
 
-    int key;
+void fill_value(uint64_t *state, int key, char *value1, double *V_value2){
+    // value1 is "v<key>" padded with 'x' up to value1_len characters
+    int len = sprintf(value1, "v%d", key);
+    while (len < value1_len)
+    {
+        value1[len++] = 'x';
+    }
+    value1[len] = '\0';
+
+    for (int i = 0; i < n_value2; i++)
+    {
+        V_value2[i] = (double)(next_random(state) % 1000000) / 1000.0;
+    }
+}
+
+int run_op(int op, int key, uint64_t *state){
     char value1[256];
     int N_value2;
     double V_value2[32];
 
-    char value1_get[256];
-    int N_value2_get;
-    double V_value2_get[32];
+    switch (op)
+    {
+        case LOAD_SET:
+            fill_value(state, key, value1, V_value2);
+            return set_value(key, value1, n_value2, V_value2);
+        case LOAD_GET:
+            return get_value(key, value1, &N_value2, V_value2);
+        case LOAD_MODIFY:
+            fill_value(state, key, value1, V_value2);
+            return modify_value(key, value1, n_value2, V_value2);
+        case LOAD_DELETE:
+            return delete_key(key);
+        default:
+            return exist(key) < 0 ? -1 : 0;
+    }
+}
+
+void *run_worker(void *arg){
+    Worker *worker = arg;
+    uint64_t start = now_ns();
+    uint64_t end_time = start + (uint64_t)(duration * 1e9);
 
-    int error;
+    // In open loop each thread sends its share of the rate at fixed intervals, and the latency is
+    // measured from the time the request should have been sent (so that a slow server is not hidden
+    // by the client waiting for it: coordinated omission)
+    uint64_t interval = rate > 0.0 ? (uint64_t)(1e9 * n_threads / rate) : 0;
+    uint64_t next_send = start + (interval * worker->id) / n_threads;
 
-    // Infinite loop
-    while (1)
+    while (!stop)
     {
-        // If the file "tuplas.txt" does not exist, run init()
-        FILE *file = fopen("tuplas.txt", "r");
-        if (file == NULL)
-        {
-            init();
-        }
-        else
-        {
-        fclose(file);
+        uint64_t t0;
+        if (interval > 0){
+            uint64_t t = now_ns();
+            if (next_send > t){
+                struct timespec ts = {(next_send - t) / 1000000000ull, (next_send - t) % 1000000000ull};
+                nanosleep(&ts, NULL);
+            }
+            t0 = next_send;
+            next_send += interval;
+        } else {
+            t0 = now_ns();
         }
-
-        // Try to add a key
-        // If it already exists, delete it and try again
-        key = rand() % 1000;    // Random key between 0 and 999
-        sprintf(value1, "value1_%d", key);
-        N_value2 = rand() % 32 + 1; // Random number between 1 and 32
-        for (int i = 0; i < N_value2; i++)
-        {
-            // Random integer part and random decimal part
-            V_value2[i] = (double)rand() + (double)rand() / RAND_MAX;
+        if (t0 >= end_time){
+            break;
         }
 
-        error = set_value(key, value1, N_value2, V_value2);
-        if (error == -2)    // Communication error
-        {
-            return -1;
+        int op = next_op(&worker->rng);
+        int key = next_key(&worker->rng);
+        int res = run_op(op, key, &worker->rng);
+        if (res == -2){
+            fprintf(stderr, "The server is not available\n");
+            stop = 1;
+            break;
         }
-        while (error == -1) // Key already exists
-        {
-            if (delete_key(key) == -2)  // Communication error
-            {
-                return -1;
-            }
-            printf("Key %d deleted\n", key);
-            error = set_value(key, value1, N_value2, V_value2);
-            if (error == -2)    // Communication error
-            {
-                return -1;
-            }
+        if (res < 0){
+            worker->failed[op]++;
         }
-        printf("Key %d added\n", key);
-        // Sleep one second
-        // sleep(1);
-
-        // Try to get the recently added key
-        // If it does not exist, try again
-        error = get_value(key, value1_get, &N_value2_get, V_value2_get);
-        if (error == -2)
-        {
-            return -1;
+        histograma_record(&worker->latency[op], now_ns() - t0);
+    }
+    return NULL;
+}
+
+void print_report(Histograma *latency, long *failed, double elapsed){
+    Histograma total;
+    long total_failed = 0;
+    histograma_init(&total);
+    for (int i = 0; i < N_OPS; i++)
+    {
+        histograma_merge(&total, &latency[i]);
+        total_failed += failed[i];
+    }
+
+    printf("Threads: %d, mode: %s", n_threads, rate > 0.0 ? "open loop" : "closed loop");
+    if (rate > 0.0){
+        printf(" (%.0f req/s)", rate);
+    }
+    printf(", duration: %.2f s, keys: %d (%s", elapsed, keyspace, zipf_theta > 0.0 ? "zipf" : "uniform");
+    if (zipf_theta > 0.0){
+        printf(" %.2f", zipf_theta);
+    }
+    printf("), value1: %d chars, V_value2: %d doubles\n", value1_len, n_value2);
+    printf("Throughput: %.1f req/s\n\n", total.total / elapsed);
+
+    printf("%-8s %10s %8s %10s %10s %10s %10s %10s %10s\n", "op", "requests", "failed", "req/s", "mean(us)", "p50(us)", "p99(us)", "p999(us)", "max(us)");
+    for (int i = 0; i <= N_OPS; i++)
+    {
+        Histograma *h = i < N_OPS ? &latency[i] : &total;
+        if (h->total == 0){
+            continue;
         }
-        while (error == -1)
-        {
-            if (set_value(key, value1, N_value2, V_value2) == -2)
-            {
-                return -1;
-            }
-            printf("Key %d added\n", key);
+        printf("%-8s %10lu %8ld %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", i < N_OPS ? op_names[i] : "total",
+               (unsigned long)h->total, i < N_OPS ? failed[i] : total_failed, h->total / elapsed, histograma_mean(h) / 1e3,
+               histograma_percentile(h, 50) / 1e3, histograma_percentile(h, 99) / 1e3,
+               histograma_percentile(h, 99.9) / 1e3, h->max / 1e3);
+    }
 
-            error = get_value(key, value1_get, &N_value2_get, V_value2_get);
-            if (error == -2)
-            {
+    if (json_file == NULL){
+        return;
+    }
+    FILE *file = strcmp(json_file, "-") == 0 ? stdout : fopen(json_file, "w");
+    if (file == NULL){
+        perror("Error opening the JSON file\n");
+        return;
+    }
+    fprintf(file, "{\"threads\": %d, \"mode\": \"%s\", \"rate\": %.1f, \"duration_s\": %.3f, \"keyspace\": %d, "
+            "\"zipf_theta\": %.3f, \"value1_len\": %d, \"n_value2\": %d, \"throughput\": %.1f, \"ops\": {",
+            n_threads, rate > 0.0 ? "open" : "closed", rate, elapsed, keyspace, zipf_theta, value1_len, n_value2,
+            total.total / elapsed);
+    for (int i = 0; i <= N_OPS; i++)
+    {
+        Histograma *h = i < N_OPS ? &latency[i] : &total;
+        fprintf(file, "%s\"%s\": {\"requests\": %lu, \"failed\": %ld, \"throughput\": %.1f, \"mean_us\": %.1f, "
+                "\"p50_us\": %.1f, \"p99_us\": %.1f, \"p999_us\": %.1f, \"max_us\": %.1f}",
+                i == 0 ? "" : ", ", i < N_OPS ? op_names[i] : "total", (unsigned long)h->total,
+                i < N_OPS ? failed[i] : total_failed, h->total / elapsed, histograma_mean(h) / 1e3,
+                histograma_percentile(h, 50) / 1e3, histograma_percentile(h, 99) / 1e3,
+                histograma_percentile(h, 99.9) / 1e3, h->max / 1e3);
+    }
+    fprintf(file, "}}\n");
+    if (file != stdout){
+        fclose(file);
+    }
+}
+
+void usage(char *program){
+    printf("Usage: %s [options]\n", program);
+    printf("Options:\n");
+    printf("  -t <threads>          number of threads/connections (default %d)\n", n_threads);
+    printf("  -d <seconds>          duration of the test (default %.0f)\n", duration);
+    printf("  -k <keys>             number of keys (default %d)\n", keyspace);
+    printf("  -z <theta>            Zipfian keys with skew theta in (0, 1) (default uniform)\n");
+    printf("  -m <s:g:m:d:e>        weights of set:get:modify:delete:exist (default 10:70:10:5:5)\n");
+    printf("  -l <length>           length of value1 [1-255] (default %d)\n", value1_len);
+    printf("  -n <elements>         number of elements of V_value2 [1-32] (default %d)\n", n_value2);
+    printf("  -r <req/s>            open loop at a fixed total rate (default closed loop)\n");
+    printf("  -p                    run init() and insert all the keys before the test\n");
+    printf("  -j <file>             write the report as JSON to file (- for stdout)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    signal (SIGINT, end);
+
+    int option;
+    while ((option = getopt(argc, argv, "t:d:k:z:m:l:n:r:pj:h")) != -1){
+        switch (option){
+            case 't': n_threads = atoi(optarg); break;
+            case 'd': duration = atof(optarg); break;
+            case 'k': keyspace = atoi(optarg); break;
+            case 'z': zipf_theta = atof(optarg); break;
+            case 'm':
+                if (sscanf(optarg, "%d:%d:%d:%d:%d", &mix[0], &mix[1], &mix[2], &mix[3], &mix[4]) != N_OPS){
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'l': value1_len = atoi(optarg); break;
+            case 'n': n_value2 = atoi(optarg); break;
+            case 'r': rate = atof(optarg); break;
+            case 'p': populate = 1; break;
+            case 'j': json_file = optarg; break;
+            default:
+                usage(argv[0]);
                 return -1;
-            }
         }
-        printf("Key %d obtained\n", key);
-        // Sleep one second
-        // sleep(1);
-
-        // Try to modify the recently added key
-        // If it does not exist, use set_value()
-        sprintf(value1, "value1_%d", key);
-        N_value2 = rand() % 32 + 1;
-        for (int i = 0; i < N_value2; i++)
-        {
-            V_value2[i] = (double)rand() + (double)rand() / RAND_MAX;
+    }
+
+    // Check the configuration
+    int total_mix = 0;
+    for (int i = 0; i < N_OPS; i++)
+    {
+        if (mix[i] < 0){
+            total_mix = -1;
+            break;
         }
+        total_mix += mix[i];
+    }
+    if (n_threads < 1 || n_threads > MAX_THREADS || duration <= 0.0 || keyspace < 1 || zipf_theta < 0.0 ||
+        zipf_theta >= 1.0 || total_mix <= 0 || value1_len < 1 || value1_len > 255 || n_value2 < 1 ||
+        n_value2 > 32 || rate < 0.0){
+        printf("Invalid configuration\n");
+        usage(argv[0]);
+        return -1;
+    }
+    if (zipf_theta > 0.0){
+        init_zipf();
+    }
 
-        error = modify_value(key, value1, N_value2, V_value2);
-        if (error == -2)
-        {
+    uint64_t seed = now_ns();
+    if (populate){
+        printf("Populating %d keys...\n", keyspace);
+        if (init() < 0){
+            printf("Error running init()\n");
             return -1;
         }
-        while (error == -1)
+        char value1[256];
+        double V_value2[32];
+        for (int key = 0; key < keyspace && !stop; key++)
         {
-            if (set_value(key, value1, N_value2, V_value2) == -2)
-            {
-                return -1;
-            }
-            printf("Key %d added\n", key);
-
-            error = modify_value(key, value1, N_value2, V_value2);
-            if (error == -2)
-            {
+            fill_value(&seed, key, value1, V_value2);
+            if (set_value(key, value1, n_value2, V_value2) == -2){
                 return -1;
             }
         }
-        printf("Key %d modified\n", key);
-        // Sleep one second
-        // sleep(1);
-
-        // Try to get the recently modified key
-        // If it does not exist, try again
-        error = get_value(key, value1_get, &N_value2_get, V_value2_get);
-        if (error == -2)
+    }
+
+    Worker *workers = malloc(n_threads * sizeof(Worker));
+    pthread_t *threads = malloc(n_threads * sizeof(pthread_t));
+    if (workers == NULL || threads == NULL){
+        perror("Error allocating memory\n");
+        return -1;
+    }
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < n_threads; i++)
+    {
+        workers[i].id = i;
+        workers[i].rng = seed + 0x9E3779B97F4A7C15ull * (i + 1);
+        for (int j = 0; j < N_OPS; j++)
         {
+            histograma_init(&workers[i].latency[j]);
+            workers[i].failed[j] = 0;
+        }
+        if (pthread_create(&threads[i], NULL, run_worker, &workers[i]) != 0){
+            perror("Error creating the thread\n");
             return -1;
         }
-        while (error == -1)
-        {
-            if (set_value(key, value1, N_value2, V_value2) == -2)
-            {
-                return -1;
-            }
-            printf("Key %d added\n", key);
+    }
 
-            error = get_value(key, value1_get, &N_value2_get, V_value2_get);
-            if (error == -2)
-            {
-                return -1;
-            }
+    Histograma latency[N_OPS];
+    long failed[N_OPS] = {0};
+    for (int j = 0; j < N_OPS; j++)
+    {
+        histograma_init(&latency[j]);
+    }
+    for (int i = 0; i < n_threads; i++)
+    {
+        pthread_join(threads[i], NULL);
+        for (int j = 0; j < N_OPS; j++)
+        {
+            histograma_merge(&latency[j], &workers[i].latency[j]);
+            failed[j] += workers[i].failed[j];
         }
-        printf("Key %d obtained\n", key);
-        // Sleep one second
-        // sleep(1);
     }
+    double elapsed = (now_ns() - start) / 1e9;
+
+    print_report(latency, failed, elapsed);
 
+    free(workers);
+    free(threads);
     return 0;
-}
\ No newline at end of file
+}
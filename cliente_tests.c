@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <limits.h>
 
 #include "claves/claves.h"
 
@@ -345,5 +347,402 @@ int main(int argc, char *argv[])
     int expected_exist_9 = 0;
     assert_equals_int(test_exist_9, expected_exist_9, "Test exist()");
 
+    printf("-------- TESTING GET_FIELDS (PROJECTION) --------\n");
+    int test_set_value_6 = set_value(4, "value4", 6, (double[]){1.0, 2.0, 3.0, 4.0, 5.0, 6.0});
+    int expected_set_value_6 = 0;
+    assert_equals_int(test_set_value_6, expected_set_value_6, "Do set_value(4, \"value4\", 6, [1.0, 2.0, 3.0, 4.0, 5.0, 6.0])");
+
+    // Only value1
+    char value1_4[256];
+    int N_value2_4;
+    double V_value2_4[32];
+    int N_slice_4;
+    int test_get_fields_1 = get_fields(4, FIELD_VALUE1, 0, -1, value1_4, NULL, NULL, NULL);
+    int expected_get_fields_1 = 0;
+    assert_equals_int(test_get_fields_1, expected_get_fields_1, "Test get_fields(4, FIELD_VALUE1, 0, -1, ...)");
+    assert_equals_str(value1_4, "value4", "Check that value1 has been obtained");
+
+    // N_value2 and the slice [2, 5) of V_value2
+    int test_get_fields_2 = get_fields(4, FIELD_N_VALUE2 | FIELD_V_VALUE2, 2, 3, NULL, &N_value2_4, V_value2_4, &N_slice_4);
+    int expected_get_fields_2 = 0;
+    assert_equals_int(test_get_fields_2, expected_get_fields_2, "Test get_fields(4, FIELD_N_VALUE2 | FIELD_V_VALUE2, 2, 3, ...)");
+    assert_equals_int(N_value2_4, 6, "Check that N_value2 has been obtained");
+    assert_equals_int(N_slice_4, 3, "Check that only 3 elements of V_value2 have been obtained");
+    for (int i = 0; i < N_slice_4; i++){
+        assert_equals_double(V_value2_4[i], i + 3.0, "Check that V_value2[2 + i] has been obtained");
+    }
+
+    // A slice past the end of V_value2 is clamped
+    int test_get_fields_3 = get_fields(4, FIELD_V_VALUE2, 4, 10, NULL, NULL, V_value2_4, &N_slice_4);
+    int expected_get_fields_3 = 0;
+    assert_equals_int(test_get_fields_3, expected_get_fields_3, "Test get_fields(4, FIELD_V_VALUE2, 4, 10, ...)");
+    assert_equals_int(N_slice_4, 2, "Check that the slice has been clamped to 2 elements");
+    int test_get_fields_5 = get_fields(4, FIELD_V_VALUE2, 4, INT_MAX, NULL, NULL, V_value2_4, &N_slice_4);
+    int expected_get_fields_5 = 0;
+    assert_equals_int(test_get_fields_5, expected_get_fields_5, "Test get_fields(4, FIELD_V_VALUE2, 4, INT_MAX, ...)");
+    assert_equals_int(N_slice_4, 2, "Check that a count that would overflow is clamped to 2 elements");
+
+    // A key that does not exist
+    int test_get_fields_4 = get_fields(5, FIELD_VALUE1, 0, -1, value1_4, NULL, NULL, NULL);
+    int expected_get_fields_4 = -1;
+    assert_equals_int(test_get_fields_4, expected_get_fields_4, "Test get_fields(5, FIELD_VALUE1, 0, -1, ...)");
+
+    int test_delete_key_5 = delete_key(4);
+    int expected_delete_key_5 = 0;
+    assert_equals_int(test_delete_key_5, expected_delete_key_5, "Test delete_key()");
+
+    printf("-------- TESTING SCAN_KEYS --------\n");
+    // Insert the keys 10, 20, ..., 100 in reverse order
+    for (int i = 10; i >= 1; i--){
+        set_value(i * 10, "value_scan", 1, (double[]){1.0});
+    }
+
+    int keys_scan[32];
+    int N_keys_scan;
+    int cursor_scan = 20;
+
+    // Keys in [20, 70], 4 at most: 20, 30, 40, 50 (there are more)
+    int test_scan_keys_1 = scan_keys(20, 70, 4, &cursor_scan, keys_scan, &N_keys_scan);
+    int expected_scan_keys_1 = 1;
+    assert_equals_int(test_scan_keys_1, expected_scan_keys_1, "Test scan_keys(20, 70, 4, ...)");
+    assert_equals_int(N_keys_scan, 4, "Check that 4 keys have been obtained");
+    for (int i = 0; i < N_keys_scan; i++){
+        assert_equals_int(keys_scan[i], 20 + i * 10, "Check that the keys are in order");
+    }
+
+    // Resume from the cursor: 60, 70 (there are no more)
+    int test_scan_keys_2 = scan_keys(20, 70, 4, &cursor_scan, keys_scan, &N_keys_scan);
+    int expected_scan_keys_2 = 0;
+    assert_equals_int(test_scan_keys_2, expected_scan_keys_2, "Test scan_keys(20, 70, 4, ...) from the cursor");
+    assert_equals_int(N_keys_scan, 2, "Check that 2 keys have been obtained");
+    assert_equals_int(keys_scan[0], 60, "Check that the scan has been resumed from the cursor");
+    assert_equals_int(keys_scan[1], 70, "Check that the scan has been resumed from the cursor");
+
+    // Deleted keys are not enumerated
+    delete_key(50);
+    cursor_scan = -1000;
+    int test_scan_keys_3 = scan_keys(-1000, 1000, 32, &cursor_scan, keys_scan, &N_keys_scan);
+    int expected_scan_keys_3 = 0;
+    assert_equals_int(test_scan_keys_3, expected_scan_keys_3, "Test scan_keys(-1000, 1000, 32, ...) after delete_key(50)");
+    assert_equals_int(N_keys_scan, 9, "Check that 9 keys have been obtained");
+
+    for (int i = 1; i <= 10; i++){
+        delete_key(i * 10);
+    }
+
+    printf("-------- TESTING AGGREGATE_VALUES AND FILTER_KEYS --------\n");
+    set_value(1, "value1", 3, (double[]){1.0, 2.0, 3.0});
+    set_value(2, "value2", 2, (double[]){-4.0, 10.0});
+    set_value(3, "value3", 1, (double[]){5.0});
+
+    long count_agg;
+    double sum_agg, min_agg, max_agg;
+    int test_aggregate_values_1 = aggregate_values(-1, &count_agg, &sum_agg, &min_agg, &max_agg);
+    int expected_aggregate_values_1 = 0;
+    assert_equals_int(test_aggregate_values_1, expected_aggregate_values_1, "Test aggregate_values(-1, ...)");
+    assert_equals_int(count_agg, 6, "Check the number of elements");
+    assert_equals_double(sum_agg, 17.0, "Check the sum of the elements");
+    assert_equals_double(min_agg, -4.0, "Check the minimum of the elements");
+    assert_equals_double(max_agg, 10.0, "Check the maximum of the elements");
+
+    // Only the second element of each vector (the tuple 3 does not have it)
+    int test_aggregate_values_2 = aggregate_values(1, &count_agg, &sum_agg, &min_agg, &max_agg);
+    int expected_aggregate_values_2 = 0;
+    assert_equals_int(test_aggregate_values_2, expected_aggregate_values_2, "Test aggregate_values(1, ...)");
+    assert_equals_int(count_agg, 2, "Check the number of elements");
+    assert_equals_double(sum_agg, 12.0, "Check the sum of the elements");
+
+    int keys_filter[32];
+    int N_keys_filter;
+    int test_filter_keys_1 = filter_keys(-1, FILTER_GREATER, 4.5, 32, keys_filter, &N_keys_filter);
+    int expected_filter_keys_1 = 0;
+    assert_equals_int(test_filter_keys_1, expected_filter_keys_1, "Test filter_keys(-1, FILTER_GREATER, 4.5, ...)");
+    assert_equals_int(N_keys_filter, 2, "Check that 2 keys have been found");
+    assert_equals_int(keys_filter[0], 2, "Check the first key found");
+    assert_equals_int(keys_filter[1], 3, "Check the second key found");
+
+    int test_filter_keys_2 = filter_keys(0, FILTER_LESS, 0.0, 32, keys_filter, &N_keys_filter);
+    int expected_filter_keys_2 = 0;
+    assert_equals_int(test_filter_keys_2, expected_filter_keys_2, "Test filter_keys(0, FILTER_LESS, 0.0, ...)");
+    assert_equals_int(N_keys_filter, 1, "Check that 1 key has been found");
+    assert_equals_int(keys_filter[0], 2, "Check the key found");
+
+    delete_key(1);
+    delete_key(2);
+    delete_key(3);
+
+    printf("-------- TESTING KNN_SEARCH --------\n");
+    set_value(1, "value1", 2, (double[]){0.0, 0.0});
+    set_value(2, "value2", 2, (double[]){3.0, 4.0});
+    set_value(3, "value3", 2, (double[]){1.0, 1.0});
+    set_value(4, "value4", 3, (double[]){1.0, 1.0, 1.0});    // Different dimension, it is never a neighbour
+
+    int keys_knn[4];
+    double distances_knn[4];
+    int N_found_knn;
+    int test_knn_search_1 = knn_search(2, KNN_L2, 2, (double[]){0.0, 0.0}, keys_knn, distances_knn, &N_found_knn);
+    int expected_knn_search_1 = 0;
+    assert_equals_int(test_knn_search_1, expected_knn_search_1, "Test knn_search(2, KNN_L2, 2, [0.0, 0.0], ...)");
+    assert_equals_int(N_found_knn, 2, "Check that 2 neighbours have been found");
+    assert_equals_int(keys_knn[0], 1, "Check the nearest neighbour");
+    assert_equals_double(distances_knn[0], 0.0, "Check the distance to the nearest neighbour");
+    assert_equals_int(keys_knn[1], 3, "Check the second nearest neighbour");
+
+    // After modifying the tuple 2 it becomes the nearest one
+    modify_value(2, "value2", 2, (double[]){0.5, 0.5});
+    int test_knn_search_2 = knn_search(4, KNN_L2, 2, (double[]){0.5, 0.5}, keys_knn, distances_knn, &N_found_knn);
+    int expected_knn_search_2 = 0;
+    assert_equals_int(test_knn_search_2, expected_knn_search_2, "Test knn_search(4, KNN_L2, 2, [0.5, 0.5], ...) after modify_value(2, ...)");
+    assert_equals_int(N_found_knn, 3, "Check that 3 neighbours have been found");
+    assert_equals_int(keys_knn[0], 2, "Check the nearest neighbour");
+
+    // Cosine distance: the tuple 1 has no direction, and the tuples 2 and 3 have the same one
+    delete_key(3);
+    int test_knn_search_3 = knn_search(4, KNN_COSINE, 2, (double[]){2.0, 2.0}, keys_knn, distances_knn, &N_found_knn);
+    int expected_knn_search_3 = 0;
+    assert_equals_int(test_knn_search_3, expected_knn_search_3, "Test knn_search(4, KNN_COSINE, 2, [2.0, 2.0], ...) after delete_key(3)");
+    assert_equals_int(N_found_knn, 1, "Check that 1 neighbour has been found");
+    assert_equals_int(keys_knn[0], 2, "Check the nearest neighbour");
+
+    delete_key(1);
+    delete_key(2);
+    delete_key(4);
+
+    printf("-------- TESTING GET_BY_VALUE1 AND PREFIX_VALUE1 --------\n");
+    set_value(1, "apple", 1, (double[]){1.0});
+    set_value(2, "apricot", 1, (double[]){2.0});
+    set_value(3, "banana", 1, (double[]){3.0});
+    set_value(4, "apple", 1, (double[]){4.0});
+
+    int keys_value1[8];
+    int N_keys_value1;
+    int test_get_by_value1_1 = get_by_value1("apple", 8, keys_value1, &N_keys_value1);
+    int expected_get_by_value1_1 = 0;
+    assert_equals_int(test_get_by_value1_1, expected_get_by_value1_1, "Test get_by_value1(\"apple\", ...)");
+    assert_equals_int(N_keys_value1, 2, "Check that 2 keys have been found");
+
+    int test_prefix_value1_1 = prefix_value1("ap", 8, keys_value1, &N_keys_value1);
+    int expected_prefix_value1_1 = 0;
+    assert_equals_int(test_prefix_value1_1, expected_prefix_value1_1, "Test prefix_value1(\"ap\", 8, ...)");
+    assert_equals_int(N_keys_value1, 3, "Check that 3 keys have been found");
+
+    // The index follows modify_value() and delete_key()
+    modify_value(2, "blueberry", 1, (double[]){2.0});
+    delete_key(1);
+    int test_prefix_value1_2 = prefix_value1("ap", 8, keys_value1, &N_keys_value1);
+    int expected_prefix_value1_2 = 0;
+    assert_equals_int(test_prefix_value1_2, expected_prefix_value1_2, "Test prefix_value1(\"ap\", 8, ...) after modify_value(2, ...) and delete_key(1)");
+    assert_equals_int(N_keys_value1, 1, "Check that 1 key has been found");
+    assert_equals_int(keys_value1[0], 4, "Check the key found");
+
+    int test_get_by_value1_2 = get_by_value1("cherry", 8, keys_value1, &N_keys_value1);
+    int expected_get_by_value1_2 = 0;
+    assert_equals_int(test_get_by_value1_2, expected_get_by_value1_2, "Test get_by_value1(\"cherry\", ...)");
+    assert_equals_int(N_keys_value1, 0, "Check that no key has been found");
+
+    delete_key(2);
+    delete_key(3);
+    delete_key(4);
+
+    printf("-------- TESTING ROUND TRIP OF DOUBLES --------\n");
+    double exact_values[6] = {0.1, 1e-7, 1.0 / 3.0, 123456.789012345, -2.5e300, 4.9e-324};
+    set_value(1, "exact", 6, exact_values);
+    char exact_value1[256];
+    int exact_N_value2;
+    double exact_V_value2[32];
+    int test_round_trip_1 = get_value(1, exact_value1, &exact_N_value2, exact_V_value2);
+    int expected_round_trip_1 = 0;
+    assert_equals_int(test_round_trip_1, expected_round_trip_1, "Test get_value(1, ...) with values that %lf does not keep");
+    int same_values = exact_N_value2 == 6;
+    for (int i = 0; i < 6 && same_values; i++)
+    {
+        same_values = exact_V_value2[i] == exact_values[i];
+    }
+    assert_equals_int(same_values, 1, "Check that the values are exactly the same");
+
+    modify_value(1, "exact", 6, exact_values);
+    long exact_count;
+    double exact_sum, exact_min, exact_max;
+    aggregate_values(0, &exact_count, &exact_sum, &exact_min, &exact_max);
+    assert_equals_int(exact_min == 0.1, 1, "Check that aggregate_values() returns the exact element after modify_value(1, ...)");
+    delete_key(1);
+
+    printf("-------- TESTING TTL --------\n");
+    int test_set_value_ttl_1 = set_value_ttl(1, "ttl", 1, (double[]){1.0}, 200);
+    int expected_set_value_ttl_1 = 0;
+    assert_equals_int(test_set_value_ttl_1, expected_set_value_ttl_1, "Test set_value_ttl(1, ..., 200)");
+    assert_equals_int(exist(1), 1, "Check that the key exists before its TTL passes");
+
+    int test_set_value_ttl_2 = set_value_ttl(2, "ttl", 1, (double[]){2.0}, -1);
+    int expected_set_value_ttl_2 = -1;
+    assert_equals_int(test_set_value_ttl_2, expected_set_value_ttl_2, "Test set_value_ttl(2, ..., -1)");
+
+    // modify_value() without TTL clears it, modify_value_ttl() replaces it
+    set_value_ttl(2, "ttl", 1, (double[]){2.0}, 200);
+    int test_modify_value_ttl_1 = modify_value(2, "kept", 1, (double[]){2.0});
+    int expected_modify_value_ttl_1 = 0;
+    assert_equals_int(test_modify_value_ttl_1, expected_modify_value_ttl_1, "Test modify_value(2, ...) of a key with a TTL");
+    set_value_ttl(3, "ttl", 1, (double[]){3.0}, 60000);
+    int test_modify_value_ttl_2 = modify_value_ttl(3, "ttl", 1, (double[]){3.0}, 200);
+    int expected_modify_value_ttl_2 = 0;
+    assert_equals_int(test_modify_value_ttl_2, expected_modify_value_ttl_2, "Test modify_value_ttl(3, ..., 200)");
+
+    usleep(400000);
+    char ttl_value1[256];
+    int ttl_N_value2;
+    double ttl_V_value2[32];
+    assert_equals_int(exist(1), 0, "Check that the key does not exist after its TTL passes");
+    assert_equals_int(get_value(1, ttl_value1, &ttl_N_value2, ttl_V_value2), -1, "Check that get_value() fails after the TTL passes");
+    assert_equals_int(exist(2), 1, "Check that the key whose TTL was cleared still exists");
+    assert_equals_int(exist(3), 0, "Check that the key whose TTL was replaced has expired");
+    int test_set_value_ttl_3 = set_value(1, "again", 1, (double[]){1.0});
+    int expected_set_value_ttl_3 = 0;
+    assert_equals_int(test_set_value_ttl_3, expected_set_value_ttl_3, "Test set_value(1, ...) after the key expired");
+    delete_key(1);
+    delete_key(2);
+
+    printf("-------- TESTING TRANSACTION --------\n");
+    set_value(1, "first", 1, (double[]){10.0});
+    set_value(2, "second", 1, (double[]){20.0});
+    char txn_value1[256];
+    int txn_N_value2;
+    double txn_V_value2[32];
+    uint64_t txn_versions[3];
+    int test_get_value_version_1 = get_value_version(1, txn_value1, &txn_N_value2, txn_V_value2, &txn_versions[0]);
+    int expected_get_value_version_1 = 0;
+    assert_equals_int(test_get_value_version_1, expected_get_value_version_1, "Test get_value_version(1, ...)");
+    assert_equals_int(strcmp(txn_value1, "first") == 0 && txn_V_value2[0] == 10.0, 1, "Check the tuple read with its version");
+    get_value_version(2, txn_value1, &txn_N_value2, txn_V_value2, &txn_versions[1]);
+    int test_get_value_version_2 = get_value_version(3, txn_value1, &txn_N_value2, txn_V_value2, &txn_versions[2]);
+    int expected_get_value_version_2 = 1;
+    assert_equals_int(test_get_value_version_2, expected_get_value_version_2, "Test get_value_version(3, ...) of a key that does not exist");
+
+    // Move 1.0 from key 2 to key 1 and create key 3, if none of them has changed
+    int txn_keys[3] = {1, 2, 3};
+    Escritura txn_writes[3] = {{TXN_PUT, 1, "first", 1, {11.0}}, {TXN_PUT, 2, "second", 1, {19.0}},
+                               {TXN_PUT, 3, "third", 1, {30.0}}};
+    int test_transaction_1 = transaction(3, txn_keys, txn_versions, 3, txn_writes);
+    int expected_transaction_1 = 0;
+    assert_equals_int(test_transaction_1, expected_transaction_1, "Test transaction(...) of keys not written since they were read");
+    get_value(1, txn_value1, &txn_N_value2, txn_V_value2);
+    assert_equals_int(txn_V_value2[0] == 11.0, 1, "Check the first write of the transaction");
+    assert_equals_int(exist(3), 1, "Check that the transaction has created key 3");
+
+    // The same transaction again: the versions read are not the current ones any more
+    int test_transaction_2 = transaction(3, txn_keys, txn_versions, 3, txn_writes);
+    int expected_transaction_2 = 1;
+    assert_equals_int(test_transaction_2, expected_transaction_2, "Test transaction(...) with versions that have changed");
+
+    uint64_t txn_version_2;
+    get_value_version(2, txn_value1, &txn_N_value2, txn_V_value2, &txn_version_2);
+    modify_value(2, "other", 1, (double[]){0.0});
+    Escritura txn_delete[1] = {{.kind = TXN_DELETE, .key = 3}};
+    int test_transaction_3 = transaction(1, (int[]){2}, &txn_version_2, 1, txn_delete);
+    int expected_transaction_3 = 1;
+    assert_equals_int(test_transaction_3, expected_transaction_3, "Test transaction(...) after modify_value() of a key read");
+    assert_equals_int(exist(3), 1, "Check that the rejected transaction has not deleted key 3");
+    int test_transaction_4 = transaction(0, NULL, NULL, 1, txn_delete);
+    int expected_transaction_4 = 0;
+    assert_equals_int(test_transaction_4, expected_transaction_4, "Test transaction(...) without read set");
+    assert_equals_int(exist(3), 0, "Check that the transaction has deleted key 3");
+    int test_transaction_5 = transaction(TXN_MAX_KEYS + 1, txn_keys, txn_versions, 0, NULL);
+    int expected_transaction_5 = -1;
+    assert_equals_int(test_transaction_5, expected_transaction_5, "Test transaction(...) with too many keys read");
+    delete_key(1);
+    delete_key(2);
+
+    // A version read before init() never matches again, not even for a key that did not exist
+    uint64_t txn_version_4;
+    get_value_version(4, txn_value1, &txn_N_value2, txn_V_value2, &txn_version_4);
+    init();
+    set_value(4, "fourth", 1, (double[]){40.0});
+    Escritura txn_put_4[1] = {{TXN_PUT, 4, "other", 1, {0.0}}};
+    int test_transaction_6 = transaction(1, (int[]){4}, &txn_version_4, 1, txn_put_4);
+    int expected_transaction_6 = 1;
+    assert_equals_int(test_transaction_6, expected_transaction_6, "Test transaction(...) with a version read before init()");
+    get_value_version(5, txn_value1, &txn_N_value2, txn_V_value2, &txn_version_4);
+    set_value(5, "fifth", 1, (double[]){50.0});
+    init();
+    int test_transaction_7 = transaction(1, (int[]){5}, &txn_version_4, 1, txn_put_4);
+    int expected_transaction_7 = 1;
+    assert_equals_int(test_transaction_7, expected_transaction_7, "Test transaction(...) of a key created and removed by init() since it was read");
+
+    printf("-------- TESTING SNAPSHOTS --------\n");
+    set_value(1, "one", 2, (double[]){1.0, 2.0});
+    set_value(2, "two", 2, (double[]){3.0, 4.0});
+    long snapshot;
+    int test_snapshot_open_1 = snapshot_open(&snapshot);
+    int expected_snapshot_open_1 = 0;
+    assert_equals_int(test_snapshot_open_1, expected_snapshot_open_1, "Test snapshot_open(...)");
+
+    // Writes after the snapshot: they are not seen through it
+    modify_value(1, "one", 2, (double[]){10.0, 20.0});
+    delete_key(2);
+    set_value(3, "three", 1, (double[]){100.0});
+    long snapshot_count;
+    double snapshot_sum, snapshot_min, snapshot_max;
+    int test_aggregate_values_at_1 = aggregate_values_at(snapshot, -1, &snapshot_count, &snapshot_sum, &snapshot_min, &snapshot_max);
+    int expected_aggregate_values_at_1 = 0;
+    assert_equals_int(test_aggregate_values_at_1, expected_aggregate_values_at_1, "Test aggregate_values_at(snapshot, -1, ...)");
+    assert_equals_int(snapshot_count == 4 && snapshot_sum == 10.0 && snapshot_max == 4.0, 1, "Check the aggregate of the snapshot");
+    aggregate_values(-1, &snapshot_count, &snapshot_sum, &snapshot_min, &snapshot_max);
+    assert_equals_int(snapshot_count == 3 && snapshot_sum == 130.0, 1, "Check the aggregate of the current tuples");
+
+    int snapshot_keys[8];
+    int snapshot_N_keys;
+    int snapshot_cursor = 0;
+    int test_scan_keys_at_1 = scan_keys_at(snapshot, 0, 10, 8, &snapshot_cursor, snapshot_keys, &snapshot_N_keys);
+    int expected_scan_keys_at_1 = 0;
+    assert_equals_int(test_scan_keys_at_1, expected_scan_keys_at_1, "Test scan_keys_at(snapshot, 0, 10, ...)");
+    assert_equals_int(snapshot_N_keys == 2 && snapshot_keys[0] == 1 && snapshot_keys[1] == 2, 1, "Check the keys of the snapshot");
+
+    int test_snapshot_release_1 = snapshot_release(snapshot);
+    int expected_snapshot_release_1 = 0;
+    assert_equals_int(test_snapshot_release_1, expected_snapshot_release_1, "Test snapshot_release(snapshot)");
+    int test_snapshot_release_2 = snapshot_release(snapshot);
+    int expected_snapshot_release_2 = -1;
+    assert_equals_int(test_snapshot_release_2, expected_snapshot_release_2, "Test snapshot_release(snapshot) again");
+    snapshot_cursor = 0;
+    int test_scan_keys_at_2 = scan_keys_at(snapshot, 0, 10, 8, &snapshot_cursor, snapshot_keys, &snapshot_N_keys);
+    int expected_scan_keys_at_2 = -1;
+    assert_equals_int(test_scan_keys_at_2, expected_scan_keys_at_2, "Test scan_keys_at(...) of a released snapshot");
+    delete_key(1);
+    delete_key(3);
+
+    printf("-------- TESTING GET_STATS --------\n");
+    double uptime;
+    long active_connections, queue_depth, malformed;
+    EstadisticasOperacion stats_ops[32];
+    int N_stats_ops;
+    int test_get_stats_1 = get_stats(&uptime, &active_connections, &queue_depth, &malformed, 32, stats_ops, &N_stats_ops);
+    int expected_get_stats_1 = 0;
+    assert_equals_int(test_get_stats_1, expected_get_stats_1, "Test get_stats(...)");
+    assert_equals_int(N_stats_ops > STATS, 1, "Check that there are statistics for every operation code");
+    assert_equals_int(stats_ops[SET_VALUE].requests > 0, 1, "Check that set_value() requests have been counted");
+    assert_equals_int(stats_ops[GET_BY_VALUE1].requests >= 2, 1, "Check that get_by_value1() requests have been counted");
+    assert_equals_int(active_connections >= 1, 1, "Check that the connection of get_stats() is active");
+
+    // A request is recorded after its response has been sent, so the next get_stats() may not count it yet: retry
+    // for a while until the set_value() counter goes up
+    long set_value_requests = stats_ops[SET_VALUE].requests;
+    set_value(1, "stats", 1, (double[]){1.0});
+    int test_get_stats_2;
+    for (int retries = 0; retries < 100; retries++){
+        test_get_stats_2 = get_stats(&uptime, &active_connections, &queue_depth, &malformed, 32, stats_ops, &N_stats_ops);
+        if (test_get_stats_2 != 0 || stats_ops[SET_VALUE].requests > set_value_requests){
+            break;
+        }
+        usleep(10000);
+    }
+    int expected_get_stats_2 = 0;
+    assert_equals_int(test_get_stats_2, expected_get_stats_2, "Test get_stats(...) again");
+    assert_equals_int(stats_ops[SET_VALUE].requests > set_value_requests, 1, "Check that the set_value() request has been counted");
+    assert_equals_int(uptime > 0.0, 1, "Check the uptime");
+    delete_key(1);
+
+    int test_get_stats_3 = get_stats(&uptime, &active_connections, &queue_depth, &malformed, 0, stats_ops, &N_stats_ops);
+    int expected_get_stats_3 = -1;
+    assert_equals_int(test_get_stats_3, expected_get_stats_3, "Test get_stats(..., 0, ...)");
+
     return 0;
 }
\ No newline at end of file
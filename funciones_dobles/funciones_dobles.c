@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "funciones_dobles.h"
+
+#define MAX_EXACT_INTEGER 9007199254740992.0   // 2^53
+#define MAX_FAST_DECIMALS 6                     // Decimals tried by the fast path of dobles_format()
+
+// Powers of ten that are exact in a double
+static const double powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static int format_integer(uint64_t value, char *buffer)
+{
+    char digits[24];
+    int n = 0;
+    do
+    {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value != 0);
+    for (int i = 0; i < n; i++)
+    {
+        buffer[i] = digits[n - 1 - i];
+    }
+    buffer[n] = '\0';
+    return n;
+}
+
+int dobles_format(double value, char *buffer)
+{
+    if (isnan(value) || isinf(value))
+    {
+        return sprintf(buffer, "%s", isnan(value) ? "nan" : (value < 0 ? "-inf" : "inf"));
+    }
+
+    int len = 0;
+    double magnitude = fabs(value);
+    if (signbit(value))
+    {
+        buffer[len++] = '-';
+    }
+
+    // Fast path: value * 10^decimals is an integer that converts back to value
+    if (magnitude < MAX_EXACT_INTEGER)
+    {
+        for (int decimals = 0; decimals <= MAX_FAST_DECIMALS; decimals++)
+        {
+            double scaled = magnitude * powers_of_ten[decimals];
+            if (scaled >= MAX_EXACT_INTEGER)
+            {
+                break;
+            }
+            double integer = nearbyint(scaled);
+            if (integer / powers_of_ten[decimals] != magnitude)
+            {
+                continue;
+            }
+            // integer / 10^decimals is correctly rounded (both are exact) and equals magnitude, so the text
+            // with these decimals converts back to it (and the last decimal is not 0, or fewer decimals would have matched)
+            uint64_t digits = (uint64_t)integer;
+            if (decimals == 0)
+            {
+                return len + format_integer(digits, buffer + len);
+            }
+            uint64_t divisor = (uint64_t)powers_of_ten[decimals];
+            len += format_integer(digits / divisor, buffer + len);
+            buffer[len++] = '.';
+            uint64_t fraction = digits % divisor;
+            for (int i = decimals - 1; i >= 0; i--)
+            {
+                buffer[len + i] = '0' + fraction % 10;
+                fraction /= 10;
+            }
+            len += decimals;
+            buffer[len] = '\0';
+            return len;
+        }
+    }
+
+    // Shortest of 15, 16 and 17 significant digits that converts back to value (17 always does)
+    for (int precision = 15; precision < 17; precision++)
+    {
+        len = sprintf(buffer, "%.*g", precision, value);
+        if (strtod(buffer, NULL) == value)
+        {
+            return len;
+        }
+    }
+    return sprintf(buffer, "%.17g", value);
+}
+
+double dobles_parse(const char *text, char **end)
+{
+    const char *p = text;
+    while (*p == ' ')
+    {
+        p++;
+    }
+
+    int negative = 0;
+    if (*p == '-' || *p == '+')
+    {
+        negative = *p == '-';
+        p++;
+    }
+
+    // Significant digits (at most 19, so that they fit in the mantissa) and decimal exponent
+    uint64_t mantissa = 0;
+    int n_digits = 0;
+    int exponent = 0;
+    int any_digit = 0;
+    while (*p >= '0' && *p <= '9')
+    {
+        if (n_digits < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            n_digits += mantissa != 0;
+        }
+        else
+        {
+            exponent++;
+            n_digits++;
+        }
+        any_digit = 1;
+        p++;
+    }
+    if (*p == '.')
+    {
+        p++;
+        while (*p >= '0' && *p <= '9')
+        {
+            if (n_digits < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                n_digits += mantissa != 0;
+                exponent--;
+            }
+            else
+            {
+                n_digits++;
+            }
+            any_digit = 1;
+            p++;
+        }
+    }
+    if (any_digit && (*p == 'e' || *p == 'E'))
+    {
+        const char *q = p + 1;
+        int exponent_negative = 0;
+        if (*q == '-' || *q == '+')
+        {
+            exponent_negative = *q == '-';
+            q++;
+        }
+        if (*q >= '0' && *q <= '9')
+        {
+            int value = 0;
+            while (*q >= '0' && *q <= '9')
+            {
+                if (value < 100000)
+                {
+                    value = value * 10 + (*q - '0');
+                }
+                q++;
+            }
+            exponent += exponent_negative ? -value : value;
+            p = q;
+        }
+    }
+
+    // Clinger's fast path: the mantissa and the power of ten are exact, so the result is correctly rounded
+    if (any_digit && n_digits <= 19 && mantissa <= (uint64_t)MAX_EXACT_INTEGER && exponent >= -22 && exponent <= 22)
+    {
+        double value = (double)mantissa;
+        value = exponent < 0 ? value / powers_of_ten[-exponent] : value * powers_of_ten[exponent];
+        if (end != NULL)
+        {
+            *end = (char *)p;
+        }
+        return negative ? -value : value;
+    }
+
+    // The rest (more digits, large exponents, nan, inf, hexadecimal...)
+    return strtod(text, end);
+}
@@ -0,0 +1,34 @@
+#ifndef FUNCIONES_DOBLES_H
+#define FUNCIONES_DOBLES_H
+
+/*
+Conversion of doubles to and from the text of the protocol and of the storage file.
+dobles_format() writes the shortest text (up to 17 significant digits) that dobles_parse() (or
+strtod) converts back to exactly the same double, so values survive any number of round trips
+(%lf keeps 6 decimals only). Integers and values with few decimals, the usual ones, are formatted
+from a scaled integer without printf.
+dobles_parse() converts the usual values (up to 19 significant digits and powers of ten up to 22)
+with a single exact multiplication or division (Clinger's fast path) and uses strtod for the rest.
+*/
+
+#define DOBLES_MAX_LEN 32   // Maximum length of the text of a double (including '\0')
+
+/**
+ * @brief Escribe el texto más corto que se convierte de nuevo exactamente en value.
+ * 
+ * @param value valor a escribir.
+ * @param buffer buffer donde se escribe el texto (terminado en '\0') [DOBLES_MAX_LEN].
+ * @return int La función devuelve la longitud del texto.
+ */
+int dobles_format(double value, char *buffer);
+
+/**
+ * @brief Convierte un texto en un double (como strtod).
+ * 
+ * @param text texto a convertir (se ignoran los espacios iniciales).
+ * @param end si no es NULL, se devuelve el primer carácter no convertido.
+ * @return double La función devuelve el valor convertido (0 si el texto no es un número).
+ */
+double dobles_parse(const char *text, char **end);
+
+#endif
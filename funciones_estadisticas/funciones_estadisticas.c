@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "funciones_estadisticas.h"
+
+typedef struct Shard {
+    pthread_mutex_t mutex;              /* Taken by the thread of the shard and by the snapshots */
+    int initialized[STATS_MAX_OPS];
+    EstadisticasOp ops[STATS_MAX_OPS];
+    struct Shard *next;                 /* Next shard in the list of all of them */
+} Shard;
+
+static Shard *shards = NULL;            // List of the shards (one per thread that has recorded)
+static pthread_mutex_t mutex_shards = PTHREAD_MUTEX_INITIALIZER;   // Protects the list, not the shards
+static const char **names;
+static int n_names;
+static uint64_t start;
+static long active_connections, queue_depth, malformed;
+static __thread Shard *shard_of_thread = NULL;
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void estadisticas_init(const char **op_names, int n_ops)
+{
+    names = op_names;
+    n_names = n_ops < STATS_MAX_OPS ? n_ops : STATS_MAX_OPS;
+    start = now_ns();
+}
+
+static Shard *add_shard()
+{
+    // Shard of the calling thread, added to the list the first time it records (NULL if there is no memory)
+    Shard *shard = calloc(1, sizeof(Shard));
+    if (shard == NULL)
+    {
+        return NULL;
+    }
+    pthread_mutex_init(&shard->mutex, NULL);
+    pthread_mutex_lock(&mutex_shards);
+    shard->next = shards;
+    shards = shard;
+    pthread_mutex_unlock(&mutex_shards);
+    return shard;
+}
+
+void estadisticas_record(int op, int failed, uint64_t latency)
+{
+    if (op < 0 || op >= n_names)
+    {
+        return;
+    }
+    if (shard_of_thread == NULL && (shard_of_thread = add_shard()) == NULL)
+    {
+        return;
+    }
+    Shard *shard = shard_of_thread;
+
+    pthread_mutex_lock(&shard->mutex);
+    if (!shard->initialized[op])
+    {
+        histograma_init(&shard->ops[op].latency);
+        shard->initialized[op] = 1;
+    }
+    histograma_record(&shard->ops[op].latency, latency);
+    shard->ops[op].failed += failed;
+    pthread_mutex_unlock(&shard->mutex);
+}
+
+void estadisticas_malformed()
+{
+    __atomic_fetch_add(&malformed, 1, __ATOMIC_RELAXED);
+}
+
+void estadisticas_connections(int delta)
+{
+    __atomic_fetch_add(&active_connections, delta, __ATOMIC_RELAXED);
+}
+
+void estadisticas_queue(int delta)
+{
+    __atomic_fetch_add(&queue_depth, delta, __ATOMIC_RELAXED);
+}
+
+void estadisticas_snapshot(Estadisticas *stats)
+{
+    stats->uptime = (now_ns() - start) / 1e9;
+    stats->active_connections = __atomic_load_n(&active_connections, __ATOMIC_RELAXED);
+    stats->queue_depth = __atomic_load_n(&queue_depth, __ATOMIC_RELAXED);
+    stats->malformed = __atomic_load_n(&malformed, __ATOMIC_RELAXED);
+    stats->n_ops = n_names;
+    for (int op = 0; op < n_names; op++)
+    {
+        histograma_init(&stats->ops[op].latency);
+        stats->ops[op].failed = 0;
+    }
+
+    pthread_mutex_lock(&mutex_shards);
+    for (Shard *shard = shards; shard != NULL; shard = shard->next)
+    {
+        pthread_mutex_lock(&shard->mutex);
+        for (int op = 0; op < n_names; op++)
+        {
+            if (shard->initialized[op])
+            {
+                histograma_merge(&stats->ops[op].latency, &shard->ops[op].latency);
+                stats->ops[op].failed += shard->ops[op].failed;
+            }
+        }
+        pthread_mutex_unlock(&shard->mutex);
+    }
+    pthread_mutex_unlock(&mutex_shards);
+}
+
+int estadisticas_format(const Estadisticas *stats, char *buffer, int size)
+{
+    int len = snprintf(buffer, size,
+                       "tuplas_uptime_seconds %.3f\n"
+                       "tuplas_active_connections %ld\n"
+                       "tuplas_queue_depth %ld\n"
+                       "tuplas_malformed_requests_total %ld\n",
+                       stats->uptime, stats->active_connections, stats->queue_depth, stats->malformed);
+
+    const double quantiles[] = {50, 90, 99, 99.9};
+    for (int op = 0; op < stats->n_ops && len < size; op++)
+    {
+        const Histograma *h = &stats->ops[op].latency;
+        if (h->total == 0)
+        {
+            continue;
+        }
+        len += snprintf(buffer + len, size - len,
+                        "tuplas_requests_total{op=\"%s\"} %lu\n"
+                        "tuplas_errors_total{op=\"%s\"} %ld\n"
+                        "tuplas_throughput{op=\"%s\"} %.3f\n"
+                        "tuplas_latency_mean_us{op=\"%s\"} %.1f\n"
+                        "tuplas_latency_max_us{op=\"%s\"} %.1f\n",
+                        names[op], (unsigned long)h->total, names[op], stats->ops[op].failed,
+                        names[op], stats->uptime > 0.0 ? h->total / stats->uptime : 0.0,
+                        names[op], histograma_mean(h) / 1e3, names[op], h->max / 1e3);
+        for (int q = 0; q < (int)(sizeof(quantiles) / sizeof(quantiles[0])) && len < size; q++)
+        {
+            len += snprintf(buffer + len, size - len, "tuplas_latency_us{op=\"%s\",quantile=\"%g\"} %.1f\n",
+                            names[op], quantiles[q] / 100.0, histograma_percentile(h, quantiles[q]) / 1e3);
+        }
+    }
+    return len < size ? len : size - 1;
+}
@@ -0,0 +1,86 @@
+#ifndef FUNCIONES_ESTADISTICAS_H
+#define FUNCIONES_ESTADISTICAS_H
+
+#include <stdint.h>
+
+#include "../funciones_histograma/funciones_histograma.h"
+
+/*
+Counters and latency histograms of the requests processed by the server.
+Each thread records in its own shard (allocated the first time the thread records), so the threads never
+contend with each other: the lock of a shard is only shared by its thread and the snapshots, which merge all
+of them. The shards are kept after their thread exits, so that its requests are still counted.
+The histograms of each operation are initialized the first time it is recorded, so the memory of the
+operations never used is not touched.
+*/
+
+#define STATS_MAX_OPS 32    // Maximum number of operation codes
+
+typedef struct {
+    Histograma latency;     /* Latency of the requests (ns) */
+    long failed;            /* Requests that returned an error */
+} EstadisticasOp;
+
+typedef struct {
+    double uptime;                          /* Seconds since estadisticas_init() */
+    long active_connections;                /* Connections accepted and not closed yet */
+    long queue_depth;                       /* Requests waiting for the storage */
+    long malformed;                         /* Requests that could not be parsed */
+    int n_ops;                              /* Number of operation codes */
+    EstadisticasOp ops[STATS_MAX_OPS];      /* Statistics of each operation code */
+} Estadisticas;
+
+/**
+ * @brief Inicializa las estadísticas.
+ * 
+ * @param op_names nombres de las operaciones (el índice es el código de operación).
+ * @param n_ops número de códigos de operación (como mucho STATS_MAX_OPS).
+ */
+void estadisticas_init(const char **op_names, int n_ops);
+
+/**
+ * @brief Registra una petición procesada.
+ * 
+ * @param op código de operación.
+ * @param failed 1 si la petición devolvió un error, 0 en otro caso.
+ * @param latency latencia de la petición (ns).
+ */
+void estadisticas_record(int op, int failed, uint64_t latency);
+
+/**
+ * @brief Registra una petición que no se ha podido interpretar.
+ */
+void estadisticas_malformed();
+
+/**
+ * @brief Suma delta al número de conexiones activas.
+ * 
+ * @param delta 1 al aceptar una conexión, -1 al cerrarla.
+ */
+void estadisticas_connections(int delta);
+
+/**
+ * @brief Suma delta al número de peticiones a la espera del almacenamiento.
+ * 
+ * @param delta 1 al empezar a esperar, -1 al dejar de hacerlo.
+ */
+void estadisticas_queue(int delta);
+
+/**
+ * @brief Obtiene una copia de las estadísticas (uniendo todos los fragmentos).
+ * 
+ * @param stats estadísticas (reservadas por el llamador; la estructura ocupa varios MB).
+ */
+void estadisticas_snapshot(Estadisticas *stats);
+
+/**
+ * @brief Escribe las estadísticas en texto plano, una métrica por línea (formato de exposición de Prometheus).
+ * 
+ * @param stats estadísticas obtenidas con estadisticas_snapshot.
+ * @param buffer buffer donde se escribe el texto.
+ * @param size tamaño del buffer.
+ * @return int La función devuelve la longitud del texto (truncado si no cabe en el buffer).
+ */
+int estadisticas_format(const Estadisticas *stats, char *buffer, int size);
+
+#endif
@@ -0,0 +1,91 @@
+#include <string.h>
+
+#include "funciones_histograma.h"
+
+static int bucket_of(uint64_t value)
+{
+    // Values lower than HIST_SUB_BUCKETS have their own bucket (magnitude 0).
+    // The rest go to the magnitude of their highest bit, and to the sub-bucket given by
+    // the HIST_SUB_BITS bits that follow it.
+    if (value < HIST_SUB_BUCKETS)
+    {
+        return (int)value;
+    }
+    int magnitude = 63 - __builtin_clzll(value) - HIST_SUB_BITS + 1;
+    if (magnitude > HIST_MAGNITUDES)
+    {
+        return HIST_BUCKETS - 1;
+    }
+    int sub_bucket = (int)(value >> magnitude) - HIST_SUB_BUCKETS / 2;
+    return magnitude * HIST_SUB_BUCKETS + HIST_SUB_BUCKETS / 2 + sub_bucket;
+}
+
+static uint64_t value_of(int bucket)
+{
+    // Highest value that falls in the bucket
+    int magnitude = bucket / HIST_SUB_BUCKETS;
+    if (magnitude == 0)
+    {
+        return bucket;
+    }
+    uint64_t sub_bucket = bucket % HIST_SUB_BUCKETS;
+    return ((sub_bucket + 1) << magnitude) - 1;
+}
+
+void histograma_init(Histograma *hist)
+{
+    memset(hist, 0, sizeof(Histograma));
+    hist->min = UINT64_MAX;
+}
+
+void histograma_record(Histograma *hist, uint64_t value)
+{
+    hist->counts[bucket_of(value)]++;
+    hist->total++;
+    hist->sum += value;
+    if (value < hist->min) { hist->min = value; }
+    if (value > hist->max) { hist->max = value; }
+}
+
+void histograma_merge(Histograma *hist, const Histograma *other)
+{
+    for (int i = 0; i < HIST_BUCKETS; i++)
+    {
+        hist->counts[i] += other->counts[i];
+    }
+    hist->total += other->total;
+    hist->sum += other->sum;
+    if (other->min < hist->min) { hist->min = other->min; }
+    if (other->max > hist->max) { hist->max = other->max; }
+}
+
+uint64_t histograma_percentile(const Histograma *hist, double percentile)
+{
+    if (hist->total == 0)
+    {
+        return 0;
+    }
+
+    // Rank of the value (1-based) and first bucket where it is reached
+    uint64_t rank = (uint64_t)(percentile / 100.0 * hist->total + 0.5);
+    if (rank < 1) { rank = 1; }
+    if (rank > hist->total) { rank = hist->total; }
+
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++)
+    {
+        seen += hist->counts[i];
+        if (seen >= rank)
+        {
+            uint64_t value = value_of(i);
+            // Never report more than the maximum recorded
+            return value < hist->max ? value : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+double histograma_mean(const Histograma *hist)
+{
+    return hist->total == 0 ? 0.0 : hist->sum / hist->total;
+}
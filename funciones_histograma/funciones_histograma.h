@@ -0,0 +1,67 @@
+#ifndef FUNCIONES_HISTOGRAMA_H
+#define FUNCIONES_HISTOGRAMA_H
+
+#include <stdint.h>
+
+/*
+Latency histogram with logarithmic buckets split in linear sub-buckets (HDR-style).
+Values are recorded in nanoseconds with a relative error lower than 2 / HIST_SUB_BUCKETS
+(< 1.6 %), from 0 ns up to 2^(HIST_MAGNITUDES + HIST_SUB_BITS) ns (about 39 hours); larger
+values are clamped.
+Recording a value is O(1) and does not allocate memory.
+*/
+
+#define HIST_SUB_BITS 7                                 // 128 linear sub-buckets per power of 2
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+#define HIST_MAGNITUDES 40                              // Powers of 2 covered above HIST_SUB_BUCKETS
+#define HIST_BUCKETS ((HIST_MAGNITUDES + 1) * HIST_SUB_BUCKETS)
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];  /* Number of values recorded in each bucket */
+    uint64_t total;                 /* Number of values recorded */
+    uint64_t min;                   /* Minimum value recorded */
+    uint64_t max;                   /* Maximum value recorded */
+    double sum;                     /* Sum of the values recorded (for the mean) */
+} Histograma;
+
+/**
+ * @brief Inicializa un histograma vacío.
+ * 
+ * @param hist histograma.
+ */
+void histograma_init(Histograma *hist);
+
+/**
+ * @brief Registra un valor (en nanosegundos) en el histograma.
+ * 
+ * @param hist histograma.
+ * @param value valor a registrar.
+ */
+void histograma_record(Histograma *hist, uint64_t value);
+
+/**
+ * @brief Añade al histograma hist los valores registrados en el histograma other.
+ * 
+ * @param hist histograma.
+ * @param other histograma a añadir.
+ */
+void histograma_merge(Histograma *hist, const Histograma *other);
+
+/**
+ * @brief Calcula el percentil percentile (entre 0 y 100) de los valores registrados.
+ * 
+ * @param hist histograma.
+ * @param percentile percentil [0-100].
+ * @return uint64_t La función devuelve el valor del percentil (0 si el histograma está vacío).
+ */
+uint64_t histograma_percentile(const Histograma *hist, double percentile);
+
+/**
+ * @brief Calcula la media de los valores registrados.
+ * 
+ * @param hist histograma.
+ * @return double La función devuelve la media (0 si el histograma está vacío).
+ */
+double histograma_mean(const Histograma *hist);
+
+#endif
@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "funciones_log.h"
+
+typedef struct {
+    uint64_t time;                              /* Wall-clock time of the record (ns) */
+    int level;
+    char text[LOG_RECORD_SIZE - 12];
+} Record;
+
+typedef struct {
+    Record records[LOG_RING_RECORDS];
+    unsigned long head;                         /* Records written (only by the owner thread) */
+    unsigned long tail;                         /* Records drained (only by the writer thread) */
+    int in_use;                                 /* The buffer belongs to a thread */
+} Ring;
+
+int log_level = LOG_LEVEL_INFO;
+
+static const char *level_names[] = {"DEBUG", "INFO", "WARN", "ERROR"};
+
+static Ring *rings[LOG_MAX_RINGS];
+static int n_rings;
+static pthread_mutex_t mutex_rings = PTHREAD_MUTEX_INITIALIZER;    // Only taken to get or release a buffer
+static pthread_mutex_t mutex_output = PTHREAD_MUTEX_INITIALIZER;   // Serializes the writes to output
+static pthread_key_t ring_key;
+static __thread Ring *ring_of_thread;
+static FILE *output;
+static int started;
+static long dropped;
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void release_ring(void *arg)
+{
+    // Destructor of ring_key: the buffer of a thread that ends can be used by another one
+    // (the records still pending are drained as usual)
+    Ring *ring = arg;
+    pthread_mutex_lock(&mutex_rings);
+    ring->in_use = 0;
+    pthread_mutex_unlock(&mutex_rings);
+}
+
+static Ring *get_ring()
+{
+    if (ring_of_thread != NULL)
+    {
+        return ring_of_thread;
+    }
+
+    pthread_mutex_lock(&mutex_rings);
+    for (int i = 0; i < n_rings && ring_of_thread == NULL; i++)
+    {
+        if (!rings[i]->in_use)
+        {
+            ring_of_thread = rings[i];
+        }
+    }
+    if (ring_of_thread == NULL && n_rings < LOG_MAX_RINGS)
+    {
+        Ring *ring = calloc(1, sizeof(Ring));
+        if (ring != NULL)
+        {
+            ring_of_thread = ring;
+            // Published after it has been initialized, the writer thread reads n_rings without the lock
+            rings[n_rings] = ring;
+            __atomic_store_n(&n_rings, n_rings + 1, __ATOMIC_RELEASE);
+        }
+    }
+    if (ring_of_thread != NULL)
+    {
+        ring_of_thread->in_use = 1;
+        pthread_setspecific(ring_key, ring_of_thread);
+    }
+    pthread_mutex_unlock(&mutex_rings);
+    return ring_of_thread;
+}
+
+static void write_record(FILE *file, const Record *record)
+{
+    time_t seconds = record->time / 1000000000ull;
+    struct tm tm;
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime_r(&seconds, &tm));
+    fprintf(file, "%s.%06lu %s %s\n", date, (unsigned long)(record->time % 1000000000ull) / 1000,
+            level_names[record->level], record->text);
+}
+
+static int drain()
+{
+    // Write the pending records of every buffer, returns the number of records written
+    int written = 0;
+    int n = __atomic_load_n(&n_rings, __ATOMIC_ACQUIRE);
+
+    pthread_mutex_lock(&mutex_output);
+    for (int i = 0; i < n; i++)
+    {
+        Ring *ring = rings[i];
+        unsigned long head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        for (unsigned long tail = ring->tail; tail != head; tail++)
+        {
+            write_record(output, &ring->records[tail % LOG_RING_RECORDS]);
+            written++;
+        }
+        __atomic_store_n(&ring->tail, head, __ATOMIC_RELEASE);
+    }
+    long lost = __atomic_exchange_n(&dropped, 0, __ATOMIC_RELAXED);
+    if (lost > 0)
+    {
+        Record record = {now_ns(), LOG_LEVEL_WARN, ""};
+        snprintf(record.text, sizeof(record.text), "%ld log records dropped (buffer full)", lost);
+        write_record(output, &record);
+    }
+    if (written > 0 || lost > 0)
+    {
+        fflush(output);
+    }
+    pthread_mutex_unlock(&mutex_output);
+    return written;
+}
+
+static void *run_writer(void *arg)
+{
+    while (1)
+    {
+        if (drain() == 0)
+        {
+            struct timespec ts = {0, 2000000};  // 2 ms when idle
+            nanosleep(&ts, NULL);
+        }
+    }
+    return NULL;
+}
+
+int log_init(const char *path)
+{
+    output = stderr;
+    if (path != NULL && (output = fopen(path, "a")) == NULL)
+    {
+        perror("Error opening the log file\n");
+        output = stderr;
+        return -1;
+    }
+    if (pthread_key_create(&ring_key, release_ring) != 0)
+    {
+        perror("Error creating the log key\n");
+        return -1;
+    }
+
+    pthread_t thread_id;
+    pthread_attr_t t_attr;
+    pthread_attr_init(&t_attr);
+    pthread_attr_setdetachstate(&t_attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread_id, &t_attr, run_writer, NULL) != 0)
+    {
+        perror("Error creating the log thread\n");
+        return -1;
+    }
+    __atomic_store_n(&started, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int log_parse_level(const char *name)
+{
+    const char *names[] = {"debug", "info", "warn", "error", "off"};
+    for (int i = LOG_LEVEL_DEBUG; i <= LOG_LEVEL_OFF; i++)
+    {
+        if (strcmp(name, names[i]) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void log_write(int level, int with_errno, const char *format, ...)
+{
+    int saved_errno = errno;
+    Record record;
+    record.time = now_ns();
+    record.level = level;
+
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(record.text, sizeof(record.text), format, args);
+    va_end(args);
+    if (len >= (int)sizeof(record.text))
+    {
+        len = sizeof(record.text) - 1;
+    }
+    if (with_errno)
+    {
+        char description[128];
+        if (strerror_r(saved_errno, description, sizeof(description)) != 0)
+        {
+            snprintf(description, sizeof(description), "error %d", saved_errno);
+        }
+        snprintf(record.text + len, sizeof(record.text) - len, ": %s", description);
+    }
+
+    Ring *ring = __atomic_load_n(&started, __ATOMIC_ACQUIRE) ? get_ring() : NULL;
+    if (ring == NULL)
+    {
+        // Without the writer thread (or without free buffers) the record is written directly
+        pthread_mutex_lock(&mutex_output);
+        write_record(output != NULL ? output : stderr, &record);
+        pthread_mutex_unlock(&mutex_output);
+    }
+    else if (ring->head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= LOG_RING_RECORDS)
+    {
+        __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+    }
+    else
+    {
+        ring->records[ring->head % LOG_RING_RECORDS] = record;
+        __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+    }
+    errno = saved_errno;
+}
+
+void log_flush()
+{
+    if (__atomic_load_n(&started, __ATOMIC_ACQUIRE))
+    {
+        drain();
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef FUNCIONES_LOG_H
+#define FUNCIONES_LOG_H
+
+/*
+Leveled asynchronous logger.
+Each thread writes its records in its own ring buffer (single producer, single consumer, without
+locks) and a background thread started by log_init() drains all the buffers and writes them. If the
+buffer of a thread is full the record is dropped (and counted) instead of blocking the thread.
+Records of different threads are not ordered among them.
+Before log_init() (or if it has not been called, as in the benchmarks) records are written directly
+to stderr. The macros check the level first, so a filtered record costs a comparison.
+*/
+
+#define LOG_RECORD_SIZE 256     // Maximum size of a record (longer messages are truncated)
+#define LOG_RING_RECORDS 1024   // Records in the buffer of each thread
+#define LOG_MAX_RINGS 64        // Maximum number of buffers (threads beyond it write synchronously)
+
+enum LOG_LEVEL {LOG_LEVEL_DEBUG, LOG_LEVEL_INFO, LOG_LEVEL_WARN, LOG_LEVEL_ERROR, LOG_LEVEL_OFF};
+
+extern int log_level;   // Minimum level of the records written
+
+#define LOG_DEBUG(...) do { if (log_level <= LOG_LEVEL_DEBUG) log_write(LOG_LEVEL_DEBUG, 0, __VA_ARGS__); } while (0)
+#define LOG_INFO(...) do { if (log_level <= LOG_LEVEL_INFO) log_write(LOG_LEVEL_INFO, 0, __VA_ARGS__); } while (0)
+#define LOG_WARN(...) do { if (log_level <= LOG_LEVEL_WARN) log_write(LOG_LEVEL_WARN, 0, __VA_ARGS__); } while (0)
+#define LOG_ERROR(...) do { if (log_level <= LOG_LEVEL_ERROR) log_write(LOG_LEVEL_ERROR, 0, __VA_ARGS__); } while (0)
+// Like perror(): the description of errno is appended to the message
+#define LOG_PERROR(...) do { if (log_level <= LOG_LEVEL_ERROR) log_write(LOG_LEVEL_ERROR, 1, __VA_ARGS__); } while (0)
+
+/**
+ * @brief Arranca el hilo que escribe los registros en path (o en stderr si path es NULL).
+ * 
+ * @param path fichero donde se escriben los registros (se añaden al final), o NULL para stderr.
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ */
+int log_init(const char *path);
+
+/**
+ * @brief Interpreta el nombre de un nivel (debug, info, warn, error u off).
+ * 
+ * @param name nombre del nivel.
+ * @return int La función devuelve el nivel, o -1 si el nombre no es válido.
+ */
+int log_parse_level(const char *name);
+
+/**
+ * @brief Escribe un registro (normalmente a través de las macros LOG_*, que comprueban antes el nivel).
+ * 
+ * @param level nivel del registro.
+ * @param with_errno 1 para añadir la descripción de errno al mensaje.
+ * @param format formato del mensaje (como printf).
+ */
+void log_write(int level, int with_errno, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+/**
+ * @brief Escribe todos los registros pendientes (por ejemplo, antes de terminar el programa).
+ */
+void log_flush();
+
+#endif
@@ -0,0 +1,92 @@
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "funciones_perf.h"
+
+const char *perf_counter_names[PERF_N_COUNTERS] = {"cycles", "instructions", "cache_misses", "branch_misses", "context_switches"};
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} events[PERF_N_COUNTERS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+};
+
+int perf_open(ContadoresPerf *counters)
+{
+    int available = 0;
+    for (int i = 0; i < PERF_N_COUNTERS; i++)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[i].type;
+        attr.config = events[i].config;
+        // Only user space is counted for the hardware counters (context switches happen in the kernel)
+        attr.exclude_kernel = events[i].type == PERF_TYPE_HARDWARE;
+        attr.exclude_hv = 1;
+
+        // Calling thread (pid 0), any CPU
+        counters->fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (counters->fds[i] >= 0)
+        {
+            available++;
+        }
+    }
+    return available;
+}
+
+void perf_read(const ContadoresPerf *counters, LecturaPerf *reading)
+{
+    for (int i = 0; i < PERF_N_COUNTERS; i++)
+    {
+        uint64_t value = 0;
+        if (counters->fds[i] < 0 || read(counters->fds[i], &value, sizeof(value)) != sizeof(value))
+        {
+            value = 0;
+        }
+        reading->values[i] = value;
+    }
+}
+
+void perf_close(ContadoresPerf *counters)
+{
+    for (int i = 0; i < PERF_N_COUNTERS; i++)
+    {
+        if (counters->fds[i] >= 0)
+        {
+            close(counters->fds[i]);
+            counters->fds[i] = -1;
+        }
+    }
+}
+
+int perf_available(const ContadoresPerf *counters, int counter)
+{
+    return counters->fds[counter] >= 0;
+}
+
+void perf_acc_init(AcumuladorPerf *acc)
+{
+    memset(acc, 0, sizeof(AcumuladorPerf));
+}
+
+void perf_acc_add(AcumuladorPerf *acc, const LecturaPerf *start, const LecturaPerf *end)
+{
+    for (int i = 0; i < PERF_N_COUNTERS; i++)
+    {
+        acc->sum.values[i] += end->values[i] - start->values[i];
+    }
+    acc->samples++;
+}
+
+double perf_acc_mean(const AcumuladorPerf *acc, int counter)
+{
+    return acc->samples == 0 ? 0.0 : (double)acc->sum.values[counter] / acc->samples;
+}
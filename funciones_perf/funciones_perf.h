@@ -0,0 +1,90 @@
+#ifndef FUNCIONES_PERF_H
+#define FUNCIONES_PERF_H
+
+#include <stdint.h>
+
+/*
+Hardware and software counters of the calling thread read with perf_event_open(2): cycles,
+instructions, cache misses, branch misses and context switches (only user space is counted for the
+hardware counters, so that they work with perf_event_paranoid <= 2).
+Each counter is opened on its own, so the ones the machine or the container does not allow (for
+example the hardware counters in some virtual machines) are just reported as not available.
+*/
+
+#define PERF_N_COUNTERS 5
+
+enum PERF_COUNTER {PERF_CYCLES, PERF_INSTRUCTIONS, PERF_CACHE_MISSES, PERF_BRANCH_MISSES, PERF_CONTEXT_SWITCHES};
+
+extern const char *perf_counter_names[PERF_N_COUNTERS];
+
+typedef struct {
+    int fds[PERF_N_COUNTERS];           /* Descriptor of each counter (-1 if it is not available) */
+} ContadoresPerf;
+
+typedef struct {
+    uint64_t values[PERF_N_COUNTERS];   /* Value of each counter */
+} LecturaPerf;
+
+typedef struct {
+    LecturaPerf sum;                    /* Sum of the differences accumulated */
+    long samples;                       /* Number of differences accumulated */
+} AcumuladorPerf;
+
+/**
+ * @brief Abre los contadores del hilo que llama a la función.
+ * 
+ * @param counters contadores.
+ * @return int La función devuelve el número de contadores disponibles (0 si no se puede abrir ninguno).
+ */
+int perf_open(ContadoresPerf *counters);
+
+/**
+ * @brief Lee el valor actual de los contadores (0 en los que no están disponibles).
+ * 
+ * @param counters contadores abiertos con perf_open.
+ * @param reading lectura.
+ */
+void perf_read(const ContadoresPerf *counters, LecturaPerf *reading);
+
+/**
+ * @brief Cierra los contadores.
+ * 
+ * @param counters contadores abiertos con perf_open.
+ */
+void perf_close(ContadoresPerf *counters);
+
+/**
+ * @brief Indica si un contador está disponible.
+ * 
+ * @param counters contadores abiertos con perf_open.
+ * @param counter contador (PERF_CYCLES, ...).
+ * @return int La función devuelve 1 si el contador está disponible y 0 en otro caso.
+ */
+int perf_available(const ContadoresPerf *counters, int counter);
+
+/**
+ * @brief Inicializa un acumulador.
+ * 
+ * @param acc acumulador.
+ */
+void perf_acc_init(AcumuladorPerf *acc);
+
+/**
+ * @brief Añade al acumulador la diferencia entre dos lecturas.
+ * 
+ * @param acc acumulador.
+ * @param start lectura al principio de la operación.
+ * @param end lectura al final de la operación.
+ */
+void perf_acc_add(AcumuladorPerf *acc, const LecturaPerf *start, const LecturaPerf *end);
+
+/**
+ * @brief Calcula la media de un contador por operación.
+ * 
+ * @param acc acumulador.
+ * @param counter contador (PERF_CYCLES, ...).
+ * @return double La función devuelve la media (0 si no hay diferencias acumuladas).
+ */
+double perf_acc_mean(const AcumuladorPerf *acc, int counter);
+
+#endif
@@ -0,0 +1,185 @@
+#include <pthread.h>
+
+#include "agregados.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86 1
+#endif
+
+
+// Scalar versions (also used for the tail of the vectorized ones)
+
+static void agregado_vector_scalar(Agregado *agg, const double *v, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        agg->sum += v[i];
+        if (v[i] < agg->min) { agg->min = v[i]; }
+        if (v[i] > agg->max) { agg->max = v[i]; }
+    }
+    agg->count += n;
+}
+
+static int vector_any_match_scalar(const double *v, int n, int cmp, double threshold)
+{
+    for (int i = 0; i < n; i++)
+    {
+        if ((cmp == FILTER_GREATER && v[i] > threshold) || (cmp == FILTER_LESS && v[i] < threshold))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+#ifdef HAVE_X86
+
+// SSE2 versions (always available on x86-64), 2 doubles at a time
+
+static void agregado_vector_sse2(Agregado *agg, const double *v, int n)
+{
+    __m128d sum = _mm_setzero_pd();
+    __m128d min = _mm_set1_pd(agg->min);
+    __m128d max = _mm_set1_pd(agg->max);
+    int i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128d x = _mm_loadu_pd(v + i);
+        sum = _mm_add_pd(sum, x);
+        min = _mm_min_pd(min, x);
+        max = _mm_max_pd(max, x);
+    }
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, sum);
+    agg->sum += lanes[0] + lanes[1];
+    _mm_storeu_pd(lanes, min);
+    agg->min = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+    _mm_storeu_pd(lanes, max);
+    agg->max = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+    agg->count += i;
+
+    agregado_vector_scalar(agg, v + i, n - i);
+}
+
+static int vector_any_match_sse2(const double *v, int n, int cmp, double threshold)
+{
+    __m128d t = _mm_set1_pd(threshold);
+    int i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128d x = _mm_loadu_pd(v + i);
+        __m128d m = cmp == FILTER_GREATER ? _mm_cmpgt_pd(x, t) : _mm_cmplt_pd(x, t);
+        if (_mm_movemask_pd(m))
+        {
+            return 1;
+        }
+    }
+    return vector_any_match_scalar(v + i, n - i, cmp, threshold);
+}
+
+// AVX versions, 4 doubles at a time (only used if the CPU supports AVX)
+
+__attribute__((target("avx")))
+static void agregado_vector_avx(Agregado *agg, const double *v, int n)
+{
+    __m256d sum = _mm256_setzero_pd();
+    __m256d min = _mm256_set1_pd(agg->min);
+    __m256d max = _mm256_set1_pd(agg->max);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d x = _mm256_loadu_pd(v + i);
+        sum = _mm256_add_pd(sum, x);
+        min = _mm256_min_pd(min, x);
+        max = _mm256_max_pd(max, x);
+    }
+
+    double lanes[4];
+    _mm256_storeu_pd(lanes, sum);
+    agg->sum += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    _mm256_storeu_pd(lanes, min);
+    for (int j = 0; j < 4; j++)
+    {
+        if (lanes[j] < agg->min) { agg->min = lanes[j]; }
+    }
+    _mm256_storeu_pd(lanes, max);
+    for (int j = 0; j < 4; j++)
+    {
+        if (lanes[j] > agg->max) { agg->max = lanes[j]; }
+    }
+    agg->count += i;
+
+    agregado_vector_sse2(agg, v + i, n - i);
+}
+
+__attribute__((target("avx")))
+static int vector_any_match_avx(const double *v, int n, int cmp, double threshold)
+{
+    __m256d t = _mm256_set1_pd(threshold);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d x = _mm256_loadu_pd(v + i);
+        __m256d m = cmp == FILTER_GREATER ? _mm256_cmp_pd(x, t, _CMP_GT_OQ) : _mm256_cmp_pd(x, t, _CMP_LT_OQ);
+        if (_mm256_movemask_pd(m))
+        {
+            return 1;
+        }
+    }
+    return vector_any_match_sse2(v + i, n - i, cmp, threshold);
+}
+
+#endif
+
+
+// Kernels selected at run time depending on the CPU
+static void (*agregado_vector_impl)(Agregado *, const double *, int) = agregado_vector_scalar;
+static int (*vector_any_match_impl)(const double *, int, int, double) = vector_any_match_scalar;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+static void select_kernels()
+{
+#ifdef HAVE_X86
+    if (__builtin_cpu_supports("avx"))
+    {
+        agregado_vector_impl = agregado_vector_avx;
+        vector_any_match_impl = vector_any_match_avx;
+    }
+    else
+    {
+        agregado_vector_impl = agregado_vector_sse2;
+        vector_any_match_impl = vector_any_match_sse2;
+    }
+#endif
+}
+
+
+void agregado_init(Agregado *agg)
+{
+    agg->count = 0;
+    agg->sum = 0.0;
+    agg->min = __builtin_inf();
+    agg->max = -__builtin_inf();
+}
+
+void agregado_vector(Agregado *agg, const double *v, int n)
+{
+    pthread_once(&kernels_once, select_kernels);
+    agregado_vector_impl(agg, v, n);
+}
+
+void agregado_merge(Agregado *agg, const Agregado *other)
+{
+    agg->count += other->count;
+    agg->sum += other->sum;
+    if (other->min < agg->min) { agg->min = other->min; }
+    if (other->max > agg->max) { agg->max = other->max; }
+}
+
+int vector_any_match(const double *v, int n, int cmp, double threshold)
+{
+    pthread_once(&kernels_once, select_kernels);
+    return vector_any_match_impl(v, n, cmp, threshold);
+}
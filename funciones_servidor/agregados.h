@@ -0,0 +1,56 @@
+#ifndef AGREGADOS_H
+#define AGREGADOS_H
+
+/*
+Kernels used by the aggregate and filter operations over V_value2.
+They are vectorized with SSE2 (and AVX when the CPU supports it, detected at run time),
+with a scalar fallback for the rest of architectures.
+*/
+
+#define FILTER_GREATER 0    // Predicate: element > threshold
+#define FILTER_LESS 1       // Predicate: element < threshold
+
+typedef struct {
+    long count;     /* Number of elements aggregated */
+    double sum;     /* Sum of the elements */
+    double min;     /* Minimum element */
+    double max;     /* Maximum element */
+} Agregado;
+
+/**
+ * @brief Inicializa un agregado vacío.
+ * 
+ * @param agg agregado.
+ */
+void agregado_init(Agregado *agg);
+
+/**
+ * @brief Añade al agregado los n elementos del vector v.
+ * 
+ * @param agg agregado.
+ * @param v vector de doubles.
+ * @param n número de elementos del vector.
+ */
+void agregado_vector(Agregado *agg, const double *v, int n);
+
+/**
+ * @brief Añade al agregado agg los elementos del agregado other.
+ * 
+ * @param agg agregado.
+ * @param other agregado a añadir.
+ */
+void agregado_merge(Agregado *agg, const Agregado *other);
+
+/**
+ * @brief Determina si algún elemento del vector v cumple el predicado cmp (FILTER_GREATER o FILTER_LESS)
+ * respecto a threshold.
+ * 
+ * @param v vector de doubles.
+ * @param n número de elementos del vector.
+ * @param cmp predicado (FILTER_GREATER o FILTER_LESS).
+ * @param threshold umbral.
+ * @return int La función devuelve 1 si algún elemento cumple el predicado y 0 en caso contrario.
+ */
+int vector_any_match(const double *v, int n, int cmp, double threshold);
+
+#endif
@@ -1,41 +1,184 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include "funciones_servidor.h"
+#include "indice_claves.h"
+#include "indice_tuplas.h"
+#include "indice_vectores.h"
+#include "indice_value1.h"
+#include "../funciones_log/funciones_log.h"
+#include "../funciones_dobles/funciones_dobles.h"
+
+
+static char file_name[PATH_MAX] = FILE_NAME;    // File where the tuples are stored (FILE_NAME by default)
+static struct stat indexed_file;    // State of FILE_NAME when the in-memory indexes were last synchronized with it
+static int index_synced = 0;        // 1 if the in-memory indexes (keys, tuples, vectors, value1) match the content of FILE_NAME
+static int value1_index_enabled = 0;    // 1 if the secondary index over value1 is maintained
+static IndiceClaves key_index = INDICE_CLAVES_INIT;    // Keys stored in FILE_NAME, in order
+static __thread int shared_lookups = 0;    // 1 while the calling thread shares the storage with other readers
+
+static int same_file_state(struct stat *a, struct stat *b)
+{
+    return a->st_dev == b->st_dev && a->st_ino == b->st_ino && a->st_size == b->st_size &&
+           a->st_mtim.tv_sec == b->st_mtim.tv_sec && a->st_mtim.tv_nsec == b->st_mtim.tv_nsec;
+}
+
+static void clear_indexes()
+{
+    indice_claves_clear(&key_index);
+    indice_tuplas_clear();
+    indice_vectores_clear();
+    indice_value1_clear();
+}
+
+static int sync_indexes()
+{
+    // Rebuild the in-memory indexes if FILE_NAME has been changed by someone else (or has never been read)
+    // Other threads may be reading them while the storage is shared: then they are used as they are (the server
+    // only shares the storage while they are in sync, so the read is ordered before the change of the file)
+    if (shared_lookups)
+    {
+        return index_synced ? 0 : -1;
+    }
+
+    struct stat file_state;
+    if (stat(file_name, &file_state) != 0)
+    {
+        // There is no file, so there are no keys
+        clear_indexes();
+        index_synced = 0;
+        return -1;
+    }
+
+    if (index_synced && same_file_state(&file_state, &indexed_file))
+    {
+        return 0;
+    }
+
+    FILE *file = fopen(file_name, "r");
+    if (file == NULL)
+    {
+        LOG_PERROR("Error opening the file");
+        return -1;
+    }
+
+    int key_file;
+    char doubles_vector[800];
+    char value1_file[256];
+    int N_value2_file;
+    double V_value2_file[32];
+
+    clear_indexes();
+    long offset = 0;    // Offset of the line (the table of tuples keeps it to read the line again if it is evicted)
+    while (fscanf(file, "%d %s %d %[^\n]\n", &key_file, value1_file, &N_value2_file, doubles_vector) != EOF)
+    {
+        char *ptr = doubles_vector;
+        for (int i = 0; i < N_value2_file && i < 32; i++)
+        {
+            V_value2_file[i] = dobles_parse(ptr, &ptr);
+        }
+
+        if (indice_claves_insert(&key_index, key_file) == NULL || indice_tuplas_insert(key_file, value1_file, N_value2_file, V_value2_file, offset) < 0 ||
+            indice_vectores_insert(key_file, N_value2_file, V_value2_file) < 0 ||
+            (value1_index_enabled && indice_value1_insert(value1_file, key_file) < 0))
+        {
+            LOG_PERROR("Error inserting the key in the indexes");
+            clear_indexes();
+            index_synced = 0;
+            fclose(file);
+            return -1;
+        }
+        offset = ftell(file);
+    }
+    fclose(file);
+
+    indexed_file = file_state;
+    index_synced = 1;
+    return 0;
+}
+
+static int read_tuple(long offset, int key, char *value1, int *N_value2, double *V_value2)
+{
+    // Read the tuple of the key from its line at offset in FILE_NAME (a tuple evicted from memory)
+    FILE *file = fopen(file_name, "r");
+    if (file == NULL)
+    {
+        LOG_PERROR("Error opening the file");
+        return -1;
+    }
+
+    int key_file;
+    char doubles_vector[800];
+    if (fseek(file, offset, SEEK_SET) != 0 ||
+        fscanf(file, "%d %s %d %[^\n]\n", &key_file, value1, N_value2, doubles_vector) != 4 || key_file != key ||
+        *N_value2 < 1 || *N_value2 > 32)
+    {
+        LOG_ERROR("The line of the key %d is not at offset %ld", key, offset);
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+
+    char *ptr = doubles_vector;
+    for (int i = 0; i < *N_value2; i++)
+    {
+        V_value2[i] = dobles_parse(ptr, &ptr);
+    }
+    return 0;
+}
+
+static void remember_file_state()
+{
+    // Called after every write of the server to FILE_NAME, once the indexes have been updated accordingly
+    if (index_synced && stat(file_name, &indexed_file) != 0)
+    {
+        index_synced = 0;
+    }
+}
 
 
 int init()
 {
     // Try opening the FILE_NAME file
-    FILE *file = fopen(FILE_NAME, "r");
+    FILE *file = fopen(file_name, "r");
     if (file == NULL)
     {
         // If the file does not exist, create it
-        file = fopen(FILE_NAME, "w");
+        file = fopen(file_name, "w");
         if (file == NULL)
         {
-            perror("Error creating the file\n");
+            LOG_PERROR("Error creating the file");
             return -1;
         }
+        fclose(file);
     }
     else
     {
         // If the file exists, delete it and create a new one
-        if (remove(FILE_NAME) != 0)
+        if (remove(file_name) != 0)
         {
-            perror("Error deleting the file\n");
+            LOG_PERROR("Error deleting the file");
             return -1;
         }
-        file = fopen(FILE_NAME, "w");
+        file = fopen(file_name, "w");
         if (file == NULL)
         {
-            perror("Error creating the file\n");
+            LOG_PERROR("Error creating the file");
             return -1;
         }
         // Close the file
         fclose(file);
     }
+
+    // The file is empty, so are the indexes
+    clear_indexes();
+    index_synced = 1;
+    remember_file_state();
     return 0;
 }
 
@@ -45,10 +188,13 @@ int set_value(int key, char *value1, int N_value2, double *V_value2)
     // Check that N_value2 is between 1 and 32
     if (N_value2 < 1 || N_value2 > 32)
     {
-        perror("N_value2 must be between 1 and 32\n");
+        LOG_DEBUG("N_value2 must be between 1 and 32");
         return -1;
     }
 
+    // Make sure the indexes are up to date before changing the file
+    sync_indexes();
+
     // Check if the key already exists with the exist function (exist returns 0)
     // We also check if the file exists with the exist function (exist returns -1)
     int exist_value = exist(key);
@@ -58,31 +204,35 @@ int set_value(int key, char *value1, int N_value2, double *V_value2)
     }
     else if (exist_value == 1)
     {
-        perror("The key already exists\n");
+        LOG_DEBUG("The key %d already exists", key);
         return -1;
     }
 
     // If the key does not exist, add it at the end of the file
-    FILE *file = fopen(FILE_NAME, "a");
+    FILE *file = fopen(file_name, "a");
     if (file == NULL)
     {
-        perror("Error opening the file\n");
+        LOG_PERROR("Error opening the file");
         return -1;
     }
+    fseek(file, 0, SEEK_END);
+    long offset = ftell(file);
 
     // Write the key, value1, N_value2 to the file
     if (fprintf(file, "%d %s %d", key, value1, N_value2) < 0)
     {
-        perror("Error writing to the file\n");
+        LOG_PERROR("Error writing to the file");
         fclose(file);
         return -1;
     }
     // Write the values of the vector V_value2 to the file
     for (int i = 0; i < N_value2; i++)
     {   
-        if (fprintf(file, " %lf", V_value2[i]) < 0)
+        char value[DOBLES_MAX_LEN];
+        dobles_format(V_value2[i], value);
+        if (fprintf(file, " %s", value) < 0)
         {
-            perror("Error writing to the file\n");
+            LOG_PERROR("Error writing to the file");
             fclose(file);
             return -1;
         }
@@ -91,22 +241,50 @@ int set_value(int key, char *value1, int N_value2, double *V_value2)
     // Write a new line to the file
     if (fprintf(file, "\n") < 0)
     {
-        perror("Error writing to the file\n");
+        LOG_PERROR("Error writing to the file");
         fclose(file);
         return -1;
     }
 
     fclose(file);
+
+    // Add the key, the tuple, its vector and its value1 to the indexes
+    if (index_synced && (indice_claves_insert(&key_index, key) == NULL || indice_tuplas_insert(key, value1, N_value2, V_value2, offset) < 0 ||
+                         indice_vectores_insert(key, N_value2, V_value2) < 0 ||
+                         (value1_index_enabled && indice_value1_insert(value1, key) < 0)))
+    {
+        index_synced = 0;
+    }
+    remember_file_state();
     return 0;
 }
 
 int get_value(int key, char *value1, int *N_value2, double *V_value2)
 {   
-    // Try opening the FILE_NAME file
-    FILE *file = fopen(FILE_NAME, "r");
+    // Look the key up in the table of tuples (rebuilding the indexes if the file has changed)
+    if (sync_indexes() == 0)
+    {
+        long offset;
+        int res = indice_tuplas_get(key, value1, N_value2, V_value2, &offset);
+        if (res != 1)
+        {
+            return res;
+        }
+
+        // The tuple has been evicted: read its line and keep it in memory again
+        if (read_tuple(offset, key, value1, N_value2, V_value2) < 0)
+        {
+            return -1;
+        }
+        indice_tuplas_insert(key, value1, *N_value2, V_value2, offset);
+        return 0;
+    }
+
+    // If the indexes cannot be built, read the file: try opening the FILE_NAME file
+    FILE *file = fopen(file_name, "r");
     if (file == NULL)
     {
-        perror("Error opening the file\n");
+        LOG_PERROR("Error opening the file");
         return -1;
     }
 
@@ -128,14 +306,10 @@ int get_value(int key, char *value1, int *N_value2, double *V_value2)
         {
             strcpy(value1, value1_file);
             *N_value2 = N_value2_file;
-            // add an extra space at the end of the doubles_vector
-            strcat(doubles_vector, " ");
             char *ptr = doubles_vector;
             for (int i = 0; i < N_value2_file; i++)
             { 
-                sscanf(ptr, "%lf ", &V_value2_file[i]);
-                // Advance the pointer to the next double
-                ptr += strcspn(ptr, " ") + 1;
+                V_value2_file[i] = dobles_parse(ptr, &ptr);
             }
             // Copy the values to the output variables
             for (int i = 0; i < N_value2_file; i++)
@@ -158,7 +332,7 @@ int modify_value(int key, char *value1, int N_value2, double *V_value2)
     // Check that N_value2 is between 1 and 32
     if (N_value2 < 1 || N_value2 > 32)
     {
-        perror("N_value2 must be between 1 and 32\n");
+        LOG_DEBUG("N_value2 must be between 1 and 32");
         return -1;
     }
 
@@ -178,6 +352,9 @@ int modify_value(int key, char *value1, int N_value2, double *V_value2)
 
 int delete_key(int key)
 {
+    // Make sure the indexes are up to date before changing the file
+    sync_indexes();
+
     // Check if the key exists with the exist 
     if (exist(key) <= 0)
     {
@@ -185,24 +362,27 @@ int delete_key(int key)
     }
 
     // Try opening the FILE_NAME file
-    FILE *file = fopen(FILE_NAME, "r");
+    FILE *file = fopen(file_name, "r");
     if (file == NULL)
     {
-        perror("Error opening the file\n");
+        LOG_PERROR("Error opening the file");
         return -1;
     }
 
     int key_file;
     char doubles_vector[799];
     char value1_file[256];
+    char deleted_value1[256] = "";
     int N_value2_file;
     double V_value2_file[32];
 
     // Create a temporary file
-    FILE *temp_file = fopen("temp_file.txt", "w");
+    char temp_name[PATH_MAX + 8];
+    snprintf(temp_name, sizeof(temp_name), "%s.tmp", file_name);
+    FILE *temp_file = fopen(temp_name, "w");
     if (temp_file == NULL)
     {
-        perror("Error creating the temporary file\n");
+        LOG_PERROR("Error creating the temporary file");
         return -1;
     }
 
@@ -211,13 +391,24 @@ int delete_key(int key)
     {
         // If the key is found, do not write it to the temporary file
         // (We copy all the lines except the one with the key to delete to the temporary file)
-        if (key_file != key)
+        if (key_file == key)
         {
+            // Keep its value1 to remove it from the value1 index
+            strcpy(deleted_value1, value1_file);
+        }
+        else
+        {
+            // The lines after the deleted one move back in the new file
+            if (index_synced)
+            {
+                indice_tuplas_set_offset(key_file, ftell(temp_file));
+            }
             if (fprintf(temp_file, "%d %s %d %s\n", key_file, value1_file, N_value2_file, doubles_vector) < 0)
             {
-                perror("Error writing to the temporary file\n");
+                LOG_PERROR("Error writing to the temporary file");
                 fclose(file);
                 fclose(temp_file);
+                index_synced = 0;
                 return -1;
             }
         }
@@ -228,30 +419,47 @@ int delete_key(int key)
     fclose(temp_file);
 
     // Delete the original file
-    if (remove(FILE_NAME) != 0)
+    if (remove(file_name) != 0)
     {
-        perror("Error deleting the file\n");
+        LOG_PERROR("Error deleting the file");
+        index_synced = 0;
         return -1;
     }
 
     // Rename the temporary file to the original file
-    if (rename("temp_file.txt", FILE_NAME) != 0)
+    if (rename(temp_name, file_name) != 0)
     {
-        perror("Error renaming the file\n");
+        LOG_PERROR("Error renaming the file");
+        index_synced = 0;
         return -1;
     }
 
+    // Remove the key, the tuple, its vector and its value1 from the indexes
+    indice_claves_remove(&key_index, key);
+    indice_tuplas_remove(key);
+    indice_vectores_remove(key);
+    if (value1_index_enabled)
+    {
+        indice_value1_remove(deleted_value1, key);
+    }
+    remember_file_state();
     return 0;
 }
 
 
 int exist(int key)
 {
-    // Try opening the FILE_NAME file
-    FILE *file = fopen(FILE_NAME, "r");
+    // Look the key up in the table of tuples (rebuilding the indexes if the file has changed)
+    if (sync_indexes() == 0)
+    {
+        return indice_tuplas_exists(key);
+    }
+
+    // If the indexes cannot be built, read the file: try opening the FILE_NAME file
+    FILE *file = fopen(file_name, "r");
     if (file == NULL)
     {
-        perror("Error opening the file\n");
+        LOG_PERROR("Error opening the file");
         return -1;
     }
 
@@ -275,4 +483,421 @@ int exist(int key)
     // If the key is not found, return 0
     fclose(file);
     return 0;
-}
\ No newline at end of file
+}
+
+
+int scan_keys(int start_key, int end_key, int limit, int *keys)
+{
+    // Check the arguments
+    if (limit < 1 || keys == NULL)
+    {
+        return -1;
+    }
+
+    // Rebuild the indexes if the file has changed (and fail if there is no file, like exist())
+    if (sync_indexes() < 0)
+    {
+        return -1;
+    }
+
+    if (start_key > end_key)
+    {
+        return 0;
+    }
+
+    return indice_claves_scan(&key_index, start_key, end_key, limit, keys);
+}
+
+
+#define MAX_SCAN_THREADS 16             // Maximum number of threads used to scan the file
+#define MIN_BYTES_PER_THREAD (64 * 1024) // Smaller files are not worth splitting
+
+typedef struct {
+    const char *start;      /* First byte of the part of the file (beginning of a line) */
+    const char *end;        /* End of the part of the file (after a new line) */
+    int element;            /* Element of V_value2 to consider, -1 for all of them */
+    int cmp;                /* Predicate of the filter (FILTER_GREATER or FILTER_LESS), -1 to aggregate */
+    double threshold;       /* Threshold of the filter */
+    Agregado agg;           /* Partial aggregate of the part */
+    int *keys;              /* Keys that match the filter in the part */
+    int N_keys;             /* Number of keys in keys */
+    int capacity;           /* Capacity of keys */
+    int error;              /* -1 if there has been an error */
+} ScanPart;
+
+static char *read_file(size_t *len)
+{
+    // Read the whole FILE_NAME to memory (with a '\0' at the end)
+    FILE *file = fopen(file_name, "r");
+    if (file == NULL)
+    {
+        LOG_PERROR("Error opening the file");
+        return NULL;
+    }
+
+    struct stat file_state;
+    if (fstat(fileno(file), &file_state) != 0)
+    {
+        LOG_PERROR("Error reading the file");
+        fclose(file);
+        return NULL;
+    }
+
+    char *data = malloc(file_state.st_size + 1);
+    if (data == NULL)
+    {
+        LOG_PERROR("Error allocating memory");
+        fclose(file);
+        return NULL;
+    }
+
+    *len = fread(data, 1, file_state.st_size, file);
+    data[*len] = '\0';
+    fclose(file);
+    return data;
+}
+
+static void *scan_part(void *arg)
+{
+    // Parse the lines of a part of the file and aggregate/filter their V_value2
+    ScanPart *part = arg;
+    const char *ptr = part->start;
+    double V_value2[32];
+
+    agregado_init(&part->agg);
+    while (ptr < part->end)
+    {
+        // Each line is: key value1 N_value2 V_value2[0] ... V_value2[N_value2 - 1]
+        char *next;
+        int key = strtol(ptr, &next, 10);
+        if (next == ptr)
+        {
+            break;  // Empty line at the end of the file
+        }
+        next += strspn(next, " ");
+        next += strcspn(next, " ");     // Skip value1
+        int N_value2 = strtol(next, &next, 10);
+        if (N_value2 < 1 || N_value2 > 32)
+        {
+            part->error = -1;
+            return NULL;
+        }
+        for (int i = 0; i < N_value2; i++)
+        {
+            V_value2[i] = dobles_parse(next, &next);
+        }
+        ptr = next + strspn(next, " \n");
+
+        // Select the elements to consider
+        const double *v = V_value2;
+        int n = N_value2;
+        if (part->element >= 0)
+        {
+            if (part->element >= N_value2)
+            {
+                continue;
+            }
+            v = V_value2 + part->element;
+            n = 1;
+        }
+
+        if (part->cmp < 0)
+        {
+            agregado_vector(&part->agg, v, n);
+        }
+        else if (vector_any_match(v, n, part->cmp, part->threshold))
+        {
+            if (part->N_keys == part->capacity)
+            {
+                int capacity = part->capacity == 0 ? 256 : 2 * part->capacity;
+                int *keys = realloc(part->keys, capacity * sizeof(int));
+                if (keys == NULL)
+                {
+                    part->error = -1;
+                    return NULL;
+                }
+                part->keys = keys;
+                part->capacity = capacity;
+            }
+            part->keys[part->N_keys++] = key;
+        }
+    }
+    return NULL;
+}
+
+static int scan_file_parallel(ScanPart *parts, int *N_parts, int element, int cmp, double threshold, char **data)
+{
+    // Read the file and split it in parts (at line boundaries) that are scanned in parallel
+    size_t len;
+    *data = read_file(&len);
+    if (*data == NULL)
+    {
+        return -1;
+    }
+
+    long n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n_threads < 1) { n_threads = 1; }
+    if (n_threads > MAX_SCAN_THREADS) { n_threads = MAX_SCAN_THREADS; }
+    if ((size_t)n_threads > len / MIN_BYTES_PER_THREAD) { n_threads = len / MIN_BYTES_PER_THREAD; }
+    if (n_threads < 1) { n_threads = 1; }
+
+    const char *start = *data;
+    const char *end_of_file = *data + len;
+    for (int i = 0; i < n_threads; i++)
+    {
+        const char *end = i == n_threads - 1 ? end_of_file : *data + len * (i + 1) / n_threads;
+        // Move the end of the part to the end of the line
+        while (end < end_of_file && end > start && end[-1] != '\n')
+        {
+            end++;
+        }
+        memset(&parts[i], 0, sizeof(ScanPart));
+        parts[i].start = start;
+        parts[i].end = end < start ? start : end;
+        parts[i].element = element;
+        parts[i].cmp = cmp;
+        parts[i].threshold = threshold;
+        start = parts[i].end;
+    }
+    *N_parts = n_threads;
+
+    // The first part is scanned by the calling thread
+    pthread_t threads[MAX_SCAN_THREADS];
+    int created[MAX_SCAN_THREADS] = {0};
+    for (int i = 1; i < n_threads; i++)
+    {
+        created[i] = pthread_create(&threads[i], NULL, scan_part, &parts[i]) == 0;
+        if (!created[i])
+        {
+            scan_part(&parts[i]);
+        }
+    }
+    scan_part(&parts[0]);
+    for (int i = 1; i < n_threads; i++)
+    {
+        if (created[i])
+        {
+            pthread_join(threads[i], NULL);
+        }
+    }
+    return 0;
+}
+
+int aggregate_values(int element, Agregado *agg)
+{
+    // Check the arguments
+    if (element < -1 || element > 31 || agg == NULL)
+    {
+        return -1;
+    }
+
+    ScanPart parts[MAX_SCAN_THREADS];
+    int N_parts;
+    char *data;
+    if (scan_file_parallel(parts, &N_parts, element, -1, 0.0, &data) < 0)
+    {
+        return -1;
+    }
+
+    int res = 0;
+    agregado_init(agg);
+    for (int i = 0; i < N_parts; i++)
+    {
+        agregado_merge(agg, &parts[i].agg);
+        if (parts[i].error < 0) { res = -1; }
+    }
+    free(data);
+    return res;
+}
+
+int filter_keys(int element, int cmp, double threshold, int **keys)
+{
+    // Check the arguments
+    if (element < -1 || element > 31 || (cmp != FILTER_GREATER && cmp != FILTER_LESS) || keys == NULL)
+    {
+        return -1;
+    }
+
+    ScanPart parts[MAX_SCAN_THREADS];
+    int N_parts;
+    char *data;
+    if (scan_file_parallel(parts, &N_parts, element, cmp, threshold, &data) < 0)
+    {
+        return -1;
+    }
+    free(data);
+
+    // Join the keys of all the parts (in the order of the file)
+    int N_keys = 0;
+    int res = 0;
+    for (int i = 0; i < N_parts; i++)
+    {
+        N_keys += parts[i].N_keys;
+        if (parts[i].error < 0) { res = -1; }
+    }
+
+    *keys = res == 0 ? malloc((N_keys > 0 ? N_keys : 1) * sizeof(int)) : NULL;
+    if (*keys == NULL)
+    {
+        res = -1;
+    }
+    N_keys = 0;
+    for (int i = 0; i < N_parts; i++)
+    {
+        if (res == 0)
+        {
+            memcpy(*keys + N_keys, parts[i].keys, parts[i].N_keys * sizeof(int));
+            N_keys += parts[i].N_keys;
+        }
+        free(parts[i].keys);
+    }
+    return res == 0 ? N_keys : -1;
+}
+
+int knn_search(int k, int metric, int N_value2, double *V_value2, int *keys, double *distances)
+{
+    // Check the arguments
+    if (k < 1 || k > KNN_MAX_K || (metric != KNN_L2 && metric != KNN_COSINE) || N_value2 < 1 || N_value2 > 32 ||
+        V_value2 == NULL || keys == NULL || distances == NULL)
+    {
+        return -1;
+    }
+
+    // Rebuild the indexes if the file has changed (and fail if there is no file, like exist())
+    if (sync_indexes() < 0)
+    {
+        return -1;
+    }
+
+    return indice_vectores_knn(k, metric, N_value2, V_value2, keys, distances);
+}
+
+int set_file_name(const char *name)
+{
+    if (name == NULL || strlen(name) >= PATH_MAX)
+    {
+        return -1;
+    }
+    strcpy(file_name, name);
+    index_synced = 0;
+    return 0;
+}
+
+void enable_value1_index(int enabled)
+{
+    value1_index_enabled = enabled;
+
+    // Build (or free) the index the next time it is needed
+    indice_value1_clear();
+    index_synced = 0;
+}
+
+void set_max_memory(long bytes)
+{
+    indice_tuplas_set_max_memory(bytes);
+}
+
+void get_tiers(NivelesTuplas *tiers)
+{
+    indice_tuplas_stats(tiers);
+}
+
+int tuple_resident(int key)
+{
+    return indice_tuplas_resident(key);
+}
+
+void set_shared_lookups(int shared)
+{
+    shared_lookups = shared;
+}
+
+int indexes_synced()
+{
+    struct stat file_state;
+    return index_synced && stat(file_name, &file_state) == 0 && same_file_state(&file_state, &indexed_file);
+}
+
+static int find_value1(char *value1, int exact, int limit, int **keys)
+{
+    // Find the keys whose value1 is value1 (or starts with it), at most limit of them
+    // The vector of keys is allocated with malloc
+    if (value1_index_enabled)
+    {
+        // Probe the index
+        if (sync_indexes() < 0)
+        {
+            return -1;
+        }
+        // Count only up to limit, so that a short prefix does not walk the rest of the index
+        int N_keys = indice_value1_count(value1, exact, limit);
+        *keys = malloc((N_keys > 0 ? N_keys : 1) * sizeof(int));
+        if (*keys == NULL)
+        {
+            LOG_PERROR("Error allocating memory");
+            return -1;
+        }
+        return indice_value1_find(value1, exact, N_keys, *keys);
+    }
+
+    // Without the index, read the whole file
+    FILE *file = fopen(file_name, "r");
+    if (file == NULL)
+    {
+        LOG_PERROR("Error opening the file");
+        return -1;
+    }
+
+    int key_file;
+    char doubles_vector[800];
+    char value1_file[256];
+    int N_value2_file;
+    size_t len = strlen(value1);
+    int N_keys = 0;
+    int capacity = 0;
+    *keys = NULL;
+
+    while (N_keys < limit && fscanf(file, "%d %s %d %[^\n]\n", &key_file, value1_file, &N_value2_file, doubles_vector) != EOF)
+    {
+        if (exact ? strcmp(value1_file, value1) != 0 : strncmp(value1_file, value1, len) != 0)
+        {
+            continue;
+        }
+        if (N_keys == capacity)
+        {
+            capacity = capacity == 0 ? 64 : 2 * capacity;
+            int *new_keys = realloc(*keys, capacity * sizeof(int));
+            if (new_keys == NULL)
+            {
+                LOG_PERROR("Error allocating memory");
+                free(*keys);
+                fclose(file);
+                return -1;
+            }
+            *keys = new_keys;
+        }
+        (*keys)[N_keys++] = key_file;
+    }
+    fclose(file);
+    return N_keys;
+}
+
+int get_by_value1(char *value1, int **keys)
+{
+    // Check the arguments
+    if (value1 == NULL || value1[0] == '\0' || keys == NULL)
+    {
+        return -1;
+    }
+    return find_value1(value1, 1, INT_MAX, keys);
+}
+
+int prefix_value1(char *prefix, int limit, int **keys)
+{
+    // Check the arguments
+    if (prefix == NULL || prefix[0] == '\0' || limit < 1 || keys == NULL)
+    {
+        return -1;
+    }
+    return find_value1(prefix, 0, limit, keys);
+}
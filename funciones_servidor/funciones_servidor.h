@@ -1,9 +1,13 @@
 #ifndef FUNCIONES_SERVIDOR_H
 #define FUNCIONES_SERVIDOR_H
 
+#include "agregados.h"
+#include "indice_vectores.h"
+#include "indice_tuplas.h"
+
 #define FILE_NAME "tuplas.txt"
 
-enum OPERATION_CODE {INIT, SET_VALUE, GET_VALUE, MODIFY_VALUE, DELETE_KEY, EXIST};
+enum OPERATION_CODE {INIT, SET_VALUE, GET_VALUE, MODIFY_VALUE, DELETE_KEY, EXIST, GET_FIELDS, SCAN, AGGREGATE, FILTER, KNN, GET_BY_VALUE1, PREFIX_VALUE1, STATS, GET_VERSIONED, TRANSACTION, SNAPSHOT, RELEASE_SNAPSHOT};
 
 /**
  * @brief Esta llamada permite inicializar el servicio de elementos clave-valor1-valor2.
@@ -99,4 +103,166 @@ int delete_key(int key);
  */
 int exist(int key);
 
+/**
+ * @brief Este servicio permite enumerar en orden ascendente las claves almacenadas que están en el rango
+ * [start_key, end_key]. Se copian en keys como mucho limit claves. Las claves se obtienen de un índice
+ * ordenado que se mantiene en memoria, sin recorrer el fichero.
+ * Esta función se llama desde el servidor tras recibir una petición de un cliente.
+ * 
+ * @param start_key primera clave del rango (incluida).
+ * @param end_key última clave del rango (incluida).
+ * @param limit número máximo de claves a copiar [>= 1].
+ * @param keys vector donde se copian las claves [limit].
+ * @return int La función devuelve el número de claves copiadas en keys. En caso de error se devuelve -1.
+ * @retval >= 0 número de claves copiadas.
+ * @retval -1 en caso de error.
+ */
+int scan_keys(int start_key, int end_key, int limit, int *keys);
+
+/**
+ * @brief Este servicio calcula en el servidor el número de elementos, la suma, el mínimo y el máximo de los
+ * elementos de V_value2 de todas las tuplas almacenadas. Si element es -1 se consideran todos los elementos
+ * de cada vector y si no solo el elemento element (las tuplas cuyo vector no tiene dicho elemento se ignoran).
+ * El recorrido del fichero se reparte entre varios hilos y los vectores se procesan con instrucciones SIMD.
+ * Esta función se llama desde el servidor tras recibir una petición de un cliente.
+ * 
+ * @param element elemento de V_value2 a considerar [0-31], o -1 para todos.
+ * @param agg agregado donde se devuelve el resultado.
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ * @retval 0 en caso de éxito.
+ * @retval -1 en caso de error.
+ */
+int aggregate_values(int element, Agregado *agg);
+
+/**
+ * @brief Este servicio obtiene las claves de las tuplas en las que algún elemento de V_value2 (o el elemento
+ * element, si no es -1) cumple el predicado cmp respecto a threshold (FILTER_GREATER: mayor que,
+ * FILTER_LESS: menor que). El vector de claves se reserva con malloc y lo debe liberar quien llama a la función.
+ * El recorrido del fichero se reparte entre varios hilos y los vectores se procesan con instrucciones SIMD.
+ * Esta función se llama desde el servidor tras recibir una petición de un cliente.
+ * 
+ * @param element elemento de V_value2 a considerar [0-31], o -1 para todos.
+ * @param cmp predicado (FILTER_GREATER o FILTER_LESS).
+ * @param threshold umbral.
+ * @param keys puntero donde se devuelve el vector de claves.
+ * @return int La función devuelve el número de claves encontradas. En caso de error se devuelve -1.
+ * @retval >= 0 número de claves encontradas.
+ * @retval -1 en caso de error.
+ */
+int filter_keys(int element, int cmp, double threshold, int **keys);
+
+/**
+ * @brief Este servicio busca las k tuplas cuyo vector V_value2 (de dimensión N_value2) está más cerca del
+ * vector de consulta V_value2 según la métrica metric (KNN_L2: distancia euclídea, KNN_COSINE: 1 - similitud
+ * coseno). Las claves se copian en keys y las distancias en distances, ordenadas de menor a mayor distancia.
+ * La búsqueda se hace sobre un índice de vectores en memoria que se mantiene actualizado con set_value(),
+ * modify_value() y delete_key().
+ * Esta función se llama desde el servidor tras recibir una petición de un cliente.
+ * 
+ * @param k número de vecinos a buscar [1-KNN_MAX_K].
+ * @param metric métrica (KNN_L2 o KNN_COSINE).
+ * @param N_value2 dimensión del vector de consulta [1-32].
+ * @param V_value2 vector de consulta [32].
+ * @param keys vector donde se copian las claves [k].
+ * @param distances vector donde se copian las distancias [k].
+ * @return int La función devuelve el número de vecinos encontrados. En caso de error se devuelve -1.
+ * @retval >= 0 número de vecinos encontrados.
+ * @retval -1 en caso de error.
+ */
+int knn_search(int k, int metric, int N_value2, double *V_value2, int *keys, double *distances);
+
+/**
+ * @brief Cambia el fichero donde se guardan las tuplas (por defecto FILE_NAME).
+ * 
+ * @param name ruta del fichero.
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ * @retval 0 en caso de éxito.
+ * @retval -1 en caso de error.
+ */
+int set_file_name(const char *name);
+
+/**
+ * @brief Activa o desactiva el índice secundario sobre value1. Si está activado, se actualiza en cada
+ * operación que modifica las tuplas y get_by_value1() y prefix_value1() lo consultan en lugar de recorrer
+ * el fichero. Por defecto está desactivado.
+ * 
+ * @param enabled 1 para activar el índice, 0 para desactivarlo.
+ */
+void enable_value1_index(int enabled);
+
+/**
+ * @brief Fija la memoria máxima que pueden ocupar las tuplas que get_value() sirve desde memoria. Si se
+ * supera, las usadas menos recientemente se desalojan (siguen en FILE_NAME) y se vuelven a leer del fichero
+ * cuando se accede a ellas. Por defecto no hay límite.
+ * 
+ * @param bytes memoria máxima en bytes, 0 para no limitarla.
+ */
+void set_max_memory(long bytes);
+
+/**
+ * @brief Copia en tiers el número de tuplas en memoria y solo en el fichero, la memoria que ocupan y los
+ * contadores de desalojos y de fallos (tuplas leídas de nuevo del fichero).
+ * 
+ * @param tiers estructura donde se copian los datos.
+ */
+void get_tiers(NivelesTuplas *tiers);
+
+/**
+ * @brief Indica si get_value() puede devolver la tupla de la clave key sin leerla del fichero (porque está
+ * en memoria o porque la clave no existe). Si no, get_value() la vuelve a cargar en memoria, por lo que no
+ * puede llamarse a la vez que otras funciones.
+ * 
+ * @param key clave.
+ * @return int 1 si la tupla está en memoria o la clave no existe, 0 si no.
+ */
+int tuple_resident(int key);
+
+/**
+ * @brief Indica si los índices en memoria están al día con FILE_NAME, es decir, si get_value(), exist(),
+ * scan_keys(), knn_search(), get_by_value1() y prefix_value1() pueden consultarlos sin reconstruirlos. Solo en
+ * ese caso pueden llamarse varias de estas funciones a la vez desde distintos hilos.
+ * 
+ * @return int 1 si los índices están al día, 0 si no.
+ */
+int indexes_synced();
+
+/**
+ * @brief Indica si el hilo que llama comparte el almacenamiento con otros hilos que lo leen. Mientras lo
+ * comparte, get_value(), exist(), scan_keys(), knn_search(), get_by_value1() y prefix_value1() consultan los
+ * índices en memoria tal como están, sin reconstruirlos aunque FILE_NAME haya cambiado, porque otro hilo
+ * puede estar leyéndolos.
+ * 
+ * @param shared 1 si el almacenamiento está compartido, 0 si el hilo lo tiene en exclusiva.
+ */
+void set_shared_lookups(int shared);
+
+/**
+ * @brief Este servicio obtiene las claves de las tuplas cuyo value1 es igual a value1. El vector de claves
+ * se reserva con malloc y lo debe liberar quien llama a la función. Si el índice sobre value1 está activado
+ * las claves se devuelven ordenadas.
+ * Esta función se llama desde el servidor tras recibir una petición de un cliente.
+ * 
+ * @param value1 valor1 a buscar [256].
+ * @param keys puntero donde se devuelve el vector de claves.
+ * @return int La función devuelve el número de claves encontradas. En caso de error se devuelve -1.
+ * @retval >= 0 número de claves encontradas.
+ * @retval -1 en caso de error.
+ */
+int get_by_value1(char *value1, int **keys);
+
+/**
+ * @brief Este servicio obtiene las claves de las tuplas cuyo value1 empieza por prefix, como mucho limit
+ * claves. El vector de claves se reserva con malloc y lo debe liberar quien llama a la función. Si el índice
+ * sobre value1 está activado las claves se devuelven ordenadas por value1.
+ * Esta función se llama desde el servidor tras recibir una petición de un cliente.
+ * 
+ * @param prefix prefijo a buscar [256].
+ * @param limit número máximo de claves a obtener [>= 1].
+ * @param keys puntero donde se devuelve el vector de claves.
+ * @return int La función devuelve el número de claves encontradas. En caso de error se devuelve -1.
+ * @retval >= 0 número de claves encontradas.
+ * @retval -1 en caso de error.
+ */
+int prefix_value1(char *prefix, int limit, int **keys);
+
 #endif
\ No newline at end of file
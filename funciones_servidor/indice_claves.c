@@ -0,0 +1,179 @@
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "indice_claves.h"
+
+#define MAX_LEVEL 24    // Enough for 4^24 keys with p = 1/4
+
+static int random_level(IndiceClaves *index)
+{
+    // Each level is kept with probability 1/4 (xorshift32, two bits per level)
+    int lvl = 1;
+    index->seed ^= index->seed << 13;
+    index->seed ^= index->seed >> 17;
+    index->seed ^= index->seed << 5;
+    uint32_t bits = index->seed;
+    while (lvl < MAX_LEVEL && (bits & 3) == 0)
+    {
+        lvl++;
+        bits >>= 2;
+    }
+    return lvl;
+}
+
+static NodoClave *create_node(int key, int lvl)
+{
+    NodoClave *node = malloc(sizeof(NodoClave) + lvl * sizeof(NodoClave *));
+    if (node == NULL)
+    {
+        return NULL;
+    }
+    node->key = key;
+    node->level = lvl;
+    node->value = NULL;
+    for (int i = 0; i < lvl; i++)
+    {
+        node->forward[i] = NULL;
+    }
+    return node;
+}
+
+static int init_head(IndiceClaves *index)
+{
+    if (index->head == NULL)
+    {
+        index->head = create_node(0, MAX_LEVEL);
+        if (index->head == NULL)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Fill update[i] with the last node of the level i whose key is lower than key
+static void find_predecessors(const IndiceClaves *index, int key, NodoClave **update)
+{
+    NodoClave *node = index->head;
+    for (int i = index->level - 1; i >= 0; i--)
+    {
+        while (node->forward[i] != NULL && node->forward[i]->key < key)
+        {
+            node = node->forward[i];
+        }
+        update[i] = node;
+    }
+}
+
+NodoClave *indice_claves_insert(IndiceClaves *index, int key)
+{
+    if (init_head(index) < 0)
+    {
+        return NULL;
+    }
+
+    NodoClave *update[MAX_LEVEL];
+    find_predecessors(index, key, update);
+
+    // If the key is already in the index, there is nothing to do
+    if (update[0]->forward[0] != NULL && update[0]->forward[0]->key == key)
+    {
+        return update[0]->forward[0];
+    }
+
+    int lvl = random_level(index);
+    NodoClave *node = create_node(key, lvl);
+    if (node == NULL)
+    {
+        return NULL;
+    }
+    if (lvl > index->level)
+    {
+        for (int i = index->level; i < lvl; i++)
+        {
+            update[i] = index->head;
+        }
+        index->level = lvl;
+    }
+    for (int i = 0; i < lvl; i++)
+    {
+        node->forward[i] = update[i]->forward[i];
+        update[i]->forward[i] = node;
+    }
+    return node;
+}
+
+int indice_claves_remove(IndiceClaves *index, int key)
+{
+    if (index->head == NULL)
+    {
+        return -1;
+    }
+
+    NodoClave *update[MAX_LEVEL];
+    find_predecessors(index, key, update);
+
+    NodoClave *node = update[0]->forward[0];
+    if (node == NULL || node->key != key)
+    {
+        return -1;
+    }
+
+    for (int i = 0; i < node->level; i++)
+    {
+        update[i]->forward[i] = node->forward[i];
+    }
+    free(node);
+
+    // Remove the empty levels
+    while (index->level > 1 && index->head->forward[index->level - 1] == NULL)
+    {
+        index->level--;
+    }
+    return 0;
+}
+
+void indice_claves_clear(IndiceClaves *index)
+{
+    if (index->head == NULL)
+    {
+        return;
+    }
+
+    NodoClave *node = index->head->forward[0];
+    while (node != NULL)
+    {
+        NodoClave *next = node->forward[0];
+        free(node);
+        node = next;
+    }
+    for (int i = 0; i < MAX_LEVEL; i++)
+    {
+        index->head->forward[i] = NULL;
+    }
+    index->level = 1;
+}
+
+NodoClave *indice_claves_find(const IndiceClaves *index, int key)
+{
+    if (index->head == NULL)
+    {
+        return NULL;
+    }
+    NodoClave *update[MAX_LEVEL];
+    find_predecessors(index, key, update);
+    return update[0]->forward[0];
+}
+
+int indice_claves_scan(const IndiceClaves *index, int start_key, int end_key, int limit, int *keys)
+{
+    // Walk the bottom level from the first key >= start_key until end_key or limit is reached
+    NodoClave *node = indice_claves_find(index, start_key);
+    int n = 0;
+    while (node != NULL && node->key <= end_key && n < limit)
+    {
+        keys[n++] = node->key;
+        node = node->forward[0];
+    }
+    return n;
+}
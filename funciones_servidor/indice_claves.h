@@ -0,0 +1,78 @@
+#ifndef INDICE_CLAVES_H
+#define INDICE_CLAVES_H
+
+/*
+Ordered index over a set of keys (skiplist), with a value pointer per key that the owner of the index can use.
+Each engine keeps the keys it stores in one, so that they can be enumerated in order (SCAN), and the snapshots
+keep the keys that have old versions in another, with the newest version kept of each key as its value.
+The functions are not thread-safe: the caller must serialize the access to each index.
+*/
+
+#include <stdint.h>
+
+#define INDICE_CLAVES_INIT {NULL, 1, 2463534242u}   // Empty index (nothing allocated until the first insertion)
+
+typedef struct NodoClave {
+    int key;
+    int level;                      /* Number of forward pointers of the node */
+    void *value;                    /* Value of the key (NULL when it is inserted) */
+    struct NodoClave *forward[];    /* forward[i] is the next node in the level i */
+} NodoClave;
+
+typedef struct {
+    NodoClave *head;                /* Sentinel node (it does not store any key) */
+    int level;                      /* Current number of levels of the skiplist */
+    uint32_t seed;                  /* State of the generator of the levels */
+} IndiceClaves;
+
+/**
+ * @brief Inserta la clave key en el índice, con valor NULL. Si la clave ya estaba en el índice no se cambia.
+ * 
+ * @param index índice.
+ * @param key clave.
+ * @return NodoClave* La función devuelve el nodo de la clave, o NULL en caso de error.
+ */
+NodoClave *indice_claves_insert(IndiceClaves *index, int key);
+
+/**
+ * @brief Elimina la clave key del índice (sin liberar su valor).
+ * 
+ * @param index índice.
+ * @param key clave.
+ * @return int La función devuelve 0 si se eliminó la clave y -1 si no estaba en el índice.
+ * @retval 0 si se eliminó la clave.
+ * @retval -1 si la clave no estaba en el índice.
+ */
+int indice_claves_remove(IndiceClaves *index, int key);
+
+/**
+ * @brief Elimina todas las claves del índice (sin liberar sus valores).
+ * 
+ * @param index índice.
+ */
+void indice_claves_clear(IndiceClaves *index);
+
+/**
+ * @brief Busca el primer nodo del índice cuya clave es mayor o igual que key. Los siguientes se recorren en
+ * orden ascendente con node->forward[0].
+ * 
+ * @param index índice.
+ * @param key clave.
+ * @return NodoClave* La función devuelve el nodo, o NULL si no hay ninguna clave mayor o igual que key.
+ */
+NodoClave *indice_claves_find(const IndiceClaves *index, int key);
+
+/**
+ * @brief Copia en keys, en orden ascendente, las claves del índice que están en el rango
+ * [start_key, end_key], hasta un máximo de limit claves.
+ * 
+ * @param index índice.
+ * @param start_key primera clave del rango (incluida).
+ * @param end_key última clave del rango (incluida).
+ * @param limit número máximo de claves a copiar.
+ * @param keys vector donde se copian las claves [limit].
+ * @return int La función devuelve el número de claves copiadas.
+ */
+int indice_claves_scan(const IndiceClaves *index, int start_key, int end_key, int limit, int *keys);
+
+#endif
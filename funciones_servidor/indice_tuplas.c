@@ -0,0 +1,554 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "indice_tuplas.h"
+#include "tabla_enteros.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86 1
+#endif
+
+#define GROUP 8                 // Slots compared at a time
+#define MIN_SIZE 1024           // Initial number of slots (power of 2, multiple of GROUP)
+#define MIGRATE_SLOTS 32        // Slots of the old table moved to the new one on each insertion or deletion
+#define BLOCK_RECORDS 1024      // Records allocated at a time
+
+// Content of the slots of records[]: the position of the tuple + 1 if it is in memory, or one of these
+// (0 is the empty slot, so that a new table allocated with calloc is already empty)
+#define EMPTY_SLOT 0
+#define DELETED_SLOT -1         // Tombstone, only in the old table while it is being emptied
+#define COLD_SLOT -2            // The tuple is only in the file (at the offset of the slot)
+
+typedef struct {
+    char value1[256];
+    int N_value2;           /* Number of elements of V_value2 */
+    double V_value2[32];
+    int key;                /* Key of the tuple (to find its slot when it is evicted) */
+    int next_free;          /* Next free record while the record is free */
+    char in_use;            /* 0 if the record is in the list of free ones */
+    char referenced;        /* Set on each access, cleared by the clock hand */
+} Tupla;
+
+typedef struct {
+    int *keys;              /* Key of each slot */
+    int *records;           /* Position + 1 of the tuple of each slot, EMPTY_SLOT, DELETED_SLOT or COLD_SLOT */
+    long *offsets;          /* Offset of the line of the tuple in the file */
+    unsigned int size;      /* Number of slots (power of 2, 0 if the table has not been allocated) */
+    unsigned int count;     /* Number of tuples in the table */
+} Tabla;
+
+static Tabla table;             // Table where the new keys are inserted
+static Tabla old_table;         // Table that is being moved to table while growing (size 0 otherwise)
+static unsigned int migrated;   // Slots of old_table already moved
+
+// Records, in blocks of BLOCK_RECORDS (the blocks are never moved, so growing does not copy them)
+static Tupla **blocks = NULL;
+static int N_blocks = 0;
+static int max_blocks = 0;      // Capacity of blocks
+static int N_records = 0;       // Records used at some point (the free ones are in a list)
+static int free_record = -1;    // First free record, -1 if there is none
+
+// Memory budget: at most max_hot tuples are kept in memory, the rest are evicted with the clock algorithm
+// (an approximation of LRU whose accesses only set a flag, so that the lookups can run at the same time)
+static long max_hot = 0;        // 0 if there is no limit
+static long N_hot = 0;
+static long N_cold = 0;
+static int clock_hand = 0;      // Next record considered for eviction
+static long evictions = 0;
+static long faults = 0;
+
+
+static Tupla *get_record(int record)
+{
+    return &blocks[record / BLOCK_RECORDS][record % BLOCK_RECORDS];
+}
+
+
+// Group kernels: for the GROUP slots starting at keys/records, bit i of the result is set if slot i holds
+// key (in memory or not), and bit i of *empty if slot i is empty
+
+static unsigned int group_scalar(const int *keys, const int *records, int key, unsigned int *empty)
+{
+    unsigned int match = 0;
+    *empty = 0;
+    for (int i = 0; i < GROUP; i++)
+    {
+        if (records[i] == EMPTY_SLOT)
+        {
+            *empty |= 1u << i;
+        }
+        else if (records[i] != DELETED_SLOT && keys[i] == key)
+        {
+            match |= 1u << i;
+        }
+    }
+    return match;
+}
+
+#ifdef HAVE_X86
+
+static unsigned int group_sse2(const int *keys, const int *records, int key, unsigned int *empty)
+{
+    const __m128i wanted = _mm_set1_epi32(key);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i deleted = _mm_set1_epi32(DELETED_SLOT);
+    unsigned int match = 0;
+    *empty = 0;
+    for (int i = 0; i < GROUP; i += 4)
+    {
+        __m128i k = _mm_loadu_si128((const __m128i *)(keys + i));
+        __m128i r = _mm_loadu_si128((const __m128i *)(records + i));
+        __m128i is_empty = _mm_cmpeq_epi32(r, zero);
+        __m128i dead = _mm_or_si128(is_empty, _mm_cmpeq_epi32(r, deleted));
+        match |= _mm_movemask_ps(_mm_castsi128_ps(_mm_andnot_si128(dead, _mm_cmpeq_epi32(k, wanted)))) << i;
+        *empty |= _mm_movemask_ps(_mm_castsi128_ps(is_empty)) << i;
+    }
+    return match;
+}
+
+__attribute__((target("avx2")))
+static unsigned int group_avx2(const int *keys, const int *records, int key, unsigned int *empty)
+{
+    __m256i k = _mm256_loadu_si256((const __m256i *)keys);
+    __m256i r = _mm256_loadu_si256((const __m256i *)records);
+    __m256i is_empty = _mm256_cmpeq_epi32(r, _mm256_setzero_si256());
+    __m256i dead = _mm256_or_si256(is_empty, _mm256_cmpeq_epi32(r, _mm256_set1_epi32(DELETED_SLOT)));
+    *empty = _mm256_movemask_ps(_mm256_castsi256_ps(is_empty));
+    return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_andnot_si256(dead, _mm256_cmpeq_epi32(k, _mm256_set1_epi32(key)))));
+}
+
+#endif
+
+// Kernel selected at run time depending on the CPU
+static unsigned int (*group_impl)(const int *, const int *, int, unsigned int *) = group_scalar;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+static void select_kernels()
+{
+#ifdef HAVE_X86
+    if (__builtin_cpu_supports("avx2"))
+    {
+        group_impl = group_avx2;
+    }
+    else
+    {
+        group_impl = group_sse2;
+    }
+#endif
+}
+
+
+static int table_find(const Tabla *t, int key)
+{
+    // Return the slot of the key in t, or -1 if it is not in t
+    // The slots are probed in the same order as table_put() fills them (from the home slot onwards), a group
+    // of GROUP aligned slots at a time: the key is in the first match before the first empty slot
+    if (t->size == 0)
+    {
+        return -1;
+    }
+    unsigned int mask = t->size - 1;
+    unsigned int home = tabla_enteros_hash(key) & mask;
+    unsigned int base = home & ~(GROUP - 1u);
+    unsigned int valid = ~0u << (home - base);     // Slots of the first group before the home slot are skipped
+    for (unsigned int probed = 0; probed < t->size; probed += GROUP)
+    {
+        unsigned int empty;
+        unsigned int match = group_impl(t->keys + base, t->records + base, key, &empty) & valid;
+        empty &= valid;
+        if (empty != 0)
+        {
+            match &= (empty & -empty) - 1;
+        }
+        if (match != 0)
+        {
+            return base + __builtin_ctz(match);
+        }
+        if (empty != 0)
+        {
+            return -1;
+        }
+        base = (base + GROUP) & mask;
+        valid = ~0u;
+    }
+    return -1;
+}
+
+static int find(int key, Tabla **t)
+{
+    // Return the slot of the key and the table where it is, or -1 if it is in none of them
+    int slot = table_find(&table, key);
+    *t = &table;
+    if (slot < 0 && old_table.size > 0)
+    {
+        slot = table_find(&old_table, key);
+        *t = &old_table;
+    }
+    return slot;
+}
+
+static void table_put(Tabla *t, int key, int record, long offset)
+{
+    // Add a key that is not in t (t never has tombstones, only old_table does)
+    unsigned int mask = t->size - 1;
+    unsigned int i = tabla_enteros_hash(key) & mask;
+    while (t->records[i] != EMPTY_SLOT)
+    {
+        i = (i + 1) & mask;
+    }
+    t->keys[i] = key;
+    t->records[i] = record;
+    t->offsets[i] = offset;
+    t->count++;
+}
+
+static void table_delete(Tabla *t, unsigned int slot)
+{
+    // Backward-shift deletion, so that no tombstones are needed
+    unsigned int mask = t->size - 1;
+    unsigned int hole = slot;
+    unsigned int i = (hole + 1) & mask;
+    while (t->records[i] != EMPTY_SLOT)
+    {
+        unsigned int home = tabla_enteros_hash(t->keys[i]) & mask;
+        // Move the entry to the hole if the hole is between its home and its current slot
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            t->keys[hole] = t->keys[i];
+            t->records[hole] = t->records[i];
+            t->offsets[hole] = t->offsets[i];
+            hole = i;
+        }
+        i = (i + 1) & mask;
+    }
+    t->records[hole] = EMPTY_SLOT;
+    t->count--;
+}
+
+static int table_alloc(Tabla *t, unsigned int size)
+{
+    // calloc gets the big tables straight from the kernel already zeroed, so allocating them is not
+    // proportional to their size
+    t->keys = malloc(size * sizeof(int));
+    t->records = calloc(size, sizeof(int));
+    t->offsets = malloc(size * sizeof(long));
+    if (t->keys == NULL || t->records == NULL || t->offsets == NULL)
+    {
+        free(t->keys);
+        free(t->records);
+        free(t->offsets);
+        memset(t, 0, sizeof(Tabla));
+        return -1;
+    }
+    t->size = size;
+    t->count = 0;
+    return 0;
+}
+
+static void table_free(Tabla *t)
+{
+    free(t->keys);
+    free(t->records);
+    free(t->offsets);
+    memset(t, 0, sizeof(Tabla));
+}
+
+static void migrate()
+{
+    // Move the next MIGRATE_SLOTS slots of old_table to table (leaving tombstones, so that the lookups in
+    // old_table of the keys that have not been moved yet still work)
+    for (int n = 0; n < MIGRATE_SLOTS && migrated < old_table.size; n++, migrated++)
+    {
+        int record = old_table.records[migrated];
+        if (record != EMPTY_SLOT && record != DELETED_SLOT)
+        {
+            table_put(&table, old_table.keys[migrated], record, old_table.offsets[migrated]);
+            old_table.records[migrated] = DELETED_SLOT;
+            old_table.count--;
+        }
+    }
+    if (old_table.size > 0 && migrated == old_table.size)
+    {
+        table_free(&old_table);
+    }
+}
+
+static int grow()
+{
+    // Start moving the table to one twice as big when the load factor would go over 1/2
+    // (a table has size / 2 / MIGRATE_SLOTS times more insertions left than it needs to be emptied,
+    // so the previous move has always finished by then, unless it failed to allocate)
+    if (table.size == 0)
+    {
+        return table_alloc(&table, MIN_SIZE);
+    }
+    if (2 * (table.count + old_table.count + 1) <= table.size)
+    {
+        return 0;
+    }
+    while (old_table.size > 0)
+    {
+        migrate();
+    }
+
+    Tabla new_table;
+    if (table_alloc(&new_table, 2 * table.size) < 0)
+    {
+        return -1;
+    }
+    old_table = table;
+    table = new_table;
+    migrated = 0;
+    return 0;
+}
+
+static void release_record(int record)
+{
+    Tupla *tuple = get_record(record);
+    tuple->in_use = 0;
+    tuple->next_free = free_record;
+    free_record = record;
+    N_hot--;
+}
+
+static void evict()
+{
+    // Evict tuples until there is room for one more: the clock hand goes round the records giving a second
+    // chance to the ones accessed since it last passed (it stops after two rounds, when all have been cleared)
+    for (long steps = 0; max_hot > 0 && N_hot >= max_hot && steps < 2L * N_records; steps++)
+    {
+        int record = clock_hand;
+        clock_hand = (clock_hand + 1) % N_records;
+        Tupla *tuple = get_record(record);
+        if (!tuple->in_use)
+        {
+            continue;
+        }
+        if (__atomic_load_n(&tuple->referenced, __ATOMIC_RELAXED))
+        {
+            __atomic_store_n(&tuple->referenced, 0, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        Tabla *t;
+        int slot = find(tuple->key, &t);
+        if (slot >= 0)
+        {
+            t->records[slot] = COLD_SLOT;
+        }
+        release_record(record);
+        N_cold++;
+        evictions++;
+    }
+}
+
+static int new_record()
+{
+    // Position of a free record, -1 on error
+    evict();
+    int record = free_record;
+    if (record >= 0)
+    {
+        free_record = get_record(record)->next_free;
+    }
+    else
+    {
+        if (N_records == N_blocks * BLOCK_RECORDS)
+        {
+            if (N_blocks == max_blocks)
+            {
+                int new_max = max_blocks == 0 ? 64 : 2 * max_blocks;
+                Tupla **new_blocks = realloc(blocks, new_max * sizeof(Tupla *));
+                if (new_blocks == NULL)
+                {
+                    return -1;
+                }
+                blocks = new_blocks;
+                max_blocks = new_max;
+            }
+            if ((blocks[N_blocks] = malloc(BLOCK_RECORDS * sizeof(Tupla))) == NULL)
+            {
+                return -1;
+            }
+            N_blocks++;
+        }
+        record = N_records++;
+    }
+    get_record(record)->in_use = 1;
+    N_hot++;
+    return record;
+}
+
+
+int indice_tuplas_insert(int key, const char *value1, int N_value2, const double *V_value2, long offset)
+{
+    if (N_value2 < 1 || N_value2 > 32 || strlen(value1) >= sizeof(((Tupla *)0)->value1))
+    {
+        return -1;
+    }
+    pthread_once(&kernels_once, select_kernels);
+
+    Tabla *t;
+    int slot = find(key, &t);
+    int record;
+    if (slot >= 0 && t->records[slot] > 0)
+    {
+        record = t->records[slot] - 1;
+        t->offsets[slot] = offset;
+    }
+    else
+    {
+        if ((slot < 0 && grow() < 0) || (record = new_record()) < 0)
+        {
+            return -1;
+        }
+        // The slot may have moved while evicting or growing
+        if ((slot = find(key, &t)) >= 0)
+        {
+            // The tuple was only in the file: it is in memory again
+            t->records[slot] = record + 1;
+            t->offsets[slot] = offset;
+            N_cold--;
+            faults++;
+        }
+        else
+        {
+            table_put(&table, key, record + 1, offset);
+        }
+    }
+
+    Tupla *tuple = get_record(record);
+    strcpy(tuple->value1, value1);
+    tuple->N_value2 = N_value2;
+    memcpy(tuple->V_value2, V_value2, N_value2 * sizeof(double));
+    tuple->key = key;
+    tuple->referenced = 1;
+    migrate();
+    return 0;
+}
+
+int indice_tuplas_get(int key, char *value1, int *N_value2, double *V_value2, long *offset)
+{
+    pthread_once(&kernels_once, select_kernels);
+    Tabla *t;
+    int slot = find(key, &t);
+    if (slot < 0)
+    {
+        return -1;
+    }
+    if (t->records[slot] == COLD_SLOT)
+    {
+        *offset = t->offsets[slot];
+        return 1;
+    }
+    Tupla *tuple = get_record(t->records[slot] - 1);
+    strcpy(value1, tuple->value1);
+    *N_value2 = tuple->N_value2;
+    memcpy(V_value2, tuple->V_value2, tuple->N_value2 * sizeof(double));
+    if (!__atomic_load_n(&tuple->referenced, __ATOMIC_RELAXED))
+    {
+        __atomic_store_n(&tuple->referenced, 1, __ATOMIC_RELAXED);
+    }
+    return 0;
+}
+
+int indice_tuplas_exists(int key)
+{
+    pthread_once(&kernels_once, select_kernels);
+    Tabla *t;
+    return find(key, &t) >= 0;
+}
+
+int indice_tuplas_resident(int key)
+{
+    pthread_once(&kernels_once, select_kernels);
+    Tabla *t;
+    int slot = find(key, &t);
+    return slot < 0 || t->records[slot] != COLD_SLOT;
+}
+
+int indice_tuplas_set_offset(int key, long offset)
+{
+    pthread_once(&kernels_once, select_kernels);
+    Tabla *t;
+    int slot = find(key, &t);
+    if (slot < 0)
+    {
+        return -1;
+    }
+    t->offsets[slot] = offset;
+    return 0;
+}
+
+int indice_tuplas_remove(int key)
+{
+    pthread_once(&kernels_once, select_kernels);
+    Tabla *t;
+    int slot = find(key, &t);
+    if (slot < 0)
+    {
+        return -1;
+    }
+
+    if (t->records[slot] == COLD_SLOT)
+    {
+        N_cold--;
+    }
+    else
+    {
+        release_record(t->records[slot] - 1);
+    }
+
+    if (t == &old_table)
+    {
+        old_table.records[slot] = DELETED_SLOT;
+        old_table.count--;
+    }
+    else
+    {
+        table_delete(&table, slot);
+    }
+    migrate();
+    return 0;
+}
+
+void indice_tuplas_clear()
+{
+    table_free(&table);
+    table_free(&old_table);
+    migrated = 0;
+    for (int i = 0; i < N_blocks; i++)
+    {
+        free(blocks[i]);
+    }
+    free(blocks);
+    blocks = NULL;
+    N_blocks = 0;
+    max_blocks = 0;
+    N_records = 0;
+    free_record = -1;
+    N_hot = 0;
+    N_cold = 0;
+    clock_hand = 0;
+}
+
+void indice_tuplas_set_max_memory(long bytes)
+{
+    max_hot = bytes > 0 ? bytes / (long)sizeof(Tupla) : 0;
+    if (bytes > 0 && max_hot < 1)
+    {
+        max_hot = 1;
+    }
+}
+
+void indice_tuplas_stats(NivelesTuplas *tiers)
+{
+    tiers->hot = N_hot;
+    tiers->cold = N_cold;
+    tiers->hot_bytes = N_hot * (long)sizeof(Tupla);
+    tiers->max_bytes = max_hot * (long)sizeof(Tupla);
+    tiers->evictions = evictions;
+    tiers->faults = faults;
+}
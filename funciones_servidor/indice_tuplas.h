@@ -0,0 +1,121 @@
+#ifndef INDICE_TUPLAS_H
+#define INDICE_TUPLAS_H
+
+/*
+In-memory table of the tuples stored in the server, used by get_value(), exist() and set_value() instead of
+reading FILE_NAME.
+It is a hash table with open addressing (linear probing): the keys are stored in a contiguous array that is
+probed 8 slots at a time with SIMD compares (AVX2 or SSE2 when the CPU supports them, detected at run time),
+and a parallel array holds the position of each tuple in the records, which are allocated in fixed-size
+blocks. When the table has to grow, the entries are moved to the new table a few at a time on each
+insertion or deletion, so no single call pays for the whole resize.
+With a memory budget (indice_tuplas_set_max_memory) only some of the tuples are kept in memory: when there
+is no room for another one, the least recently used are evicted (clock algorithm) and only their key and the
+offset of their line in the file stay in the table, so that the caller can read them from the file and insert
+them again (a fault).
+The budget covers only the tuple records: the table itself and the other indexes (keys, vectors, value1) are
+not counted, so it bounds this cache and not the memory of the process.
+The lookups (indice_tuplas_get, indice_tuplas_exists, indice_tuplas_resident) do not modify the table and can
+run at the same time as each other; the rest of the functions are not thread-safe: the caller must serialize
+them.
+*/
+
+typedef struct {
+    long hot;               /* Tuples in memory */
+    long cold;              /* Tuples evicted (only in the file) */
+    long hot_bytes;         /* Memory used by the tuple records in memory (not the table nor the other indexes) */
+    long max_bytes;         /* Memory budget of the tuple records, 0 if there is no limit */
+    long evictions;         /* Tuples evicted since the start */
+    long faults;            /* Tuples read again from the file since the start */
+} NivelesTuplas;
+
+/**
+ * @brief Inserta (o reemplaza) la tupla <key, value1, value2> en la tabla, cuya línea está en la posición
+ * offset del fichero. Si no hay sitio para ella en memoria se desalojan otras.
+ * 
+ * @param key clave.
+ * @param value1 valor1 [256].
+ * @param N_value2 dimensión del vector V_value2 [1-32].
+ * @param V_value2 vector de doubles [32].
+ * @param offset posición de la línea de la tupla en el fichero.
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ * @retval 0 en caso de éxito.
+ * @retval -1 en caso de error.
+ */
+int indice_tuplas_insert(int key, const char *value1, int N_value2, const double *V_value2, long offset);
+
+/**
+ * @brief Copia los valores de la tupla de la clave key en value1, N_value2 y V_value2. Si la tupla ha sido
+ * desalojada, se devuelve en offset la posición de su línea en el fichero.
+ * 
+ * @param key clave.
+ * @param value1 cadena donde se copia value1 [256].
+ * @param N_value2 puntero donde se guarda la dimensión del vector.
+ * @param V_value2 vector donde se copian los doubles [32].
+ * @param offset puntero donde se guarda la posición de la línea si la tupla no está en memoria.
+ * @return int La función devuelve 0 si la tupla está en memoria, 1 si solo está en el fichero y -1 si la
+ * clave no está en la tabla.
+ * @retval 0 si la tupla está en memoria.
+ * @retval 1 si la tupla solo está en el fichero.
+ * @retval -1 si la clave no está en la tabla.
+ */
+int indice_tuplas_get(int key, char *value1, int *N_value2, double *V_value2, long *offset);
+
+/**
+ * @brief Indica si la clave key está en la tabla.
+ * 
+ * @param key clave.
+ * @return int La función devuelve 1 si la clave está en la tabla y 0 si no.
+ */
+int indice_tuplas_exists(int key);
+
+/**
+ * @brief Indica si la tupla de la clave key está en memoria (o si la clave no está en la tabla), es decir, si
+ * indice_tuplas_get() puede devolverla sin leer el fichero.
+ * 
+ * @param key clave.
+ * @return int La función devuelve 0 si la tupla ha sido desalojada y 1 si no.
+ */
+int indice_tuplas_resident(int key);
+
+/**
+ * @brief Cambia la posición de la línea de la tupla de la clave key en el fichero.
+ * 
+ * @param key clave.
+ * @param offset nueva posición de la línea.
+ * @return int La función devuelve 0 en caso de éxito y -1 si la clave no está en la tabla.
+ * @retval 0 en caso de éxito.
+ * @retval -1 si la clave no está en la tabla.
+ */
+int indice_tuplas_set_offset(int key, long offset);
+
+/**
+ * @brief Elimina la tupla de la clave key de la tabla.
+ * 
+ * @param key clave.
+ * @return int La función devuelve 0 si se eliminó la tupla y -1 si la clave no estaba en la tabla.
+ * @retval 0 si se eliminó la tupla.
+ * @retval -1 si la clave no estaba en la tabla.
+ */
+int indice_tuplas_remove(int key);
+
+/**
+ * @brief Elimina todas las tuplas de la tabla.
+ */
+void indice_tuplas_clear();
+
+/**
+ * @brief Fija la memoria máxima que pueden ocupar las tuplas en memoria.
+ * 
+ * @param bytes memoria máxima en bytes, 0 para no limitarla.
+ */
+void indice_tuplas_set_max_memory(long bytes);
+
+/**
+ * @brief Copia en tiers el número de tuplas en memoria y desalojadas y los contadores de desalojos y fallos.
+ * 
+ * @param tiers estructura donde se copian los datos.
+ */
+void indice_tuplas_stats(NivelesTuplas *tiers);
+
+#endif
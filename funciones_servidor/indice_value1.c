@@ -0,0 +1,243 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "indice_value1.h"
+
+#define MAX_LEVEL 24    // Enough for 4^24 entries with p = 1/4
+
+typedef struct Node {
+    char *value1;
+    int key;
+    int level;                  /* Number of forward pointers of the node */
+    struct Node *forward[];     /* forward[i] is the next node in the level i */
+} Node;
+
+static Node *head = NULL;       // Sentinel node (it does not store any entry)
+static int level = 1;           // Current number of levels of the skiplist
+static uint32_t seed = 88675123u;
+
+static int random_level()
+{
+    // Each level is kept with probability 1/4 (xorshift32, two bits per level)
+    int lvl = 1;
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    uint32_t bits = seed;
+    while (lvl < MAX_LEVEL && (bits & 3) == 0)
+    {
+        lvl++;
+        bits >>= 2;
+    }
+    return lvl;
+}
+
+static int compare(const char *value1_a, int key_a, const char *value1_b, int key_b)
+{
+    // Order by value1 and then by key
+    int cmp = strcmp(value1_a, value1_b);
+    if (cmp != 0)
+    {
+        return cmp;
+    }
+    return (key_a > key_b) - (key_a < key_b);
+}
+
+static Node *create_node(const char *value1, int key, int lvl)
+{
+    Node *node = malloc(sizeof(Node) + lvl * sizeof(Node *));
+    if (node == NULL)
+    {
+        return NULL;
+    }
+    node->value1 = strdup(value1);
+    if (node->value1 == NULL)
+    {
+        free(node);
+        return NULL;
+    }
+    node->key = key;
+    node->level = lvl;
+    for (int i = 0; i < lvl; i++)
+    {
+        node->forward[i] = NULL;
+    }
+    return node;
+}
+
+static void free_node(Node *node)
+{
+    free(node->value1);
+    free(node);
+}
+
+static int init_head()
+{
+    if (head == NULL)
+    {
+        head = create_node("", 0, MAX_LEVEL);
+        if (head == NULL)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Fill update[i] with the last node of the level i that goes before (value1, key)
+static void find_predecessors(const char *value1, int key, Node **update)
+{
+    Node *node = head;
+    for (int i = level - 1; i >= 0; i--)
+    {
+        while (node->forward[i] != NULL && compare(node->forward[i]->value1, node->forward[i]->key, value1, key) < 0)
+        {
+            node = node->forward[i];
+        }
+        update[i] = node;
+    }
+}
+
+int indice_value1_insert(const char *value1, int key)
+{
+    if (init_head() < 0)
+    {
+        return -1;
+    }
+
+    Node *update[MAX_LEVEL];
+    find_predecessors(value1, key, update);
+
+    // If the entry is already in the index, there is nothing to do
+    Node *next = update[0]->forward[0];
+    if (next != NULL && compare(next->value1, next->key, value1, key) == 0)
+    {
+        return 0;
+    }
+
+    int lvl = random_level();
+    if (lvl > level)
+    {
+        for (int i = level; i < lvl; i++)
+        {
+            update[i] = head;
+        }
+        level = lvl;
+    }
+
+    Node *node = create_node(value1, key, lvl);
+    if (node == NULL)
+    {
+        return -1;
+    }
+    for (int i = 0; i < lvl; i++)
+    {
+        node->forward[i] = update[i]->forward[i];
+        update[i]->forward[i] = node;
+    }
+    return 0;
+}
+
+int indice_value1_remove(const char *value1, int key)
+{
+    if (head == NULL)
+    {
+        return -1;
+    }
+
+    Node *update[MAX_LEVEL];
+    find_predecessors(value1, key, update);
+
+    Node *node = update[0]->forward[0];
+    if (node == NULL || compare(node->value1, node->key, value1, key) != 0)
+    {
+        return -1;
+    }
+
+    for (int i = 0; i < node->level; i++)
+    {
+        update[i]->forward[i] = node->forward[i];
+    }
+    free_node(node);
+
+    // Remove the empty levels
+    while (level > 1 && head->forward[level - 1] == NULL)
+    {
+        level--;
+    }
+    return 0;
+}
+
+void indice_value1_clear()
+{
+    if (head == NULL)
+    {
+        return;
+    }
+
+    Node *node = head->forward[0];
+    while (node != NULL)
+    {
+        Node *next = node->forward[0];
+        free_node(node);
+        node = next;
+    }
+    for (int i = 0; i < MAX_LEVEL; i++)
+    {
+        head->forward[i] = NULL;
+    }
+    level = 1;
+}
+
+static Node *first_match(const char *value1)
+{
+    // First node whose value1 is >= value1 (all the matches are contiguous from there)
+    Node *node = head;
+    for (int i = level - 1; i >= 0; i--)
+    {
+        while (node->forward[i] != NULL && strcmp(node->forward[i]->value1, value1) < 0)
+        {
+            node = node->forward[i];
+        }
+    }
+    return node->forward[0];
+}
+
+static int matches(Node *node, const char *value1, size_t len, int exact)
+{
+    return exact ? strcmp(node->value1, value1) == 0 : strncmp(node->value1, value1, len) == 0;
+}
+
+int indice_value1_find(const char *value1, int exact, int limit, int *keys)
+{
+    if (head == NULL)
+    {
+        return 0;
+    }
+
+    size_t len = strlen(value1);
+    int n = 0;
+    for (Node *node = first_match(value1); node != NULL && n < limit && matches(node, value1, len, exact); node = node->forward[0])
+    {
+        keys[n++] = node->key;
+    }
+    return n;
+}
+
+int indice_value1_count(const char *value1, int exact, int limit)
+{
+    if (head == NULL)
+    {
+        return 0;
+    }
+
+    size_t len = strlen(value1);
+    int n = 0;
+    for (Node *node = first_match(value1); n < limit && node != NULL && matches(node, value1, len, exact);
+         node = node->forward[0])
+    {
+        n++;
+    }
+    return n;
+}
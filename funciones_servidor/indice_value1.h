@@ -0,0 +1,61 @@
+#ifndef INDICE_VALUE1_H
+#define INDICE_VALUE1_H
+
+/*
+Secondary index over value1 (skiplist ordered by value1 and then by key).
+It is used to find the keys whose value1 is equal to a string or starts with a prefix
+without reading the whole file.
+The functions are not thread-safe: the caller must serialize the access to the index.
+*/
+
+/**
+ * @brief Inserta el par (value1, key) en el índice.
+ * 
+ * @param value1 valor1 [256].
+ * @param key clave.
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ * @retval 0 en caso de éxito.
+ * @retval -1 en caso de error.
+ */
+int indice_value1_insert(const char *value1, int key);
+
+/**
+ * @brief Elimina el par (value1, key) del índice.
+ * 
+ * @param value1 valor1 [256].
+ * @param key clave.
+ * @return int La función devuelve 0 si se eliminó el par y -1 si no estaba en el índice.
+ * @retval 0 si se eliminó el par.
+ * @retval -1 si el par no estaba en el índice.
+ */
+int indice_value1_remove(const char *value1, int key);
+
+/**
+ * @brief Elimina todos los pares del índice.
+ */
+void indice_value1_clear();
+
+/**
+ * @brief Copia en keys, ordenadas por value1 y clave, las claves cuyo value1 es igual a value1
+ * (exact = 1) o empieza por value1 (exact = 0), hasta un máximo de limit claves.
+ * 
+ * @param value1 valor1 o prefijo a buscar.
+ * @param exact 1 para buscar el valor exacto, 0 para buscar por prefijo.
+ * @param limit número máximo de claves a copiar.
+ * @param keys vector donde se copian las claves [limit].
+ * @return int La función devuelve el número de claves copiadas.
+ */
+int indice_value1_find(const char *value1, int exact, int limit, int *keys);
+
+/**
+ * @brief Cuenta las claves cuyo value1 es igual a value1 (exact = 1) o empieza por value1 (exact = 0), hasta
+ * un máximo de limit (deja de recorrer el índice al llegar a limit).
+ * 
+ * @param value1 valor1 o prefijo a buscar.
+ * @param exact 1 para buscar el valor exacto, 0 para buscar por prefijo.
+ * @param limit número máximo de claves a contar.
+ * @return int La función devuelve el número de claves encontradas (como mucho limit).
+ */
+int indice_value1_count(const char *value1, int exact, int limit);
+
+#endif
@@ -0,0 +1,329 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "indice_vectores.h"
+#include "tabla_enteros.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86 1
+#endif
+
+typedef struct {
+    double V_value2[32];    /* Vector (the unused elements are 0) */
+} Vector;
+
+// Vectors, stored contiguously so that the search is a linear scan
+static Vector *vectors = NULL;
+static int *vector_keys = NULL;         // Key of each vector
+static int *vector_dims = NULL;         // Dimension of each vector
+static double *vector_norms = NULL;     // Euclidean norm of each vector (for the cosine distance)
+static int N_vectors = 0;
+static int capacity = 0;
+
+static TablaEnteros positions = TABLA_ENTEROS_INIT;   // Position of each key in vectors
+
+
+static int grow()
+{
+    // Double the capacity of the vectors
+    int new_capacity = capacity == 0 ? 1024 : 2 * capacity;
+
+    Vector *new_vectors = realloc(vectors, new_capacity * sizeof(Vector));
+    if (new_vectors == NULL) { return -1; }
+    vectors = new_vectors;
+    int *new_keys = realloc(vector_keys, new_capacity * sizeof(int));
+    if (new_keys == NULL) { return -1; }
+    vector_keys = new_keys;
+    int *new_dims = realloc(vector_dims, new_capacity * sizeof(int));
+    if (new_dims == NULL) { return -1; }
+    vector_dims = new_dims;
+    double *new_norms = realloc(vector_norms, new_capacity * sizeof(double));
+    if (new_norms == NULL) { return -1; }
+    vector_norms = new_norms;
+
+    capacity = new_capacity;
+    return 0;
+}
+
+
+// Distance kernels: dot product and squared Euclidean distance of two vectors of n elements
+
+static double dot_scalar(const double *a, const double *b, int n)
+{
+    double sum = 0.0;
+    for (int i = 0; i < n; i++)
+    {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+static double l2_scalar(const double *a, const double *b, int n)
+{
+    double sum = 0.0;
+    for (int i = 0; i < n; i++)
+    {
+        double d = a[i] - b[i];
+        sum += d * d;
+    }
+    return sum;
+}
+
+#ifdef HAVE_X86
+
+// The vectors are padded with zeros up to 32 elements, so the kernels can always process
+// complete groups (n rounded up to a multiple of the width) without a scalar tail
+
+static double dot_sse2(const double *a, const double *b, int n)
+{
+    __m128d sum = _mm_setzero_pd();
+    for (int i = 0; i < n; i += 2)
+    {
+        sum = _mm_add_pd(sum, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, sum);
+    return lanes[0] + lanes[1];
+}
+
+static double l2_sse2(const double *a, const double *b, int n)
+{
+    __m128d sum = _mm_setzero_pd();
+    for (int i = 0; i < n; i += 2)
+    {
+        __m128d d = _mm_sub_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i));
+        sum = _mm_add_pd(sum, _mm_mul_pd(d, d));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, sum);
+    return lanes[0] + lanes[1];
+}
+
+__attribute__((target("avx2,fma")))
+static double dot_avx2(const double *a, const double *b, int n)
+{
+    __m256d sum = _mm256_setzero_pd();
+    for (int i = 0; i < n; i += 4)
+    {
+        sum = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i), sum);
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, sum);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+__attribute__((target("avx2,fma")))
+static double l2_avx2(const double *a, const double *b, int n)
+{
+    __m256d sum = _mm256_setzero_pd();
+    for (int i = 0; i < n; i += 4)
+    {
+        __m256d d = _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i));
+        sum = _mm256_fmadd_pd(d, d, sum);
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, sum);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+#endif
+
+static double (*dot_impl)(const double *, const double *, int) = dot_scalar;
+static double (*l2_impl)(const double *, const double *, int) = l2_scalar;
+static int kernel_width = 1;    // Number of elements processed at a time by the kernels
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+static void select_kernels()
+{
+#ifdef HAVE_X86
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        dot_impl = dot_avx2;
+        l2_impl = l2_avx2;
+        kernel_width = 4;
+    }
+    else
+    {
+        dot_impl = dot_sse2;
+        l2_impl = l2_sse2;
+        kernel_width = 2;
+    }
+#endif
+}
+
+
+double indice_vectores_dot(const double *a, const double *b, int n)
+{
+    // The vectors of the callers are not padded: the kernel takes the complete groups and the tail is scalar
+    pthread_once(&kernels_once, select_kernels);
+    int m = n / kernel_width * kernel_width;
+    return (m > 0 ? dot_impl(a, b, m) : 0.0) + dot_scalar(a + m, b + m, n - m);
+}
+
+double indice_vectores_l2(const double *a, const double *b, int n)
+{
+    pthread_once(&kernels_once, select_kernels);
+    int m = n / kernel_width * kernel_width;
+    return (m > 0 ? l2_impl(a, b, m) : 0.0) + l2_scalar(a + m, b + m, n - m);
+}
+
+int indice_vectores_insert(int key, int N_value2, const double *V_value2)
+{
+    if (N_value2 < 1 || N_value2 > 32)
+    {
+        return -1;
+    }
+
+    int pos = tabla_enteros_get(&positions, key);
+    if (pos < 0)
+    {
+        if ((N_vectors == capacity && grow() < 0) || tabla_enteros_put(&positions, key, N_vectors) < 0)
+        {
+            return -1;
+        }
+        pos = N_vectors++;
+    }
+
+    memset(&vectors[pos], 0, sizeof(Vector));
+    memcpy(vectors[pos].V_value2, V_value2, N_value2 * sizeof(double));
+    vector_keys[pos] = key;
+    vector_dims[pos] = N_value2;
+    vector_norms[pos] = sqrt(dot_scalar(V_value2, V_value2, N_value2));
+    return 0;
+}
+
+int indice_vectores_remove(int key)
+{
+    int pos = tabla_enteros_remove(&positions, key);
+    if (pos < 0)
+    {
+        return -1;
+    }
+
+    // Move the last vector to the hole, so that the vectors stay contiguous
+    int last = --N_vectors;
+    if (pos != last)
+    {
+        vectors[pos] = vectors[last];
+        vector_keys[pos] = vector_keys[last];
+        vector_dims[pos] = vector_dims[last];
+        vector_norms[pos] = vector_norms[last];
+        tabla_enteros_put(&positions, vector_keys[pos], pos);     // The key is in the table: it cannot fail
+    }
+    return 0;
+}
+
+void indice_vectores_clear()
+{
+    N_vectors = 0;
+    tabla_enteros_clear(&positions);
+}
+
+static void heap_sift_down(int *keys, double *distances, int n, int i)
+{
+    // Max-heap on the distance: the root is the farthest of the k nearest neighbours found so far
+    while (1)
+    {
+        int largest = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < n && distances[left] > distances[largest]) { largest = left; }
+        if (right < n && distances[right] > distances[largest]) { largest = right; }
+        if (largest == i)
+        {
+            return;
+        }
+        double d = distances[i]; distances[i] = distances[largest]; distances[largest] = d;
+        int k = keys[i]; keys[i] = keys[largest]; keys[largest] = k;
+        i = largest;
+    }
+}
+
+static void heap_sift_up(int *keys, double *distances, int i)
+{
+    while (i > 0 && distances[(i - 1) / 2] < distances[i])
+    {
+        int parent = (i - 1) / 2;
+        double d = distances[i]; distances[i] = distances[parent]; distances[parent] = d;
+        int k = keys[i]; keys[i] = keys[parent]; keys[parent] = k;
+        i = parent;
+    }
+}
+
+int indice_vectores_knn(int k, int metric, int N_query, const double *query, int *keys, double *distances)
+{
+    if (k < 1 || k > KNN_MAX_K || N_query < 1 || N_query > 32 || (metric != KNN_L2 && metric != KNN_COSINE))
+    {
+        return 0;
+    }
+    pthread_once(&kernels_once, select_kernels);
+
+    // Pad the query with zeros like the stored vectors
+    Vector padded;
+    memset(&padded, 0, sizeof(Vector));
+    memcpy(padded.V_value2, query, N_query * sizeof(double));
+    int n = (N_query + kernel_width - 1) / kernel_width * kernel_width;
+    double query_norm = sqrt(dot_scalar(query, query, N_query));
+    if (metric == KNN_COSINE && query_norm == 0.0)
+    {
+        return 0;
+    }
+
+    int found = 0;
+    for (int i = 0; i < N_vectors; i++)
+    {
+        if (vector_dims[i] != N_query)
+        {
+            continue;
+        }
+
+        double distance;
+        if (metric == KNN_L2)
+        {
+            distance = l2_impl(vectors[i].V_value2, padded.V_value2, n);
+        }
+        else
+        {
+            if (vector_norms[i] == 0.0)
+            {
+                continue;
+            }
+            distance = 1.0 - dot_impl(vectors[i].V_value2, padded.V_value2, n) / (vector_norms[i] * query_norm);
+        }
+
+        if (found < k)
+        {
+            keys[found] = vector_keys[i];
+            distances[found] = distance;
+            heap_sift_up(keys, distances, found);
+            found++;
+        }
+        else if (distance < distances[0])
+        {
+            keys[0] = vector_keys[i];
+            distances[0] = distance;
+            heap_sift_down(keys, distances, found, 0);
+        }
+    }
+
+    // Sort the neighbours from the nearest to the farthest (heap sort)
+    for (int i = found - 1; i > 0; i--)
+    {
+        double d = distances[0]; distances[0] = distances[i]; distances[i] = d;
+        int key = keys[0]; keys[0] = keys[i]; keys[i] = key;
+        heap_sift_down(keys, distances, i, 0);
+    }
+
+    // The L2 kernel returns the squared distance
+    if (metric == KNN_L2)
+    {
+        for (int i = 0; i < found; i++)
+        {
+            distances[i] = sqrt(distances[i]);
+        }
+    }
+    return found;
+}
@@ -0,0 +1,79 @@
+#ifndef INDICE_VECTORES_H
+#define INDICE_VECTORES_H
+
+/*
+In-memory index over the vectors V_value2 of the tuples, used by the k-nearest-neighbour search (KNN).
+The vectors are stored contiguously (32 doubles each) and the search is a brute-force scan with
+SIMD distance kernels (AVX2 + FMA when the CPU supports it, SSE2 otherwise).
+The functions are not thread-safe: the caller must serialize the access to the index.
+*/
+
+#define KNN_L2 0        // Euclidean distance
+#define KNN_COSINE 1    // Cosine distance (1 - cosine similarity)
+#define KNN_MAX_K 256   // Maximum number of neighbours returned by a search
+
+/**
+ * @brief Inserta (o reemplaza) el vector de la clave key en el índice.
+ * 
+ * @param key clave.
+ * @param N_value2 dimensión del vector V_value2 [1-32].
+ * @param V_value2 vector de doubles [32].
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ * @retval 0 en caso de éxito.
+ * @retval -1 en caso de error.
+ */
+int indice_vectores_insert(int key, int N_value2, const double *V_value2);
+
+/**
+ * @brief Elimina el vector de la clave key del índice.
+ * 
+ * @param key clave.
+ * @return int La función devuelve 0 si se eliminó el vector y -1 si la clave no estaba en el índice.
+ * @retval 0 si se eliminó el vector.
+ * @retval -1 si la clave no estaba en el índice.
+ */
+int indice_vectores_remove(int key);
+
+/**
+ * @brief Elimina todos los vectores del índice.
+ */
+void indice_vectores_clear();
+
+/**
+ * @brief Busca los k vectores más cercanos a query (de su misma dimensión) según la métrica metric
+ * (KNN_L2 o KNN_COSINE). Las claves se copian en keys y las distancias en distances, ordenadas de menor
+ * a mayor distancia.
+ * 
+ * @param k número de vecinos a buscar [1-KNN_MAX_K].
+ * @param metric métrica (KNN_L2 o KNN_COSINE).
+ * @param N_query dimensión del vector query [1-32].
+ * @param query vector de consulta.
+ * @param keys vector donde se copian las claves [k].
+ * @param distances vector donde se copian las distancias [k].
+ * @return int La función devuelve el número de vecinos encontrados (como mucho k).
+ */
+int indice_vectores_knn(int k, int metric, int N_query, const double *query, int *keys, double *distances);
+
+/**
+ * @brief Calcula el producto escalar de los vectores a y b de n elementos, con los mismos kernels SIMD
+ * (AVX2 o SSE2) que indice_vectores_knn().
+ * 
+ * @param a primer vector [n].
+ * @param b segundo vector [n].
+ * @param n número de elementos [0-32].
+ * @return double producto escalar.
+ */
+double indice_vectores_dot(const double *a, const double *b, int n);
+
+/**
+ * @brief Calcula el cuadrado de la distancia euclídea entre los vectores a y b de n elementos, con los mismos
+ * kernels SIMD (AVX2 o SSE2) que indice_vectores_knn().
+ * 
+ * @param a primer vector [n].
+ * @param b segundo vector [n].
+ * @param n número de elementos [0-32].
+ * @return double cuadrado de la distancia euclídea.
+ */
+double indice_vectores_l2(const double *a, const double *b, int n);
+
+#endif
@@ -0,0 +1,300 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "instantaneas.h"
+#include "indice_claves.h"
+
+typedef struct Imagen {
+    int key;
+    uint64_t replaced;          /* Version of the write that replaced this tuple */
+    int exists;                 /* 0 if the key did not exist before that write */
+    char value1[256];
+    int N_value2;
+    double V_value2[32];
+    struct Imagen *older;       /* Previous version of the same key (NULL for the oldest kept) */
+    struct Imagen *newer;       /* Next version of the same key (NULL for the newest kept) */
+    struct Imagen *next;        /* Next version kept, in the order of the writes */
+} Imagen;
+
+typedef struct {
+    long id;                    /* 0 if the entry is free */
+    uint64_t seq;               /* Last version given when the snapshot was opened */
+    time_t used;                /* Last time the snapshot was used */
+} Instantanea;
+
+static Instantanea snapshots[INSTANTANEAS_MAX];
+static int N_snapshots = 0;
+static long last_id = 0;
+static pthread_mutex_t mutex_snapshots = PTHREAD_MUTEX_INITIALIZER;
+
+// Old versions: in the order of the writes, and the newest of each key as the value of the key in an ordered
+// index of the keys, so that a scan through a snapshot only visits the keys of its range
+#define SCAN_CHUNK 64   // Keys read from the engine at a time by instantanea_scan_keys()
+
+static Imagen *first_kept = NULL, *last_kept = NULL;
+static long N_kept = 0;
+static IndiceClaves kept_keys = INDICE_CLAVES_INIT;
+
+
+static Imagen *node_version(NodoClave *node, uint64_t seq)
+{
+    // Oldest version of the key of node replaced after seq (the state of the key in the snapshot), NULL if there is
+    // none
+    Imagen *image = node->value;
+    if (image->replaced <= seq)
+    {
+        return NULL;
+    }
+    while (image->older != NULL && image->older->replaced > seq)
+    {
+        image = image->older;
+    }
+    return image;
+}
+
+static Imagen *find_version(uint64_t seq, int key)
+{
+    NodoClave *node = indice_claves_find(&kept_keys, key);
+    return node == NULL || node->key != key ? NULL : node_version(node, seq);
+}
+
+long instantanea_open(uint64_t seq)
+{
+    pthread_mutex_lock(&mutex_snapshots);
+    long id = -1;
+    for (int i = 0; i < INSTANTANEAS_MAX; i++)
+    {
+        if (snapshots[i].id == 0)
+        {
+            id = ++last_id;
+            snapshots[i].id = id;
+            snapshots[i].seq = seq;
+            snapshots[i].used = time(NULL);
+            __atomic_store_n(&N_snapshots, N_snapshots + 1, __ATOMIC_RELAXED);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mutex_snapshots);
+    return id;
+}
+
+int instantanea_release(long id)
+{
+    pthread_mutex_lock(&mutex_snapshots);
+    int res = -1;
+    for (int i = 0; i < INSTANTANEAS_MAX && id > 0; i++)
+    {
+        if (snapshots[i].id == id)
+        {
+            snapshots[i].id = 0;
+            __atomic_store_n(&N_snapshots, N_snapshots - 1, __ATOMIC_RELAXED);
+            res = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mutex_snapshots);
+    return res;
+}
+
+int instantanea_seq(long id, uint64_t *seq)
+{
+    pthread_mutex_lock(&mutex_snapshots);
+    int res = -1;
+    for (int i = 0; i < INSTANTANEAS_MAX && id > 0; i++)
+    {
+        if (snapshots[i].id == id)
+        {
+            *seq = snapshots[i].seq;
+            snapshots[i].used = time(NULL);
+            res = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mutex_snapshots);
+    return res;
+}
+
+int instantaneas_count()
+{
+    return __atomic_load_n(&N_snapshots, __ATOMIC_RELAXED);
+}
+
+long instantaneas_kept()
+{
+    return __atomic_load_n(&N_kept, __ATOMIC_RELAXED);
+}
+
+int instantanea_record(int key, uint64_t replaced, int exists, char *value1, int N_value2, double *V_value2)
+{
+    NodoClave *node = indice_claves_insert(&kept_keys, key);
+    Imagen *image = malloc(sizeof(Imagen));
+    if (node == NULL || image == NULL)
+    {
+        if (node != NULL && node->value == NULL)
+        {
+            indice_claves_remove(&kept_keys, key);
+        }
+        free(image);
+        return -1;
+    }
+    image->key = key;
+    image->replaced = replaced;
+    image->exists = exists;
+    if (exists)
+    {
+        strcpy(image->value1, value1);
+        image->N_value2 = N_value2;
+        memcpy(image->V_value2, V_value2, N_value2 * sizeof(double));
+    }
+
+    // Newest version of the key, and last one in the order of the writes
+    image->older = node->value;
+    image->newer = NULL;
+    if (image->older != NULL)
+    {
+        image->older->newer = image;
+    }
+    node->value = image;
+    image->next = NULL;
+    if (last_kept != NULL)
+    {
+        last_kept->next = image;
+    }
+    else
+    {
+        first_kept = image;
+    }
+    last_kept = image;
+    __atomic_store_n(&N_kept, N_kept + 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+void instantaneas_reclaim()
+{
+    // Oldest snapshot still open (after releasing the ones whose lease has expired)
+    pthread_mutex_lock(&mutex_snapshots);
+    time_t now = time(NULL);
+    uint64_t oldest = UINT64_MAX;
+    for (int i = 0; i < INSTANTANEAS_MAX; i++)
+    {
+        if (snapshots[i].id != 0 && now - snapshots[i].used > INSTANTANEAS_LEASE_S)
+        {
+            snapshots[i].id = 0;
+            __atomic_store_n(&N_snapshots, N_snapshots - 1, __ATOMIC_RELAXED);
+        }
+        if (snapshots[i].id != 0 && snapshots[i].seq < oldest)
+        {
+            oldest = snapshots[i].seq;
+        }
+    }
+    pthread_mutex_unlock(&mutex_snapshots);
+
+    // The versions replaced up to the oldest snapshot are not seen by any snapshot: each one at the front is the
+    // oldest kept of its key
+    while (first_kept != NULL && first_kept->replaced <= oldest)
+    {
+        Imagen *image = first_kept;
+        first_kept = image->next;
+        if (first_kept == NULL)
+        {
+            last_kept = NULL;
+        }
+        if (image->newer != NULL)
+        {
+            image->newer->older = NULL;
+        }
+        else
+        {
+            indice_claves_remove(&kept_keys, image->key);
+        }
+        free(image);
+        __atomic_store_n(&N_kept, N_kept - 1, __ATOMIC_RELAXED);
+    }
+}
+
+void instantaneas_clear()
+{
+    pthread_mutex_lock(&mutex_snapshots);
+    for (int i = 0; i < INSTANTANEAS_MAX; i++)
+    {
+        snapshots[i].id = 0;
+    }
+    __atomic_store_n(&N_snapshots, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&mutex_snapshots);
+    instantaneas_reclaim();
+}
+
+int instantanea_get_value(const Motor *engine, uint64_t seq, int key, char *value1, int *N_value2, double *V_value2)
+{
+    Imagen *image = find_version(seq, key);
+    if (image == NULL)
+    {
+        return engine->get_value(key, value1, N_value2, V_value2);
+    }
+    if (!image->exists)
+    {
+        return -1;
+    }
+    strcpy(value1, image->value1);
+    *N_value2 = image->N_value2;
+    memcpy(V_value2, image->V_value2, image->N_value2 * sizeof(double));
+    return 0;
+}
+
+int instantanea_scan_keys(const Motor *engine, uint64_t seq, int start_key, int end_key, int limit, int *keys)
+{
+    if (limit < 1 || start_key > end_key)
+    {
+        return limit < 1 ? -1 : 0;
+    }
+
+    // Merge the current keys, chunk by chunk, with the keys of the range that have old versions (in order in the
+    // skiplist): a key written after seq decides on its own state, the rest are as they are now
+    int current[SCAN_CHUNK];
+    NodoClave *node = indice_claves_find(&kept_keys, start_key);
+    int n = 0;
+    int from = start_key;
+    while (n < limit)
+    {
+        int m = engine->scan_keys(from, end_key, SCAN_CHUNK, current);
+        if (m < 0)
+        {
+            return -1;
+        }
+        int bound = m == SCAN_CHUNK ? current[m - 1] : end_key;     // Last key whose state is known
+        int j = 0;
+        while (n < limit && (j < m || (node != NULL && node->key <= bound)))
+        {
+            int key;
+            if (node != NULL && node->key <= bound && (j == m || node->key <= current[j]))
+            {
+                key = node->key;
+                int exists = j < m && current[j] == key;
+                if (exists)
+                {
+                    j++;
+                }
+                Imagen *image = node_version(node, seq);
+                node = node->forward[0];
+                if (image != NULL ? !image->exists : !exists)
+                {
+                    continue;
+                }
+            }
+            else
+            {
+                key = current[j++];
+            }
+            keys[n++] = key;
+        }
+        if (m < SCAN_CHUNK || bound == end_key)
+        {
+            break;
+        }
+        from = bound + 1;
+    }
+    return n;
+}
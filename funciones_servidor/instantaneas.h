@@ -0,0 +1,126 @@
+#ifndef INSTANTANEAS_H
+#define INSTANTANEAS_H
+
+/*
+Snapshots of the whole store, for the SCAN and AGGREGATE that must see a point-in-time view while the writes
+go on. A snapshot is the last version given (versiones.h) when it was opened: every write after it has a
+greater version. While a snapshot is open, each write keeps the tuple it replaces (or its absence), tagged
+with the version of the write, in a chain of older versions of the key. The state of a key in snapshot seq is
+then the oldest kept version replaced after seq, or the current tuple if there is none, so the engines are
+not changed and the writes only pay for a read of the old tuple while some snapshot is open.
+The keys with old versions are kept in order (skiplist), so a scan through a snapshot merges the keys of the
+engine with the ones of its range only, without allocating or visiting the rest.
+The old versions are reclaimed by epochs: they are kept in the order of the writes, and the ones replaced
+before the oldest snapshot open (all of them, when none is open) are freed from the front.
+A snapshot not used for INSTANTANEAS_LEASE_S seconds is released, so that a client that never releases one
+cannot keep the old versions forever. INIT releases every snapshot.
+The snapshots are protected by their own mutex. The old versions follow the storage lock of the server:
+instantanea_record(), instantaneas_reclaim() and instantaneas_clear() are called with it exclusive, and
+instantanea_get_value() and instantanea_scan_keys() with it at least shared.
+*/
+
+#include <stdint.h>
+
+#include "motor.h"
+
+#define INSTANTANEAS_MAX 64         // Maximum number of snapshots open at a time
+#define INSTANTANEAS_LEASE_S 60     // Seconds after which a snapshot not used is released
+
+/**
+ * @brief Abre una instantánea de todo el almacenamiento en la versión seq (la última versión asignada).
+ * 
+ * @param seq versión de la instantánea.
+ * @return long La función devuelve el identificador de la instantánea (>= 1), o -1 si ya hay
+ * INSTANTANEAS_MAX abiertas.
+ */
+long instantanea_open(uint64_t seq);
+
+/**
+ * @brief Libera la instantánea id.
+ * 
+ * @param id identificador de la instantánea.
+ * @return int La función devuelve 0 en caso de éxito y -1 si la instantánea no está abierta.
+ * @retval 0 en caso de éxito.
+ * @retval -1 si la instantánea no está abierta.
+ */
+int instantanea_release(long id);
+
+/**
+ * @brief Obtiene la versión de la instantánea id (y renueva su plazo).
+ * 
+ * @param id identificador de la instantánea.
+ * @param seq versión de la instantánea.
+ * @return int La función devuelve 0 en caso de éxito y -1 si la instantánea no está abierta.
+ * @retval 0 en caso de éxito.
+ * @retval -1 si la instantánea no está abierta.
+ */
+int instantanea_seq(long id, uint64_t *seq);
+
+/**
+ * @brief Devuelve el número de instantáneas abiertas.
+ * 
+ * @return int número de instantáneas abiertas.
+ */
+int instantaneas_count();
+
+/**
+ * @brief Devuelve el número de versiones antiguas guardadas.
+ * 
+ * @return long número de versiones antiguas guardadas.
+ */
+long instantaneas_kept();
+
+/**
+ * @brief Guarda la tupla que tenía la clave key antes de la escritura con versión replaced.
+ * 
+ * @param key clave.
+ * @param replaced versión de la escritura que reemplazó la tupla.
+ * @param exists 1 si la clave existía antes de la escritura, 0 si no.
+ * @param value1 valor1 [256].
+ * @param N_value2 dimensión del vector V_value2 [1-32].
+ * @param V_value2 vector de doubles [32].
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ * @retval 0 en caso de éxito.
+ * @retval -1 en caso de error.
+ */
+int instantanea_record(int key, uint64_t replaced, int exists, char *value1, int N_value2, double *V_value2);
+
+/**
+ * @brief Libera las versiones antiguas que ya no necesita ninguna instantánea abierta, y las instantáneas
+ * que no se han usado en INSTANTANEAS_LEASE_S segundos.
+ */
+void instantaneas_reclaim();
+
+/**
+ * @brief Libera todas las instantáneas y todas las versiones antiguas (tras INIT).
+ */
+void instantaneas_clear();
+
+/**
+ * @brief Obtiene la tupla de la clave key en la instantánea de versión seq.
+ * 
+ * @param engine motor de almacenamiento.
+ * @param seq versión de la instantánea.
+ * @param key clave.
+ * @param value1 valor1 [256].
+ * @param N_value2 dimensión del vector V_value2 [1-32].
+ * @param V_value2 vector de doubles [32].
+ * @return int La función devuelve 0 si la clave existía en la instantánea y -1 si no (o en caso de error).
+ */
+int instantanea_get_value(const Motor *engine, uint64_t seq, int key, char *value1, int *N_value2, double *V_value2);
+
+/**
+ * @brief Obtiene en orden las claves del rango [start_key, end_key] que existían en la instantánea de versión
+ * seq, como mucho limit.
+ * 
+ * @param engine motor de almacenamiento.
+ * @param seq versión de la instantánea.
+ * @param start_key primera clave del rango (incluida).
+ * @param end_key última clave del rango (incluida).
+ * @param limit número máximo de claves [>= 1].
+ * @param keys vector donde se copian las claves [limit].
+ * @return int La función devuelve el número de claves copiadas, o -1 en caso de error.
+ */
+int instantanea_scan_keys(const Motor *engine, uint64_t seq, int start_key, int end_key, int limit, int *keys);
+
+#endif
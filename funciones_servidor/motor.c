@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "motor.h"
+#include "motor_memoria.h"
+#include "motor_lsm.h"
+#include "funciones_servidor.h"
+
+
+// Text engine: the functions of funciones_servidor.c
+
+static int texto_open(const char *path)
+{
+    return set_file_name(path != NULL ? path : FILE_NAME);
+}
+
+static void texto_close()
+{
+}
+
+static int texto_shared_read(int op, int key)
+{
+    // The lookups in the in-memory indexes (all the read-only operations but AGGREGATE, FILTER and STATS) only
+    // rebuild them with the lock exclusive, so they are shared once the indexes are in sync with the file (then
+    // they use them as they are until the lock is released), and GET_VALUE and GET_FIELDS load the tuple again
+    // if it has been evicted (--tuple-cache), which is a write (and so does GET_VERSIONED)
+    if (op != AGGREGATE && op != FILTER && op != STATS && !indexes_synced())
+    {
+        return 0;
+    }
+    return !((op == GET_VALUE || op == GET_FIELDS || op == GET_VERSIONED) && !tuple_resident(key));
+}
+
+static int texto_stats(char *buffer, int size)
+{
+    // Tuples in the cache and evicted to the file (--tuple-cache); the key, vector and value1 indexes are not counted
+    NivelesTuplas tiers;
+    get_tiers(&tiers);
+    int len = snprintf(buffer, size,
+                       "tuplas_storage_tuples{tier=\"memory\"} %ld\n"
+                       "tuplas_storage_tuples{tier=\"file\"} %ld\n"
+                       "tuplas_tuple_cache_bytes %ld\n"
+                       "tuplas_tuple_cache_limit_bytes %ld\n"
+                       "tuplas_storage_evictions_total %ld\n"
+                       "tuplas_storage_faults_total %ld\n",
+                       tiers.hot, tiers.cold, tiers.hot_bytes, tiers.max_bytes, tiers.evictions, tiers.faults);
+    return len < size ? len : size - 1;
+}
+
+static const Motor motor_texto = {
+    "text", FILE_NAME,
+    texto_open, texto_close, init,
+    set_value, get_value, modify_value, delete_key, exist,
+    scan_keys, aggregate_values, filter_keys, knn_search,
+    get_by_value1, prefix_value1,
+    texto_shared_read, texto_stats
+};
+
+
+// LSM-tree engine: the functions of motor_lsm.c
+
+static int lsm_shared_read(int op, int key)
+{
+    // There are no indexes to rebuild: the reads never write
+    (void)op;
+    (void)key;
+    return 1;
+}
+
+static int lsm_format_stats(char *buffer, int size)
+{
+    // Memtables, segments of each level and compactions
+    EstadisticasLsm stats;
+    lsm_stats(&stats);
+    int len = snprintf(buffer, size, "tuplas_lsm_memtable_entries %ld\n", stats.memtable);
+    for (int i = 0; i < LSM_LEVELS && len < size; i++)
+    {
+        len += snprintf(buffer + len, size - len, "tuplas_lsm_segments{level=\"%d\"} %ld\n"
+                        "tuplas_lsm_bytes{level=\"%d\"} %ld\n", i, stats.segments[i], i, stats.bytes[i]);
+    }
+    if (len < size)
+    {
+        len += snprintf(buffer + len, size - len, "tuplas_lsm_flushes_total %ld\n"
+                        "tuplas_lsm_compactions_total %ld\n"
+                        "tuplas_lsm_compaction_bytes_total %ld\n",
+                        stats.flushes, stats.compactions, stats.compaction_bytes);
+    }
+    return len < size ? len : size - 1;
+}
+
+static int lsm_open_default(const char *path)
+{
+    return lsm_open(path != NULL ? path : LSM_DIR);
+}
+
+static const Motor motor_lsm = {
+    "lsm", LSM_DIR,
+    lsm_open_default, lsm_close, lsm_init,
+    lsm_set_value, lsm_get_value, lsm_modify_value, lsm_delete_key, lsm_exist,
+    lsm_scan_keys, lsm_aggregate_values, lsm_filter_keys, lsm_knn_search,
+    lsm_get_by_value1, lsm_prefix_value1,
+    lsm_shared_read, lsm_format_stats
+};
+
+
+static const Motor *engines[] = {&motor_texto, &motor_memoria, &motor_lsm};
+
+const Motor *motor_find(const char *name)
+{
+    for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++)
+    {
+        if (strcmp(engines[i]->name, name) == 0)
+        {
+            return engines[i];
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,50 @@
+#ifndef MOTOR_H
+#define MOTOR_H
+
+/*
+Interface of the storage engines of the server: a table of functions with the services of
+funciones_servidor.h, so that the engine is chosen when the server starts (--engine) and the clients do not
+change. The engines are:
+ - text: the text file of funciones_servidor.c (FILE_NAME), with its in-memory indexes as a cache.
+ - memory: the in-memory indexes alone, nothing is written to disk (motor_memoria.c).
+ - lsm: the LSM tree of motor_lsm.c, for write-heavy workloads.
+Only one engine can be open in a process.
+*/
+
+#include "agregados.h"
+
+typedef struct {
+    const char *name;           /* Name of the engine (--engine) */
+    const char *default_path;   /* Storage used when open() receives NULL (NULL if there is none) */
+
+    int (*open)(const char *path);      /* Start the engine on the file or directory path */
+    void (*close)();                    /* Stop the engine (the data stored are kept) */
+    int (*init)();
+    int (*set_value)(int key, char *value1, int N_value2, double *V_value2);
+    int (*get_value)(int key, char *value1, int *N_value2, double *V_value2);
+    int (*modify_value)(int key, char *value1, int N_value2, double *V_value2);
+    int (*delete_key)(int key);
+    int (*exist)(int key);
+    int (*scan_keys)(int start_key, int end_key, int limit, int *keys);
+    int (*aggregate_values)(int element, Agregado *agg);
+    int (*filter_keys)(int element, int cmp, double threshold, int **keys);
+    int (*knn_search)(int k, int metric, int N_value2, double *V_value2, int *keys, double *distances);
+    int (*get_by_value1)(char *value1, int **keys);
+    int (*prefix_value1)(char *prefix, int limit, int **keys);
+
+    /* 1 if the read-only operation op (on key) can run at the same time as other read-only operations, 0 if
+       it has to be serialized with every other call (the writes always are) */
+    int (*shared_read)(int op, int key);
+    /* Metrics of the engine, one per line, written to buffer; returns the length */
+    int (*stats)(char *buffer, int size);
+} Motor;
+
+/**
+ * @brief Busca el motor de almacenamiento de nombre name.
+ * 
+ * @param name nombre del motor (text, memory o lsm).
+ * @return const Motor* La función devuelve el motor, o NULL si no existe ninguno con ese nombre.
+ */
+const Motor *motor_find(const char *name);
+
+#endif
@@ -0,0 +1,1698 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "motor_lsm.h"
+#include "indice_vectores.h"
+#include "../funciones_log/funciones_log.h"
+
+#define MEMTABLE_MAX 4096           // Entries of a memtable (it is written to level 0 when it is full)
+#define INDEX_INTERVAL 16           // Records of a segment between two entries of its sparse index
+#define BLOOM_BITS_PER_KEY 10       // Bits of the Bloom filter per record (about 1% of false positives)
+#define BLOOM_HASHES 7              // Hash functions of the Bloom filter
+#define L0_COMPACTION 4             // Segments in level 0 that start a compaction into level 1
+#define L0_STALL 12                 // Segments in level 0 at which the writes wait for the compaction
+#define L0_MAX (L0_STALL + 2)       // Capacity of the list of segments of level 0
+#define MAX_SOURCES (2 + L0_MAX + LSM_LEVELS)   // Memtables and segments merged by an iterator
+#define MAX_RECORD (4 + 1 + 1 + 255 + 1 + 32 * 8)   // Size of the largest encoded record
+#define CURSOR_BUFFER (16 * 1024)   // Bytes read at a time when a segment is read sequentially
+#define SEGMENT_MAGIC 0x4c534d31u
+#define WAL_NAME "wal.log"
+#define WAL_IMMUTABLE_NAME "wal-imm.log"
+#define MAX_SCAN_THREADS 16         // Maximum number of threads used to aggregate or filter all the tuples
+#define MIN_RECORDS_PER_THREAD 4096 // Smaller stores are not worth splitting
+#define INIT_NAME "init"          // Created by lsm_init(): before it every operation fails, like without FILE_NAME
+
+typedef struct {
+    int key;
+    int deleted;            /* 1 if it is the deletion of the key (tombstone) */
+    char value1[256];
+    int N_value2;
+    double V_value2[32];
+} Entrada;
+
+typedef struct {
+    Entrada entries[MEMTABLE_MAX];  /* Entries in order of arrival */
+    int order[MEMTABLE_MAX];        /* Positions in entries sorted by key */
+    int N;
+} Memtable;
+
+typedef struct {
+    uint64_t index_offset;  /* Offset of the sparse index (end of the records) */
+    uint64_t bloom_offset;  /* Offset of the Bloom filter */
+    uint32_t N_index;       /* Entries of the sparse index */
+    uint32_t bloom_bits;    /* Bits of the Bloom filter */
+    uint32_t N_records;
+    int32_t min_key;
+    int32_t max_key;
+    uint32_t magic;
+} Trailer;
+
+typedef struct {
+    char path[PATH_MAX];
+    int fd;
+    int level;
+    unsigned long id;       /* Segments with higher ids are newer */
+    long data_size;         /* Bytes of the records */
+    long file_size;
+    Trailer trailer;
+    int *index_keys;        /* Key of every INDEX_INTERVAL-th record */
+    long *index_offsets;    /* Offset of those records */
+    unsigned char *bloom;
+} Segmento;
+
+typedef struct {
+    Memtable *memtable;     /* Memtable read by the source, or NULL if it is a segment */
+    int pos;                /* Position in the order of the memtable */
+    Segmento *segment;
+    unsigned char *buffer;  /* Bytes of the segment from buffer_offset */
+    long buffer_offset;
+    int buffer_len;
+    int buffer_pos;
+    int valid;              /* 1 if current holds the next entry of the source */
+    Entrada current;
+} Fuente;
+
+typedef struct {
+    Fuente sources[MAX_SOURCES];    /* From the newest to the oldest */
+    int N_sources;
+    Entrada current;
+} Iterador;
+
+typedef struct {
+    int start_key;          /* First key of the part */
+    int end_key;            /* Last key of the part */
+    int element;            /* Element of V_value2 to consider, -1 for all of them */
+    int cmp;                /* Predicate of the filter (FILTER_GREATER or FILTER_LESS), -1 to aggregate */
+    double threshold;       /* Threshold of the filter */
+    Agregado agg;           /* Partial aggregate of the part */
+    int *keys;              /* Keys that match the filter in the part */
+    int N_keys;             /* Number of keys in keys */
+    int capacity;           /* Capacity of keys */
+    int error;              /* -1 if there has been an error */
+} ScanPart;
+
+static char lsm_dir[PATH_MAX];
+static Memtable tables[2];
+static Memtable *memtable = &tables[0];     // Memtable that receives the writes
+static Memtable *immutable = NULL;          // Full memtable waiting to be written to level 0
+static FILE *wal = NULL;
+static Segmento *level0[L0_MAX];            // Segments of level 0, from the newest to the oldest
+static int N_level0 = 0;
+static Segmento *levels[LSM_LEVELS];        // Single segment of each level >= 1 (NULL if it is empty)
+static unsigned long next_id = 1;
+static long flushes = 0;
+static long compactions = 0;
+static long compaction_bytes = 0;
+
+// The lists of segments and the memtables are changed with lock_segments taken exclusively (and
+// mutex_lsm, which protects the work of the compaction thread); every read takes it shared
+static pthread_rwlock_t lock_segments = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_mutex_t mutex_lsm = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond_work = PTHREAD_COND_INITIALIZER;    // There is a memtable to write or a level to compact
+static pthread_cond_t cond_idle = PTHREAD_COND_INITIALIZER;    // The compaction thread has finished a task
+static int busy = 0;                        // 1 while the compaction thread works
+static int paused = 0;                      // 1 while lsm_init() deletes the segments
+static int stopping = 0;                    // 1 while lsm_close() waits for the compaction thread to exit
+static pthread_t compaction_thread;
+static int opened = 0;
+static int initialized = 0;                 // 1 once lsm_init() has been called in the directory
+
+
+static void path_of(char *path, const char *name)
+{
+    // The directory is shorter than PATH_MAX - 64 (checked by lsm_open), the names fit in the rest
+    snprintf(path, PATH_MAX, "%.*s/%s", PATH_MAX - 64, lsm_dir, name);
+}
+
+// Encoding of an entry in the log and in the segments:
+// key (4 bytes), deleted (1), length of value1 (1), value1, N_value2 (1), V_value2 (8 * N_value2)
+// (the deletions end after the deleted byte)
+
+static int encode(const Entrada *e, unsigned char *buffer)
+{
+    memcpy(buffer, &e->key, 4);
+    buffer[4] = e->deleted;
+    if (e->deleted)
+    {
+        return 5;
+    }
+    int len1 = strlen(e->value1);
+    buffer[5] = len1;
+    memcpy(buffer + 6, e->value1, len1);
+    buffer[6 + len1] = e->N_value2;
+    memcpy(buffer + 7 + len1, e->V_value2, e->N_value2 * sizeof(double));
+    return 7 + len1 + e->N_value2 * sizeof(double);
+}
+
+static int decode(const unsigned char *buffer, int len, Entrada *e)
+{
+    // Return the bytes used, 0 if the record is not complete and -1 if it is not valid
+    if (len < 5)
+    {
+        return 0;
+    }
+    memcpy(&e->key, buffer, 4);
+    e->deleted = buffer[4];
+    if (e->deleted)
+    {
+        return e->deleted == 1 ? 5 : -1;
+    }
+    if (len < 6)
+    {
+        return 0;
+    }
+    int len1 = buffer[5];
+    if (len < 7 + len1)
+    {
+        return 0;
+    }
+    memcpy(e->value1, buffer + 6, len1);
+    e->value1[len1] = '\0';
+    e->N_value2 = buffer[6 + len1];
+    if (e->N_value2 < 1 || e->N_value2 > 32)
+    {
+        return -1;
+    }
+    int size = 7 + len1 + e->N_value2 * sizeof(double);
+    if (len < size)
+    {
+        return 0;
+    }
+    memcpy(e->V_value2, buffer + 7 + len1, e->N_value2 * sizeof(double));
+    return size;
+}
+
+
+// Memtable: the entries are appended and a separate array keeps their positions sorted by key
+
+static int memtable_find(const Memtable *m, int key)
+{
+    // Return the position of the key in the order, or -(insertion point) - 1 if it is not there
+    int low = 0, high = m->N - 1;
+    while (low <= high)
+    {
+        int mid = (low + high) / 2;
+        int mid_key = m->entries[m->order[mid]].key;
+        if (mid_key == key) { return mid; }
+        if (mid_key < key) { low = mid + 1; } else { high = mid - 1; }
+    }
+    return -low - 1;
+}
+
+static void memtable_put(Memtable *m, const Entrada *e)
+{
+    int pos = memtable_find(m, e->key);
+    if (pos >= 0)
+    {
+        m->entries[m->order[pos]] = *e;
+        return;
+    }
+    pos = -pos - 1;
+    m->entries[m->N] = *e;
+    memmove(m->order + pos + 1, m->order + pos, (m->N - pos) * sizeof(int));
+    m->order[pos] = m->N;
+    m->N++;
+}
+
+
+// Bloom filter of the keys of a segment (double hashing)
+
+static uint32_t mix(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+static void bloom_add(unsigned char *bloom, uint32_t bits, int key)
+{
+    uint32_t h1 = mix((uint32_t)key);
+    uint32_t h2 = mix(h1 ^ 0x9e3779b9u) | 1;
+    for (int i = 0; i < BLOOM_HASHES; i++)
+    {
+        uint32_t bit = (h1 + i * h2) % bits;
+        bloom[bit / 8] |= 1 << (bit % 8);
+    }
+}
+
+static int bloom_may_contain(const unsigned char *bloom, uint32_t bits, int key)
+{
+    uint32_t h1 = mix((uint32_t)key);
+    uint32_t h2 = mix(h1 ^ 0x9e3779b9u) | 1;
+    for (int i = 0; i < BLOOM_HASHES; i++)
+    {
+        uint32_t bit = (h1 + i * h2) % bits;
+        if (!(bloom[bit / 8] & (1 << (bit % 8))))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+// Segments: the records sorted by key, followed by the sparse index, the Bloom filter and the trailer
+
+static void segment_free(Segmento *s)
+{
+    if (s == NULL)
+    {
+        return;
+    }
+    if (s->fd >= 0)
+    {
+        close(s->fd);
+    }
+    free(s->index_keys);
+    free(s->index_offsets);
+    free(s->bloom);
+    free(s);
+}
+
+static Segmento *segment_open(const char *path, int level, unsigned long id)
+{
+    Segmento *s = calloc(1, sizeof(Segmento));
+    if (s == NULL)
+    {
+        LOG_PERROR("Error allocating memory");
+        return NULL;
+    }
+    snprintf(s->path, PATH_MAX, "%s", path);
+    s->level = level;
+    s->id = id;
+    s->fd = open(path, O_RDONLY);
+    struct stat file_state;
+    if (s->fd < 0 || fstat(s->fd, &file_state) < 0)
+    {
+        LOG_PERROR("Error opening the segment %s", path);
+        segment_free(s);
+        return NULL;
+    }
+    s->file_size = file_state.st_size;
+
+    Trailer *t = &s->trailer;
+    if (s->file_size < (long)sizeof(Trailer) || pread(s->fd, t, sizeof(Trailer), s->file_size - sizeof(Trailer)) != sizeof(Trailer) ||
+        t->magic != SEGMENT_MAGIC || t->index_offset > t->bloom_offset || t->bloom_bits == 0 ||
+        t->bloom_offset + (t->bloom_bits + 7) / 8 + sizeof(Trailer) != (uint64_t)s->file_size ||
+        t->index_offset + t->N_index * (sizeof(int32_t) + sizeof(uint64_t)) != t->bloom_offset)
+    {
+        LOG_ERROR("The segment %s is not valid", path);
+        segment_free(s);
+        return NULL;
+    }
+    s->data_size = t->index_offset;
+
+    // Load the sparse index and the Bloom filter
+    s->index_keys = malloc((t->N_index + 1) * sizeof(int));
+    s->index_offsets = malloc((t->N_index + 1) * sizeof(long));
+    s->bloom = malloc((t->bloom_bits + 7) / 8);
+    unsigned char *index = malloc(t->N_index * (sizeof(int32_t) + sizeof(uint64_t)) + 1);
+    size_t index_size = t->N_index * (sizeof(int32_t) + sizeof(uint64_t));
+    if (s->index_keys == NULL || s->index_offsets == NULL || s->bloom == NULL || index == NULL)
+    {
+        LOG_PERROR("Error allocating memory");
+        free(index);
+        segment_free(s);
+        return NULL;
+    }
+    if (pread(s->fd, index, index_size, t->index_offset) != (ssize_t)index_size ||
+        pread(s->fd, s->bloom, (t->bloom_bits + 7) / 8, t->bloom_offset) != (ssize_t)((t->bloom_bits + 7) / 8))
+    {
+        LOG_PERROR("Error reading the segment %s", path);
+        free(index);
+        segment_free(s);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < t->N_index; i++)
+    {
+        int32_t key;
+        uint64_t offset;
+        memcpy(&key, index + i * 12, 4);
+        memcpy(&offset, index + i * 12 + 4, 8);
+        s->index_keys[i] = key;
+        s->index_offsets[i] = offset;
+    }
+    free(index);
+    return s;
+}
+
+static int segment_get(Segmento *s, int key, Entrada *e)
+{
+    // Look the key up in the segment: return 1 if it is there (maybe deleted), 0 if not and -1 on error
+    Trailer *t = &s->trailer;
+    if (t->N_records == 0 || key < t->min_key || key > t->max_key || !bloom_may_contain(s->bloom, t->bloom_bits, key))
+    {
+        return 0;
+    }
+
+    // The last entry of the sparse index not greater than the key starts the block that may contain it
+    int low = 0, high = t->N_index - 1;
+    while (low < high)
+    {
+        int mid = (low + high + 1) / 2;
+        if (s->index_keys[mid] <= key) { low = mid; } else { high = mid - 1; }
+    }
+    long start = s->index_offsets[low];
+    long end = low + 1 < (int)t->N_index ? s->index_offsets[low + 1] : s->data_size;
+
+    unsigned char block[INDEX_INTERVAL * MAX_RECORD];
+    if (end - start > (long)sizeof(block) || pread(s->fd, block, end - start, start) != end - start)
+    {
+        LOG_PERROR("Error reading the segment %s", s->path);
+        return -1;
+    }
+    for (long pos = 0; pos < end - start; )
+    {
+        int n = decode(block + pos, end - start - pos, e);
+        if (n <= 0)
+        {
+            LOG_ERROR("The segment %s is not valid", s->path);
+            return -1;
+        }
+        if (e->key == key)
+        {
+            return 1;
+        }
+        if (e->key > key)
+        {
+            return 0;
+        }
+        pos += n;
+    }
+    return 0;
+}
+
+
+// Iterators: merge of the memtables and the segments in key order, the newest version of each key wins
+
+static void source_fill(Fuente *f)
+{
+    // Keep the unread bytes and read the next ones of the segment after them
+    Segmento *s = f->segment;
+    memmove(f->buffer, f->buffer + f->buffer_pos, f->buffer_len - f->buffer_pos);
+    f->buffer_offset += f->buffer_pos;
+    f->buffer_len -= f->buffer_pos;
+    f->buffer_pos = 0;
+    long remaining = s->data_size - (f->buffer_offset + f->buffer_len);
+    long n = CURSOR_BUFFER - f->buffer_len;
+    if (n > remaining) { n = remaining; }
+    if (n > 0)
+    {
+        ssize_t read_bytes = pread(s->fd, f->buffer + f->buffer_len, n, f->buffer_offset + f->buffer_len);
+        if (read_bytes < 0)
+        {
+            LOG_PERROR("Error reading the segment %s", s->path);
+            return;
+        }
+        f->buffer_len += read_bytes;
+    }
+}
+
+static void source_next(Fuente *f)
+{
+    if (f->memtable != NULL)
+    {
+        f->valid = f->pos < f->memtable->N;
+        if (f->valid)
+        {
+            f->current = f->memtable->entries[f->memtable->order[f->pos++]];
+        }
+        return;
+    }
+
+    if (f->buffer_len - f->buffer_pos < MAX_RECORD)
+    {
+        source_fill(f);
+    }
+    f->valid = 0;
+    if (f->buffer_pos >= f->buffer_len)
+    {
+        return;
+    }
+    int n = decode(f->buffer + f->buffer_pos, f->buffer_len - f->buffer_pos, &f->current);
+    if (n <= 0)
+    {
+        LOG_ERROR("The segment %s is not valid", f->segment->path);
+        return;
+    }
+    f->buffer_pos += n;
+    f->valid = 1;
+}
+
+static void source_seek(Fuente *f, int key)
+{
+    // Position the source on the first entry with a key not less than key
+    if (f->memtable != NULL)
+    {
+        f->pos = memtable_find(f->memtable, key);
+        if (f->pos < 0) { f->pos = -f->pos - 1; }
+        source_next(f);
+        return;
+    }
+
+    Segmento *s = f->segment;
+    int block = 0;
+    for (int low = 0, high = s->trailer.N_index - 1; low <= high; )
+    {
+        int mid = (low + high) / 2;
+        if (s->index_keys[mid] <= key) { block = mid; low = mid + 1; } else { high = mid - 1; }
+    }
+    f->buffer_offset = s->trailer.N_index > 0 ? s->index_offsets[block] : 0;
+    f->buffer_len = f->buffer_pos = 0;
+    do
+    {
+        source_next(f);
+    } while (f->valid && f->current.key < key);
+}
+
+static void iterator_close(Iterador *it)
+{
+    for (int i = 0; i < it->N_sources; i++)
+    {
+        free(it->sources[i].buffer);
+    }
+    it->N_sources = 0;
+}
+
+static int iterator_add(Iterador *it, Memtable *m, Segmento *s, int start_key)
+{
+    if ((m != NULL && m->N == 0) || (s != NULL && (s->trailer.N_records == 0 || s->trailer.max_key < start_key)))
+    {
+        return 0;
+    }
+    Fuente *f = &it->sources[it->N_sources];
+    memset(f, 0, sizeof(Fuente) - sizeof(Entrada));
+    f->memtable = m;
+    f->segment = s;
+    if (s != NULL && (f->buffer = malloc(CURSOR_BUFFER)) == NULL)
+    {
+        LOG_PERROR("Error allocating memory");
+        return -1;
+    }
+    it->N_sources++;
+    source_seek(f, start_key);
+    return 0;
+}
+
+static int iterator_open_segments(Iterador *it, Segmento **segments, int N_segments, int start_key)
+{
+    for (int i = 0; i < N_segments; i++)
+    {
+        if (iterator_add(it, NULL, segments[i], start_key) < 0)
+        {
+            iterator_close(it);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int iterator_open(Iterador *it, int start_key)
+{
+    // Iterate over all the data from start_key (the caller holds lock_segments)
+    Segmento *segments[L0_MAX + LSM_LEVELS];
+    int N_segments = 0;
+    for (int i = 0; i < N_level0; i++)
+    {
+        segments[N_segments++] = level0[i];
+    }
+    for (int i = 1; i < LSM_LEVELS; i++)
+    {
+        if (levels[i] != NULL) { segments[N_segments++] = levels[i]; }
+    }
+
+    it->N_sources = 0;
+    iterator_add(it, memtable, NULL, start_key);
+    if (immutable != NULL)
+    {
+        iterator_add(it, immutable, NULL, start_key);
+    }
+    return iterator_open_segments(it, segments, N_segments, start_key);
+}
+
+static int iterator_next(Iterador *it)
+{
+    // Move to the next key (in it->current, maybe deleted): return 1, or 0 at the end
+    int best = -1;
+    for (int i = 0; i < it->N_sources; i++)
+    {
+        if (it->sources[i].valid && (best < 0 || it->sources[i].current.key < it->sources[best].current.key))
+        {
+            best = i;
+        }
+    }
+    if (best < 0)
+    {
+        return 0;
+    }
+    it->current = it->sources[best].current;
+
+    // Skip the older versions of the key
+    for (int i = 0; i < it->N_sources; i++)
+    {
+        if (it->sources[i].valid && it->sources[i].current.key == it->current.key)
+        {
+            source_next(&it->sources[i]);
+        }
+    }
+    return 1;
+}
+
+
+// Writing of segments and compaction
+
+static int write_segment(int level, Iterador *it, int drop_deleted, Segmento **segment)
+{
+    // Write the entries of the iterator to a new segment of the level (NULL if there are none)
+    *segment = NULL;
+    unsigned long id = __atomic_fetch_add(&next_id, 1, __ATOMIC_RELAXED);
+    char name[64], path[PATH_MAX], temp_path[PATH_MAX];
+    snprintf(name, sizeof(name), "L%d-%lu.seg", level, id);
+    path_of(path, name);
+    snprintf(temp_path, PATH_MAX, "%.*s.tmp", PATH_MAX - 8, path);
+
+    FILE *file = fopen(temp_path, "w");
+    if (file == NULL)
+    {
+        LOG_PERROR("Error creating the segment %s", temp_path);
+        return -1;
+    }
+
+    int *index_keys = NULL;
+    long *index_offsets = NULL;
+    int *keys = NULL;
+    int N_index = 0, N_records = 0, capacity = 0;
+    long offset = 0;
+    int res = 0;
+    unsigned char record[MAX_RECORD];
+    while (res == 0 && iterator_next(it))
+    {
+        if (drop_deleted && it->current.deleted)
+        {
+            continue;
+        }
+        if (N_records == capacity)
+        {
+            capacity = capacity == 0 ? 1024 : 2 * capacity;
+            int *new_keys = realloc(keys, capacity * sizeof(int));
+            int *new_index_keys = realloc(index_keys, (capacity / INDEX_INTERVAL + 1) * sizeof(int));
+            long *new_index_offsets = realloc(index_offsets, (capacity / INDEX_INTERVAL + 1) * sizeof(long));
+            if (new_keys != NULL) { keys = new_keys; }
+            if (new_index_keys != NULL) { index_keys = new_index_keys; }
+            if (new_index_offsets != NULL) { index_offsets = new_index_offsets; }
+            if (new_keys == NULL || new_index_keys == NULL || new_index_offsets == NULL)
+            {
+                LOG_PERROR("Error allocating memory");
+                res = -1;
+                break;
+            }
+        }
+        if (N_records % INDEX_INTERVAL == 0)
+        {
+            index_keys[N_index] = it->current.key;
+            index_offsets[N_index++] = offset;
+        }
+        keys[N_records++] = it->current.key;
+        int n = encode(&it->current, record);
+        if (fwrite(record, 1, n, file) != (size_t)n)
+        {
+            LOG_PERROR("Error writing the segment %s", temp_path);
+            res = -1;
+        }
+        offset += n;
+    }
+
+    Trailer t;
+    memset(&t, 0, sizeof(Trailer));
+    unsigned char *bloom = NULL;
+    if (res == 0 && N_records > 0)
+    {
+        t.index_offset = offset;
+        t.N_index = N_index;
+        t.bloom_offset = offset + N_index * (sizeof(int32_t) + sizeof(uint64_t));
+        t.bloom_bits = N_records * BLOOM_BITS_PER_KEY;
+        t.N_records = N_records;
+        t.min_key = keys[0];
+        t.max_key = keys[N_records - 1];
+        t.magic = SEGMENT_MAGIC;
+        bloom = calloc((t.bloom_bits + 7) / 8, 1);
+        if (bloom == NULL)
+        {
+            LOG_PERROR("Error allocating memory");
+            res = -1;
+        }
+        for (int i = 0; res == 0 && i < N_records; i++)
+        {
+            bloom_add(bloom, t.bloom_bits, keys[i]);
+        }
+        for (int i = 0; res == 0 && i < N_index; i++)
+        {
+            int32_t key = index_keys[i];
+            uint64_t index_offset = index_offsets[i];
+            if (fwrite(&key, 4, 1, file) != 1 || fwrite(&index_offset, 8, 1, file) != 1)
+            {
+                res = -1;
+            }
+        }
+        if (res == 0 && (fwrite(bloom, 1, (t.bloom_bits + 7) / 8, file) != (t.bloom_bits + 7) / 8 ||
+                         fwrite(&t, sizeof(Trailer), 1, file) != 1))
+        {
+            res = -1;
+        }
+        if (res < 0)
+        {
+            LOG_PERROR("Error writing the segment %s", temp_path);
+        }
+    }
+    free(bloom);
+    free(keys);
+    free(index_keys);
+    free(index_offsets);
+
+    // The segment only appears with its final name once it is complete on disk
+    if (fflush(file) != 0 || fsync(fileno(file)) != 0)
+    {
+        LOG_PERROR("Error writing the segment %s", temp_path);
+        res = -1;
+    }
+    fclose(file);
+    if (res < 0 || N_records == 0)
+    {
+        unlink(temp_path);
+        return res;
+    }
+    if (rename(temp_path, path) < 0)
+    {
+        LOG_PERROR("Error renaming the segment %s", temp_path);
+        unlink(temp_path);
+        return -1;
+    }
+    *segment = segment_open(path, level, id);
+    return *segment == NULL ? -1 : 0;
+}
+
+static long level_max_bytes(int level)
+{
+    long max_bytes = LSM_LEVEL_BASE;
+    for (int i = 1; i < level; i++)
+    {
+        max_bytes *= 10;
+    }
+    return max_bytes;
+}
+
+static int compaction_level()
+{
+    // Return the level that has to be merged with the next one, or -1 if none (with mutex_lsm)
+    if (N_level0 >= L0_COMPACTION)
+    {
+        return 0;
+    }
+    for (int i = 1; i < LSM_LEVELS - 1; i++)
+    {
+        if (levels[i] != NULL && levels[i]->file_size > level_max_bytes(i))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void flush_immutable()
+{
+    // Write the immutable memtable to a new segment of level 0 and delete its log
+    Iterador *it = malloc(sizeof(Iterador));
+    Segmento *segment = NULL;
+    int res = -1;
+    if (it != NULL)
+    {
+        it->N_sources = 0;
+        iterator_add(it, immutable, NULL, INT_MIN);
+        res = write_segment(0, it, 0, &segment);
+        iterator_close(it);
+        free(it);
+    }
+    if (res < 0)
+    {
+        // Keep the memtable (and its log) and try again later
+        LOG_ERROR("Error writing the memtable to level 0");
+        sleep(1);
+        return;
+    }
+
+    pthread_mutex_lock(&mutex_lsm);
+    pthread_rwlock_wrlock(&lock_segments);
+    if (segment != NULL)
+    {
+        memmove(level0 + 1, level0, N_level0 * sizeof(Segmento *));
+        level0[0] = segment;
+        N_level0++;
+    }
+    immutable->N = 0;
+    immutable = NULL;
+    flushes++;
+    pthread_rwlock_unlock(&lock_segments);
+    pthread_mutex_unlock(&mutex_lsm);
+
+    char path[PATH_MAX];
+    path_of(path, WAL_IMMUTABLE_NAME);
+    unlink(path);
+}
+
+static void compact(int level)
+{
+    // Merge the segments of the level with the one of the next level (only this thread changes them)
+    Segmento *inputs[L0_MAX + 1];
+    int N_inputs = 0;
+    if (level == 0)
+    {
+        memcpy(inputs, level0, N_level0 * sizeof(Segmento *));
+        N_inputs = N_level0;
+    }
+    else
+    {
+        inputs[N_inputs++] = levels[level];
+    }
+    if (levels[level + 1] != NULL)
+    {
+        inputs[N_inputs++] = levels[level + 1];
+    }
+
+    // The deletions are only needed while there are older versions below
+    int bottom = 1;
+    for (int i = level + 2; i < LSM_LEVELS; i++)
+    {
+        if (levels[i] != NULL) { bottom = 0; }
+    }
+
+    Iterador *it = malloc(sizeof(Iterador));
+    Segmento *segment = NULL;
+    int res = -1;
+    if (it != NULL)
+    {
+        it->N_sources = 0;
+        res = iterator_open_segments(it, inputs, N_inputs, INT_MIN);
+        if (res == 0)
+        {
+            res = write_segment(level + 1, it, bottom, &segment);
+            iterator_close(it);
+        }
+        free(it);
+    }
+    if (res < 0)
+    {
+        LOG_ERROR("Error compacting the level %d", level);
+        sleep(1);
+        return;
+    }
+
+    pthread_mutex_lock(&mutex_lsm);
+    pthread_rwlock_wrlock(&lock_segments);
+    if (level == 0)
+    {
+        // Only the segments merged are removed (none can have been added meanwhile: this thread adds them)
+        N_level0 = 0;
+    }
+    else
+    {
+        levels[level] = NULL;
+    }
+    levels[level + 1] = segment;
+    compactions++;
+    compaction_bytes += segment != NULL ? segment->file_size : 0;
+    pthread_rwlock_unlock(&lock_segments);
+    pthread_mutex_unlock(&mutex_lsm);
+
+    for (int i = 0; i < N_inputs; i++)
+    {
+        unlink(inputs[i]->path);
+        segment_free(inputs[i]);
+    }
+}
+
+static void *run_compaction(void *arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&mutex_lsm);
+    while (1)
+    {
+        int level;
+        while (!stopping && (paused || (immutable == NULL && (level = compaction_level()) < 0)))
+        {
+            pthread_cond_wait(&cond_work, &mutex_lsm);
+        }
+        if (stopping)
+        {
+            break;
+        }
+        busy = 1;
+        int flush = immutable != NULL;
+        pthread_mutex_unlock(&mutex_lsm);
+
+        // The memtables go first so that the writes do not wait behind a long compaction
+        if (flush)
+        {
+            flush_immutable();
+        }
+        else
+        {
+            compact(level);
+        }
+
+        pthread_mutex_lock(&mutex_lsm);
+        busy = 0;
+        pthread_cond_broadcast(&cond_idle);
+    }
+    pthread_mutex_unlock(&mutex_lsm);
+    return NULL;
+}
+
+
+// Log of the writes that are only in the memtables
+
+static int wal_open()
+{
+    char path[PATH_MAX];
+    path_of(path, WAL_NAME);
+    wal = fopen(path, "a");
+    if (wal == NULL)
+    {
+        LOG_PERROR("Error opening the log %s", path);
+        return -1;
+    }
+    return 0;
+}
+
+static int flush_memtable()
+{
+    // Write the memtable to a new segment of level 0 from the calling thread (while opening the store)
+    Iterador *it = malloc(sizeof(Iterador));
+    Segmento *segment = NULL;
+    if (it == NULL)
+    {
+        LOG_PERROR("Error allocating memory");
+        return -1;
+    }
+    it->N_sources = 0;
+    iterator_add(it, memtable, NULL, INT_MIN);
+    int res = write_segment(0, it, 0, &segment);
+    iterator_close(it);
+    free(it);
+    if (res < 0 || N_level0 == L0_MAX)
+    {
+        segment_free(segment);
+        return -1;
+    }
+    if (segment != NULL)
+    {
+        memmove(level0 + 1, level0, N_level0 * sizeof(Segmento *));
+        level0[0] = segment;
+        N_level0++;
+    }
+    memtable->N = 0;
+    return 0;
+}
+
+static int wal_replay(const char *name)
+{
+    // Write the entries of the log to level 0 (the last one may be incomplete after a crash)
+    char path[PATH_MAX];
+    path_of(path, name);
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        return errno == ENOENT ? 0 : -1;
+    }
+    unsigned char buffer[MAX_RECORD];
+    int len = 0;
+    int res = 0;
+    Entrada e;
+    while (res == 0)
+    {
+        len += fread(buffer + len, 1, sizeof(buffer) - len, file);
+        int n = decode(buffer, len, &e);
+        if (n <= 0)
+        {
+            if (n < 0 || len > 0)
+            {
+                LOG_WARN("Ignoring the end of the log %s", path);
+            }
+            break;
+        }
+        if (memtable->N == MEMTABLE_MAX && memtable_find(memtable, e.key) < 0)
+        {
+            res = flush_memtable();
+        }
+        memtable_put(memtable, &e);
+        memmove(buffer, buffer + n, len - n);
+        len -= n;
+    }
+    fclose(file);
+    if (res == 0 && memtable->N > 0)
+    {
+        res = flush_memtable();
+    }
+    return res;
+}
+
+static int write_entry(const Entrada *e)
+{
+    // Log the entry and add it to the memtable; rotate the memtable when it is full
+    unsigned char record[MAX_RECORD];
+    int n = encode(e, record);
+    if (fwrite(record, 1, n, wal) != (size_t)n || fflush(wal) != 0)
+    {
+        LOG_PERROR("Error writing to the log");
+        return -1;
+    }
+    memtable_put(memtable, e);
+    if (memtable->N < MEMTABLE_MAX)
+    {
+        return 0;
+    }
+
+    // Wait until the previous memtable is on disk (and level 0 is not too big), and swap them
+    pthread_mutex_lock(&mutex_lsm);
+    while (immutable != NULL || N_level0 >= L0_STALL)
+    {
+        pthread_cond_wait(&cond_idle, &mutex_lsm);
+    }
+    char path[PATH_MAX], immutable_path[PATH_MAX];
+    path_of(path, WAL_NAME);
+    path_of(immutable_path, WAL_IMMUTABLE_NAME);
+    fclose(wal);
+    int res = rename(path, immutable_path);
+    if (res < 0)
+    {
+        LOG_PERROR("Error renaming the log");
+    }
+    pthread_rwlock_wrlock(&lock_segments);
+    immutable = memtable;
+    memtable = memtable == &tables[0] ? &tables[1] : &tables[0];
+    pthread_rwlock_unlock(&lock_segments);
+    if (wal_open() < 0)
+    {
+        res = -1;
+    }
+    pthread_cond_signal(&cond_work);
+    pthread_mutex_unlock(&mutex_lsm);
+    return res;
+}
+
+static int lookup(int key, Entrada *e)
+{
+    // Find the newest version of the key: return 1 if it exists, 0 if not (or deleted) and -1 on error
+    pthread_rwlock_rdlock(&lock_segments);
+    int res = 0;
+    int pos = memtable_find(memtable, key);
+    if (pos >= 0)
+    {
+        *e = memtable->entries[memtable->order[pos]];
+        res = 1;
+    }
+    else if (immutable != NULL && (pos = memtable_find(immutable, key)) >= 0)
+    {
+        *e = immutable->entries[immutable->order[pos]];
+        res = 1;
+    }
+    for (int i = 0; res == 0 && i < N_level0; i++)
+    {
+        res = segment_get(level0[i], key, e);
+    }
+    for (int i = 1; res == 0 && i < LSM_LEVELS; i++)
+    {
+        if (levels[i] != NULL)
+        {
+            res = segment_get(levels[i], key, e);
+        }
+    }
+    pthread_rwlock_unlock(&lock_segments);
+    return res == 1 && e->deleted ? 0 : res;
+}
+
+
+int lsm_open(const char *dir)
+{
+    if (opened)
+    {
+        return -1;
+    }
+    if (strlen(dir) >= PATH_MAX - 64)
+    {
+        return -1;
+    }
+    snprintf(lsm_dir, PATH_MAX, "%s", dir);
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST)
+    {
+        LOG_PERROR("Error creating the directory %s", dir);
+        return -1;
+    }
+
+    // Load the segments: all the ones of level 0 and the newest of each other level (the older ones and
+    // the temporary files are what a compaction interrupted by a crash leaves behind)
+    DIR *directory = opendir(dir);
+    if (directory == NULL)
+    {
+        LOG_PERROR("Error opening the directory %s", dir);
+        return -1;
+    }
+    struct dirent *entry;
+    unsigned long level_ids[LSM_LEVELS] = {0};
+    while ((entry = readdir(directory)) != NULL)
+    {
+        int level, len = 0;
+        unsigned long id;
+        char path[PATH_MAX];
+        path_of(path, entry->d_name);
+        if (sscanf(entry->d_name, "L%d-%lu.seg%n", &level, &id, &len) != 2 || level < 0 || level >= LSM_LEVELS)
+        {
+            continue;
+        }
+        if (entry->d_name[len] != '\0')
+        {
+            unlink(path);
+            continue;
+        }
+        if (id >= next_id) { next_id = id + 1; }
+        if (level > 0 && id > level_ids[level]) { level_ids[level] = id; }
+        if (level == 0 && N_level0 < L0_MAX)
+        {
+            Segmento *s = segment_open(path, 0, id);
+            if (s == NULL)
+            {
+                closedir(directory);
+                return -1;
+            }
+            // Keep level 0 sorted from the newest to the oldest
+            int i = N_level0++;
+            for (; i > 0 && level0[i - 1]->id < id; i--)
+            {
+                level0[i] = level0[i - 1];
+            }
+            level0[i] = s;
+        }
+    }
+    rewinddir(directory);
+    while ((entry = readdir(directory)) != NULL)
+    {
+        int level;
+        unsigned long id;
+        char path[PATH_MAX];
+        path_of(path, entry->d_name);
+        if (sscanf(entry->d_name, "L%d-%lu.seg", &level, &id) != 2 || level < 1 || level >= LSM_LEVELS)
+        {
+            continue;
+        }
+        if (id != level_ids[level])
+        {
+            unlink(path);
+        }
+        else if ((levels[level] = segment_open(path, level, id)) == NULL)
+        {
+            closedir(directory);
+            return -1;
+        }
+    }
+    closedir(directory);
+
+    // Recover the writes that were only in the memtables and write them to level 0
+    if (wal_replay(WAL_IMMUTABLE_NAME) < 0 || wal_replay(WAL_NAME) < 0)
+    {
+        LOG_ERROR("Error recovering the log");
+        return -1;
+    }
+    char path[PATH_MAX];
+    path_of(path, WAL_IMMUTABLE_NAME);
+    unlink(path);
+    path_of(path, WAL_NAME);
+    unlink(path);
+    if (wal_open() < 0)
+    {
+        return -1;
+    }
+
+    if (pthread_create(&compaction_thread, NULL, run_compaction, NULL) != 0)
+    {
+        LOG_PERROR("Error creating the compaction thread");
+        return -1;
+    }
+    path_of(path, INIT_NAME);
+    initialized = access(path, F_OK) == 0;
+    opened = 1;
+    return 0;
+}
+
+void lsm_close()
+{
+    if (!opened)
+    {
+        return;
+    }
+
+    // Let the compaction thread finish its task and exit (a memtable not yet written stays in its log)
+    pthread_mutex_lock(&mutex_lsm);
+    stopping = 1;
+    pthread_cond_signal(&cond_work);
+    pthread_mutex_unlock(&mutex_lsm);
+    pthread_join(compaction_thread, NULL);
+    stopping = 0;
+
+    for (int i = 0; i < N_level0; i++)
+    {
+        segment_free(level0[i]);
+    }
+    N_level0 = 0;
+    for (int i = 1; i < LSM_LEVELS; i++)
+    {
+        segment_free(levels[i]);
+        levels[i] = NULL;
+    }
+    tables[0].N = tables[1].N = 0;
+    memtable = &tables[0];
+    immutable = NULL;
+    fclose(wal);
+    wal = NULL;
+    opened = initialized = 0;
+}
+
+int lsm_init()
+{
+    if (!opened)
+    {
+        return -1;
+    }
+
+    // Stop the compaction thread and delete every segment and the log
+    pthread_mutex_lock(&mutex_lsm);
+    paused = 1;
+    while (busy)
+    {
+        pthread_cond_wait(&cond_idle, &mutex_lsm);
+    }
+    pthread_rwlock_wrlock(&lock_segments);
+    for (int i = 0; i < N_level0; i++)
+    {
+        unlink(level0[i]->path);
+        segment_free(level0[i]);
+    }
+    N_level0 = 0;
+    for (int i = 1; i < LSM_LEVELS; i++)
+    {
+        if (levels[i] != NULL)
+        {
+            unlink(levels[i]->path);
+            segment_free(levels[i]);
+            levels[i] = NULL;
+        }
+    }
+    tables[0].N = tables[1].N = 0;
+    immutable = NULL;
+    pthread_rwlock_unlock(&lock_segments);
+
+    char path[PATH_MAX];
+    path_of(path, WAL_IMMUTABLE_NAME);
+    unlink(path);
+    fclose(wal);
+    path_of(path, WAL_NAME);
+    wal = fopen(path, "w");
+    paused = 0;
+    pthread_cond_broadcast(&cond_idle);
+    pthread_mutex_unlock(&mutex_lsm);
+    if (wal == NULL)
+    {
+        LOG_PERROR("Error creating the log %s", path);
+        return -1;
+    }
+
+    path_of(path, INIT_NAME);
+    int fd = open(path, O_WRONLY | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        LOG_PERROR("Error creating the file %s", path);
+        return -1;
+    }
+    close(fd);
+    initialized = 1;
+    return 0;
+}
+
+static int check_tuple(char *value1, int N_value2, double *V_value2)
+{
+    if (N_value2 < 1 || N_value2 > 32)
+    {
+        LOG_DEBUG("N_value2 must be between 1 and 32");
+        return -1;
+    }
+    if (value1 == NULL || V_value2 == NULL || strlen(value1) > 255)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+static int put_tuple(int key, char *value1, int N_value2, double *V_value2)
+{
+    Entrada e;
+    e.key = key;
+    e.deleted = 0;
+    strcpy(e.value1, value1);
+    e.N_value2 = N_value2;
+    memcpy(e.V_value2, V_value2, N_value2 * sizeof(double));
+    return write_entry(&e);
+}
+
+int lsm_set_value(int key, char *value1, int N_value2, double *V_value2)
+{
+    if (!initialized || check_tuple(value1, N_value2, V_value2) < 0)
+    {
+        return -1;
+    }
+    int exist_value = lsm_exist(key);
+    if (exist_value != 0)
+    {
+        if (exist_value == 1)
+        {
+            LOG_DEBUG("The key %d already exists", key);
+        }
+        return -1;
+    }
+    return put_tuple(key, value1, N_value2, V_value2);
+}
+
+int lsm_get_value(int key, char *value1, int *N_value2, double *V_value2)
+{
+    Entrada e;
+    if (!initialized || lookup(key, &e) != 1)
+    {
+        return -1;
+    }
+    strcpy(value1, e.value1);
+    *N_value2 = e.N_value2;
+    memcpy(V_value2, e.V_value2, e.N_value2 * sizeof(double));
+    return 0;
+}
+
+int lsm_modify_value(int key, char *value1, int N_value2, double *V_value2)
+{
+    if (!initialized || check_tuple(value1, N_value2, V_value2) < 0 || lsm_exist(key) != 1)
+    {
+        return -1;
+    }
+    return put_tuple(key, value1, N_value2, V_value2);
+}
+
+int lsm_delete_key(int key)
+{
+    if (!initialized || lsm_exist(key) != 1)
+    {
+        return -1;
+    }
+    Entrada e;
+    e.key = key;
+    e.deleted = 1;
+    return write_entry(&e);
+}
+
+int lsm_exist(int key)
+{
+    Entrada e;
+    if (!initialized)
+    {
+        return -1;
+    }
+    return lookup(key, &e);
+}
+
+int lsm_scan_keys(int start_key, int end_key, int limit, int *keys)
+{
+    if (!initialized || limit < 1 || keys == NULL)
+    {
+        return -1;
+    }
+    if (start_key > end_key)
+    {
+        return 0;
+    }
+
+    Iterador *it = malloc(sizeof(Iterador));
+    if (it == NULL)
+    {
+        LOG_PERROR("Error allocating memory");
+        return -1;
+    }
+    pthread_rwlock_rdlock(&lock_segments);
+    int N_keys = iterator_open(it, start_key);
+    while (N_keys >= 0 && N_keys < limit && iterator_next(it) && it->current.key <= end_key)
+    {
+        if (!it->current.deleted)
+        {
+            keys[N_keys++] = it->current.key;
+        }
+    }
+    iterator_close(it);
+    pthread_rwlock_unlock(&lock_segments);
+    free(it);
+    return N_keys;
+}
+
+static Iterador *open_full_scan()
+{
+    // Start an iteration over all the tuples; lock_segments stays taken until close_full_scan()
+    Iterador *it = malloc(sizeof(Iterador));
+    if (it == NULL)
+    {
+        LOG_PERROR("Error allocating memory");
+        return NULL;
+    }
+    pthread_rwlock_rdlock(&lock_segments);
+    if (iterator_open(it, INT_MIN) < 0)
+    {
+        pthread_rwlock_unlock(&lock_segments);
+        free(it);
+        return NULL;
+    }
+    return it;
+}
+
+static void close_full_scan(Iterador *it)
+{
+    iterator_close(it);
+    pthread_rwlock_unlock(&lock_segments);
+    free(it);
+}
+
+static int append_key(int **keys, int *N_keys, int *capacity, int key)
+{
+    if (*N_keys == *capacity)
+    {
+        *capacity = *capacity == 0 ? 256 : 2 * *capacity;
+        int *new_keys = realloc(*keys, *capacity * sizeof(int));
+        if (new_keys == NULL)
+        {
+            LOG_PERROR("Error allocating memory");
+            return -1;
+        }
+        *keys = new_keys;
+    }
+    (*keys)[(*N_keys)++] = key;
+    return 0;
+}
+
+static void *scan_part(void *arg)
+{
+    // Aggregate or filter the V_value2 of the tuples of a range of keys (the caller holds lock_segments)
+    ScanPart *part = arg;
+    agregado_init(&part->agg);
+    Iterador *it = malloc(sizeof(Iterador));
+    if (it == NULL)
+    {
+        LOG_PERROR("Error allocating memory");
+        part->error = -1;
+        return NULL;
+    }
+    if (iterator_open(it, part->start_key) < 0)
+    {
+        free(it);
+        part->error = -1;
+        return NULL;
+    }
+    while (iterator_next(it) && it->current.key <= part->end_key)
+    {
+        Entrada *e = &it->current;
+        if (e->deleted || part->element >= e->N_value2)
+        {
+            continue;
+        }
+        const double *v = part->element >= 0 ? e->V_value2 + part->element : e->V_value2;
+        int n = part->element >= 0 ? 1 : e->N_value2;
+        if (part->cmp < 0)
+        {
+            agregado_vector(&part->agg, v, n);
+        }
+        else if (vector_any_match(v, n, part->cmp, part->threshold) &&
+                 append_key(&part->keys, &part->N_keys, &part->capacity, e->key) < 0)
+        {
+            part->error = -1;
+            break;
+        }
+    }
+    iterator_close(it);
+    free(it);
+    return NULL;
+}
+
+static int scan_parallel(ScanPart *parts, int element, int cmp, double threshold)
+{
+    // Split the keys in ranges with about the same number of records (at keys of the sparse index of the largest
+    // segment) that are scanned in parallel, each one with its own iterator; returns the number of parts
+    pthread_rwlock_rdlock(&lock_segments);
+    Segmento *largest = NULL;
+    for (int i = 0; i < N_level0 + LSM_LEVELS; i++)
+    {
+        Segmento *s = i < N_level0 ? level0[i] : levels[i - N_level0];
+        if (s != NULL && (largest == NULL || s->trailer.N_records > largest->trailer.N_records))
+        {
+            largest = s;
+        }
+    }
+
+    long N_records = largest != NULL ? largest->trailer.N_records : 0;
+    long N_index = largest != NULL ? largest->trailer.N_index : 0;
+    long n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n_threads > MAX_SCAN_THREADS) { n_threads = MAX_SCAN_THREADS; }
+    if (n_threads > N_records / MIN_RECORDS_PER_THREAD) { n_threads = N_records / MIN_RECORDS_PER_THREAD; }
+    if (n_threads > N_index) { n_threads = N_index; }     // So that the parts start at different keys
+    if (n_threads < 1) { n_threads = 1; }
+
+    for (int i = 0; i < n_threads; i++)
+    {
+        memset(&parts[i], 0, sizeof(ScanPart));
+        parts[i].start_key = i == 0 ? INT_MIN : largest->index_keys[N_index * i / n_threads];
+        parts[i].end_key = i == n_threads - 1 ? INT_MAX : largest->index_keys[N_index * (i + 1) / n_threads] - 1;
+        parts[i].element = element;
+        parts[i].cmp = cmp;
+        parts[i].threshold = threshold;
+    }
+
+    // The first part is scanned by the calling thread
+    pthread_t threads[MAX_SCAN_THREADS];
+    int created[MAX_SCAN_THREADS] = {0};
+    for (int i = 1; i < n_threads; i++)
+    {
+        created[i] = pthread_create(&threads[i], NULL, scan_part, &parts[i]) == 0;
+        if (!created[i])
+        {
+            scan_part(&parts[i]);
+        }
+    }
+    scan_part(&parts[0]);
+    for (int i = 1; i < n_threads; i++)
+    {
+        if (created[i])
+        {
+            pthread_join(threads[i], NULL);
+        }
+    }
+    pthread_rwlock_unlock(&lock_segments);
+    return n_threads;
+}
+
+int lsm_aggregate_values(int element, Agregado *agg)
+{
+    if (!initialized || element < -1 || element > 31 || agg == NULL)
+    {
+        return -1;
+    }
+    ScanPart parts[MAX_SCAN_THREADS];
+    int N_parts = scan_parallel(parts, element, -1, 0.0);
+    int res = 0;
+    agregado_init(agg);
+    for (int i = 0; i < N_parts; i++)
+    {
+        agregado_merge(agg, &parts[i].agg);
+        if (parts[i].error < 0) { res = -1; }
+    }
+    return res;
+}
+
+int lsm_filter_keys(int element, int cmp, double threshold, int **keys)
+{
+    if (!initialized || element < -1 || element > 31 || (cmp != FILTER_GREATER && cmp != FILTER_LESS) || keys == NULL)
+    {
+        return -1;
+    }
+    ScanPart parts[MAX_SCAN_THREADS];
+    int N_parts = scan_parallel(parts, element, cmp, threshold);
+
+    // Join the keys of all the parts (in the order of the keys)
+    int N_keys = 0;
+    int res = 0;
+    for (int i = 0; i < N_parts; i++)
+    {
+        N_keys += parts[i].N_keys;
+        if (parts[i].error < 0) { res = -1; }
+    }
+    *keys = res == 0 ? malloc((N_keys > 0 ? N_keys : 1) * sizeof(int)) : NULL;
+    if (*keys == NULL)
+    {
+        res = -1;
+    }
+    N_keys = 0;
+    for (int i = 0; i < N_parts; i++)
+    {
+        if (res == 0)
+        {
+            memcpy(*keys + N_keys, parts[i].keys, parts[i].N_keys * sizeof(int));
+            N_keys += parts[i].N_keys;
+        }
+        free(parts[i].keys);
+    }
+    return res == 0 ? N_keys : -1;
+}
+
+int lsm_knn_search(int k, int metric, int N_value2, double *V_value2, int *keys, double *distances)
+{
+    if (!initialized || k < 1 || k > KNN_MAX_K || (metric != KNN_L2 && metric != KNN_COSINE) || N_value2 < 1 ||
+        N_value2 > 32 || V_value2 == NULL || keys == NULL || distances == NULL)
+    {
+        return -1;
+    }
+    double query_norm = sqrt(indice_vectores_dot(V_value2, V_value2, N_value2));
+    if (metric == KNN_COSINE && query_norm == 0.0)
+    {
+        return 0;
+    }
+
+    Iterador *it = open_full_scan();
+    if (it == NULL)
+    {
+        return -1;
+    }
+    // Keep the k nearest sorted by distance (insertion sort, k is small)
+    int found = 0;
+    while (iterator_next(it))
+    {
+        Entrada *e = &it->current;
+        if (e->deleted || e->N_value2 != N_value2)
+        {
+            continue;
+        }
+        // Same SIMD kernels as the vector index of the other engines
+        double distance;
+        if (metric == KNN_L2)
+        {
+            distance = sqrt(indice_vectores_l2(e->V_value2, V_value2, N_value2));
+        }
+        else
+        {
+            double norm = indice_vectores_dot(e->V_value2, e->V_value2, N_value2);
+            if (norm == 0.0)
+            {
+                continue;
+            }
+            distance = 1.0 - indice_vectores_dot(e->V_value2, V_value2, N_value2) / (sqrt(norm) * query_norm);
+        }
+        if (found == k && distance >= distances[k - 1])
+        {
+            continue;
+        }
+        int i = found < k ? found++ : k - 1;
+        for (; i > 0 && distances[i - 1] > distance; i--)
+        {
+            distances[i] = distances[i - 1];
+            keys[i] = keys[i - 1];
+        }
+        distances[i] = distance;
+        keys[i] = e->key;
+    }
+    close_full_scan(it);
+    return found;
+}
+
+static int find_value1(char *value1, int exact, int limit, int **keys)
+{
+    Iterador *it = open_full_scan();
+    if (it == NULL)
+    {
+        return -1;
+    }
+    size_t len = strlen(value1);
+    int N_keys = 0, capacity = 0;
+    *keys = NULL;
+    while (N_keys >= 0 && N_keys < limit && iterator_next(it))
+    {
+        Entrada *e = &it->current;
+        if (e->deleted || (exact ? strcmp(e->value1, value1) != 0 : strncmp(e->value1, value1, len) != 0))
+        {
+            continue;
+        }
+        if (append_key(keys, &N_keys, &capacity, e->key) < 0)
+        {
+            N_keys = -1;
+        }
+    }
+    close_full_scan(it);
+    if (N_keys < 0)
+    {
+        free(*keys);
+        *keys = NULL;
+    }
+    return N_keys;
+}
+
+int lsm_get_by_value1(char *value1, int **keys)
+{
+    if (!initialized || value1 == NULL || value1[0] == '\0' || keys == NULL)
+    {
+        return -1;
+    }
+    return find_value1(value1, 1, INT_MAX, keys);
+}
+
+int lsm_prefix_value1(char *prefix, int limit, int **keys)
+{
+    if (!initialized || prefix == NULL || prefix[0] == '\0' || limit < 1 || keys == NULL)
+    {
+        return -1;
+    }
+    return find_value1(prefix, 0, limit, keys);
+}
+
+void lsm_stats(EstadisticasLsm *stats)
+{
+    memset(stats, 0, sizeof(EstadisticasLsm));
+    pthread_mutex_lock(&mutex_lsm);
+    pthread_rwlock_rdlock(&lock_segments);
+    stats->memtable = memtable->N + (immutable != NULL ? immutable->N : 0);
+    stats->segments[0] = N_level0;
+    for (int i = 0; i < N_level0; i++)
+    {
+        stats->bytes[0] += level0[i]->file_size;
+    }
+    for (int i = 1; i < LSM_LEVELS; i++)
+    {
+        if (levels[i] != NULL)
+        {
+            stats->segments[i] = 1;
+            stats->bytes[i] = levels[i]->file_size;
+        }
+    }
+    stats->flushes = flushes;
+    stats->compactions = compactions;
+    stats->compaction_bytes = compaction_bytes;
+    pthread_rwlock_unlock(&lock_segments);
+    pthread_mutex_unlock(&mutex_lsm);
+}
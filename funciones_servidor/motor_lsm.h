@@ -0,0 +1,199 @@
+#ifndef MOTOR_LSM_H
+#define MOTOR_LSM_H
+
+/*
+Storage engine based on a log-structured merge tree, an alternative to the text file (FILE_NAME) of
+funciones_servidor.c for write-heavy workloads. It offers the same services with the same results.
+The writes go to a log (wal.log) and to a sorted table in memory (memtable). When the memtable is full it
+is written by a background thread as an immutable segment file sorted by key, with a Bloom filter and a
+sparse index, in level 0. The same thread merges the segments of level 0 with level 1, and each level i
+with level i + 1 when it grows over 10^(i - 1) * LSM_LEVEL_BASE bytes (leveled compaction), dropping the
+old versions and, in the last level, the deleted keys.
+All the files are kept in the directory given to lsm_open(). Until lsm_init() has been called once in it, every
+operation fails (like the text file before init()).
+The writes (lsm_init, lsm_set_value, lsm_modify_value, lsm_delete_key) are not thread-safe: the caller
+must serialize them with respect to every other call. The rest of the functions can run at the same time
+as each other (and as the background thread).
+*/
+
+#include "agregados.h"
+
+#define LSM_DIR "tuplas_lsm"                // Default directory of the storage
+#define LSM_LEVELS 7                        // Levels 0 .. LSM_LEVELS - 1
+#define LSM_LEVEL_BASE (8L * 1024 * 1024)   // Maximum size of level 1 (bytes)
+
+typedef struct {
+    long memtable;                  /* Tuples (and deletions) in the memtables */
+    long segments[LSM_LEVELS];      /* Segment files of each level */
+    long bytes[LSM_LEVELS];         /* Size of the segment files of each level */
+    long flushes;                   /* Memtables written to level 0 */
+    long compactions;               /* Compactions done */
+    long compaction_bytes;          /* Bytes written by the compactions */
+} EstadisticasLsm;
+
+/**
+ * @brief Abre (o crea) el almacenamiento en el directorio dir, recupera las escrituras del log que no se
+ * habían guardado en segmentos y arranca el hilo de compactación.
+ * 
+ * @param dir directorio del almacenamiento.
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ * @retval 0 en caso de éxito.
+ * @retval -1 en caso de error.
+ */
+int lsm_open(const char *dir);
+
+/**
+ * @brief Detiene el hilo de compactación y cierra el almacenamiento. Las tuplas se conservan en el
+ * directorio y se recuperan en el siguiente lsm_open().
+ */
+void lsm_close();
+
+/**
+ * @brief Elimina todas las tuplas almacenadas (como init()).
+ * 
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ * @retval 0 en caso de éxito.
+ * @retval -1 en caso de error.
+ */
+int lsm_init();
+
+/**
+ * @brief Inserta la tupla <key, value1, value2> (como set_value()). Es un error que la clave ya exista.
+ * 
+ * @param key clave.
+ * @param value1 valor1 [256].
+ * @param N_value2 dimensión del vector V_value2 [1-32].
+ * @param V_value2 vector de doubles [32].
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ * @retval 0 en caso de éxito.
+ * @retval -1 en caso de error.
+ */
+int lsm_set_value(int key, char *value1, int N_value2, double *V_value2);
+
+/**
+ * @brief Obtiene los valores asociados a la clave key (como get_value()).
+ * 
+ * @param key clave.
+ * @param value1 cadena donde se copia value1 [256].
+ * @param N_value2 puntero donde se guarda la dimensión del vector.
+ * @param V_value2 vector donde se copian los doubles [32].
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error (o si la clave no existe).
+ * @retval 0 en caso de éxito.
+ * @retval -1 en caso de error.
+ */
+int lsm_get_value(int key, char *value1, int *N_value2, double *V_value2);
+
+/**
+ * @brief Modifica los valores asociados a la clave key (como modify_value()). Es un error que la clave no
+ * exista.
+ * 
+ * @param key clave.
+ * @param value1 valor1 [256].
+ * @param N_value2 dimensión del vector V_value2 [1-32].
+ * @param V_value2 vector de doubles [32].
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ * @retval 0 en caso de éxito.
+ * @retval -1 en caso de error.
+ */
+int lsm_modify_value(int key, char *value1, int N_value2, double *V_value2);
+
+/**
+ * @brief Borra la tupla de la clave key (como delete_key()). Es un error que la clave no exista.
+ * 
+ * @param key clave.
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ * @retval 0 en caso de éxito.
+ * @retval -1 en caso de error.
+ */
+int lsm_delete_key(int key);
+
+/**
+ * @brief Determina si existe una tupla con clave key (como exist()).
+ * 
+ * @param key clave.
+ * @return int La función devuelve 1 si la clave existe, 0 si no existe y -1 en caso de error.
+ */
+int lsm_exist(int key);
+
+/**
+ * @brief Copia en keys, en orden ascendente, las claves que están en el rango [start_key, end_key], hasta
+ * un máximo de limit claves (como scan_keys()).
+ * 
+ * @param start_key primera clave del rango (incluida).
+ * @param end_key última clave del rango (incluida).
+ * @param limit número máximo de claves a copiar [>= 1].
+ * @param keys vector donde se copian las claves [limit].
+ * @return int La función devuelve el número de claves copiadas. En caso de error se devuelve -1.
+ */
+int lsm_scan_keys(int start_key, int end_key, int limit, int *keys);
+
+/**
+ * @brief Calcula el número de elementos, la suma, el mínimo y el máximo de los V_value2 almacenados
+ * (como aggregate_values()).
+ * 
+ * @param element elemento de V_value2 a considerar, -1 para todos [-1-31].
+ * @param agg agregado donde se guarda el resultado.
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ * @retval 0 en caso de éxito.
+ * @retval -1 en caso de error.
+ */
+int lsm_aggregate_values(int element, Agregado *agg);
+
+/**
+ * @brief Obtiene las claves de las tuplas en las que algún elemento de V_value2 (o el elemento element)
+ * cumple el predicado cmp respecto a threshold (como filter_keys()). El vector de claves se reserva con
+ * malloc y lo debe liberar quien llama a la función.
+ * 
+ * @param element elemento de V_value2 a considerar, -1 para todos [-1-31].
+ * @param cmp predicado (FILTER_GREATER o FILTER_LESS).
+ * @param threshold umbral.
+ * @param keys puntero donde se devuelve el vector de claves.
+ * @return int La función devuelve el número de claves encontradas. En caso de error se devuelve -1.
+ */
+int lsm_filter_keys(int element, int cmp, double threshold, int **keys);
+
+/**
+ * @brief Busca las k tuplas cuyo vector V_value2 (de dimensión N_value2) está más cerca de V_value2 según
+ * la métrica metric (como knn_search()).
+ * 
+ * @param k número de vecinos a buscar [1-KNN_MAX_K].
+ * @param metric métrica (KNN_L2 o KNN_COSINE).
+ * @param N_value2 dimensión del vector de consulta [1-32].
+ * @param V_value2 vector de consulta.
+ * @param keys vector donde se copian las claves [k].
+ * @param distances vector donde se copian las distancias [k].
+ * @return int La función devuelve el número de vecinos encontrados. En caso de error se devuelve -1.
+ */
+int lsm_knn_search(int k, int metric, int N_value2, double *V_value2, int *keys, double *distances);
+
+/**
+ * @brief Obtiene las claves de las tuplas cuyo value1 es igual a value1, en orden ascendente (como
+ * get_by_value1()). El vector de claves se reserva con malloc y lo debe liberar quien llama a la función.
+ * 
+ * @param value1 valor1 a buscar [256].
+ * @param keys puntero donde se devuelve el vector de claves.
+ * @return int La función devuelve el número de claves encontradas. En caso de error se devuelve -1.
+ */
+int lsm_get_by_value1(char *value1, int **keys);
+
+/**
+ * @brief Obtiene las claves de las tuplas cuyo value1 empieza por prefix, como mucho limit claves, en orden
+ * ascendente (como prefix_value1()). El vector de claves se reserva con malloc y lo debe liberar quien llama
+ * a la función.
+ * 
+ * @param prefix prefijo a buscar [256].
+ * @param limit número máximo de claves a obtener [>= 1].
+ * @param keys puntero donde se devuelve el vector de claves.
+ * @return int La función devuelve el número de claves encontradas. En caso de error se devuelve -1.
+ */
+int lsm_prefix_value1(char *prefix, int limit, int **keys);
+
+/**
+ * @brief Copia en stats el número de tuplas en memoria, los segmentos y bytes de cada nivel y los
+ * contadores de volcados y compactaciones.
+ * 
+ * @param stats estructura donde se copian los datos.
+ */
+void lsm_stats(EstadisticasLsm *stats);
+
+#endif
@@ -0,0 +1,398 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "motor_memoria.h"
+#include "funciones_servidor.h"
+#include "indice_claves.h"
+#include "indice_tuplas.h"
+#include "indice_vectores.h"
+#include "indice_value1.h"
+#include "../funciones_log/funciones_log.h"
+
+#define ITERATION_CHUNK 1024    // Keys read from the index at a time when all the tuples are visited
+#define MAX_VISIT_THREADS 16    // Maximum number of threads used to visit the tuples
+#define MIN_KEYS_PER_THREAD 4096    // Fewer keys are not worth splitting
+
+static int initialized = 0;     // 1 once init() has been called: before it every operation fails, like without FILE_NAME
+static IndiceClaves key_index = INDICE_CLAVES_INIT;    // Keys stored, in order
+
+
+static void clear_indexes()
+{
+    indice_claves_clear(&key_index);
+    indice_tuplas_clear();
+    indice_vectores_clear();
+    indice_value1_clear();
+}
+
+static int memoria_open(const char *path)
+{
+    (void)path;
+    // Every tuple has to stay in memory: there is no file to evict them to (the server and the benchmark reject a
+    // tuple cache budget with this engine)
+    indice_tuplas_set_max_memory(0);
+    clear_indexes();
+    initialized = 0;
+    return 0;
+}
+
+static void memoria_close()
+{
+    clear_indexes();
+    initialized = 0;
+}
+
+static int memoria_init()
+{
+    clear_indexes();
+    initialized = 1;
+    return 0;
+}
+
+static int check_tuple(char *value1, int N_value2)
+{
+    if (N_value2 < 1 || N_value2 > 32)
+    {
+        LOG_DEBUG("N_value2 must be between 1 and 32");
+        return -1;
+    }
+    return value1 != NULL && strlen(value1) < 256 ? 0 : -1;
+}
+
+static int memoria_exist(int key)
+{
+    return initialized ? indice_tuplas_exists(key) : -1;
+}
+
+static int memoria_set_value(int key, char *value1, int N_value2, double *V_value2)
+{
+    if (check_tuple(value1, N_value2) < 0 || memoria_exist(key) != 0)
+    {
+        return -1;
+    }
+    if (indice_claves_insert(&key_index, key) == NULL || indice_tuplas_insert(key, value1, N_value2, V_value2, 0) < 0 ||
+        indice_vectores_insert(key, N_value2, V_value2) < 0 || indice_value1_insert(value1, key) < 0)
+    {
+        // Undo the part that was inserted
+        LOG_ERROR("Error inserting the key %d in the indexes", key);
+        indice_claves_remove(&key_index, key);
+        indice_tuplas_remove(key);
+        indice_vectores_remove(key);
+        indice_value1_remove(value1, key);
+        return -1;
+    }
+    return 0;
+}
+
+static int memoria_get_value(int key, char *value1, int *N_value2, double *V_value2)
+{
+    long offset;
+    return initialized && indice_tuplas_get(key, value1, N_value2, V_value2, &offset) == 0 ? 0 : -1;
+}
+
+static int memoria_modify_value(int key, char *value1, int N_value2, double *V_value2)
+{
+    char old_value1[256];
+    int old_N_value2;
+    double old_V_value2[32];
+    if (check_tuple(value1, N_value2) < 0 || memoria_get_value(key, old_value1, &old_N_value2, old_V_value2) < 0)
+    {
+        return -1;
+    }
+    if (indice_tuplas_insert(key, value1, N_value2, V_value2, 0) < 0 || indice_vectores_insert(key, N_value2, V_value2) < 0)
+    {
+        indice_tuplas_insert(key, old_value1, old_N_value2, old_V_value2, 0);
+        indice_vectores_insert(key, old_N_value2, old_V_value2);
+        return -1;
+    }
+    indice_value1_remove(old_value1, key);
+    if (indice_value1_insert(value1, key) < 0)
+    {
+        LOG_ERROR("Error inserting the key %d in the index of value1", key);
+        return -1;
+    }
+    return 0;
+}
+
+static int memoria_delete_key(int key)
+{
+    char value1[256];
+    int N_value2;
+    double V_value2[32];
+    if (memoria_get_value(key, value1, &N_value2, V_value2) < 0)
+    {
+        return -1;
+    }
+    indice_claves_remove(&key_index, key);
+    indice_tuplas_remove(key);
+    indice_vectores_remove(key);
+    indice_value1_remove(value1, key);
+    return 0;
+}
+
+static int memoria_scan_keys(int start_key, int end_key, int limit, int *keys)
+{
+    if (!initialized || limit < 1 || keys == NULL)
+    {
+        return -1;
+    }
+    return start_key > end_key ? 0 : indice_claves_scan(&key_index, start_key, end_key, limit, keys);
+}
+
+typedef struct {
+    const int *keys;        /* Keys of the part */
+    int N;                  /* Number of keys of the part */
+    int element;            /* Element of V_value2 to consider, -1 for all of them */
+    int cmp;                /* Predicate of the filter (FILTER_GREATER or FILTER_LESS), -1 to aggregate */
+    double threshold;       /* Threshold of the filter */
+    Agregado agg;           /* Partial aggregate of the part */
+    int *found;             /* Keys that match the filter in the part */
+    int N_found;            /* Number of keys in found */
+    int capacity;           /* Capacity of found */
+    int error;              /* -1 if there has been an error */
+} VisitPart;
+
+static int all_keys(int **keys)
+{
+    // Copy all the keys, in order, to a vector allocated with malloc; returns the number of keys
+    int N_keys = 0, capacity = ITERATION_CHUNK;
+    *keys = malloc(capacity * sizeof(int));
+    int start_key = INT_MIN;
+    while (*keys != NULL)
+    {
+        int n = indice_claves_scan(&key_index, start_key, INT_MAX, ITERATION_CHUNK, *keys + N_keys);
+        N_keys += n;
+        if (n < ITERATION_CHUNK || (*keys)[N_keys - 1] == INT_MAX)
+        {
+            return N_keys;
+        }
+        start_key = (*keys)[N_keys - 1] + 1;
+        if (N_keys + ITERATION_CHUNK > capacity)
+        {
+            capacity *= 2;
+            int *new_keys = realloc(*keys, capacity * sizeof(int));
+            if (new_keys == NULL)
+            {
+                free(*keys);
+            }
+            *keys = new_keys;
+        }
+    }
+    LOG_PERROR("Error allocating memory");
+    return -1;
+}
+
+static void *visit_part(void *arg)
+{
+    // Aggregate or filter the V_value2 of the tuples of a part of the keys
+    VisitPart *part = arg;
+    char value1[256];
+    int N_value2;
+    double V_value2[32];
+
+    agregado_init(&part->agg);
+    for (int i = 0; i < part->N; i++)
+    {
+        if (memoria_get_value(part->keys[i], value1, &N_value2, V_value2) < 0 || part->element >= N_value2)
+        {
+            continue;
+        }
+        const double *v = part->element >= 0 ? V_value2 + part->element : V_value2;
+        int n = part->element >= 0 ? 1 : N_value2;
+        if (part->cmp < 0)
+        {
+            agregado_vector(&part->agg, v, n);
+            continue;
+        }
+        if (!vector_any_match(v, n, part->cmp, part->threshold))
+        {
+            continue;
+        }
+        if (part->N_found == part->capacity)
+        {
+            int capacity = part->capacity == 0 ? 256 : 2 * part->capacity;
+            int *found = realloc(part->found, capacity * sizeof(int));
+            if (found == NULL)
+            {
+                part->error = -1;
+                return NULL;
+            }
+            part->found = found;
+            part->capacity = capacity;
+        }
+        part->found[part->N_found++] = part->keys[i];
+    }
+    return NULL;
+}
+
+static int visit_tuples(int element, int cmp, double threshold, Agregado *agg, int **keys)
+{
+    // Aggregate (cmp < 0) or filter the V_value2 of all the tuples, in the order of the keys: the keys are split in
+    // parts that are visited in parallel (the tuples are only read, like in the GET_VALUE that run at the same time)
+    int *all;
+    int N_all = all_keys(&all);
+    if (N_all < 0)
+    {
+        return -1;
+    }
+
+    long n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n_threads < 1) { n_threads = 1; }
+    if (n_threads > MAX_VISIT_THREADS) { n_threads = MAX_VISIT_THREADS; }
+    if (n_threads > N_all / MIN_KEYS_PER_THREAD) { n_threads = N_all / MIN_KEYS_PER_THREAD; }
+    if (n_threads < 1) { n_threads = 1; }
+
+    VisitPart parts[MAX_VISIT_THREADS];
+    for (int i = 0; i < n_threads; i++)
+    {
+        int start = (long)N_all * i / n_threads;
+        int end = (long)N_all * (i + 1) / n_threads;
+        memset(&parts[i], 0, sizeof(VisitPart));
+        parts[i].keys = all + start;
+        parts[i].N = end - start;
+        parts[i].element = element;
+        parts[i].cmp = cmp;
+        parts[i].threshold = threshold;
+    }
+
+    // The first part is visited by the calling thread
+    pthread_t threads[MAX_VISIT_THREADS];
+    int created[MAX_VISIT_THREADS] = {0};
+    for (int i = 1; i < n_threads; i++)
+    {
+        created[i] = pthread_create(&threads[i], NULL, visit_part, &parts[i]) == 0;
+        if (!created[i])
+        {
+            visit_part(&parts[i]);
+        }
+    }
+    visit_part(&parts[0]);
+    for (int i = 1; i < n_threads; i++)
+    {
+        if (created[i])
+        {
+            pthread_join(threads[i], NULL);
+        }
+    }
+    free(all);
+
+    // Join the parts (the keys in the order of the parts)
+    int N_keys = 0;
+    int res = 0;
+    for (int i = 0; i < n_threads; i++)
+    {
+        if (cmp < 0)
+        {
+            agregado_merge(agg, &parts[i].agg);
+        }
+        N_keys += parts[i].N_found;
+        if (parts[i].error < 0) { res = -1; }
+    }
+    if (res == 0 && cmp >= 0 && (*keys = malloc((N_keys > 0 ? N_keys : 1) * sizeof(int))) == NULL)
+    {
+        LOG_PERROR("Error allocating memory");
+        res = -1;
+    }
+    N_keys = 0;
+    for (int i = 0; i < n_threads; i++)
+    {
+        if (res == 0 && cmp >= 0)
+        {
+            memcpy(*keys + N_keys, parts[i].found, parts[i].N_found * sizeof(int));
+            N_keys += parts[i].N_found;
+        }
+        free(parts[i].found);
+    }
+    return res == 0 ? N_keys : -1;
+}
+
+static int memoria_aggregate_values(int element, Agregado *agg)
+{
+    if (!initialized || element < -1 || element > 31 || agg == NULL)
+    {
+        return -1;
+    }
+    agregado_init(agg);
+    return visit_tuples(element, -1, 0.0, agg, NULL) < 0 ? -1 : 0;
+}
+
+static int memoria_filter_keys(int element, int cmp, double threshold, int **keys)
+{
+    if (!initialized || element < -1 || element > 31 || (cmp != FILTER_GREATER && cmp != FILTER_LESS) || keys == NULL)
+    {
+        return -1;
+    }
+    *keys = NULL;
+    return visit_tuples(element, cmp, threshold, NULL, keys);
+}
+
+static int memoria_knn_search(int k, int metric, int N_value2, double *V_value2, int *keys, double *distances)
+{
+    if (!initialized || k < 1 || k > KNN_MAX_K || (metric != KNN_L2 && metric != KNN_COSINE) || N_value2 < 1 ||
+        N_value2 > 32 || V_value2 == NULL || keys == NULL || distances == NULL)
+    {
+        return -1;
+    }
+    return indice_vectores_knn(k, metric, N_value2, V_value2, keys, distances);
+}
+
+static int find_value1(char *value1, int exact, int limit, int **keys)
+{
+    // Count only up to limit, so that a short prefix does not walk the rest of the index
+    int N_keys = indice_value1_count(value1, exact, limit);
+    *keys = malloc((N_keys > 0 ? N_keys : 1) * sizeof(int));
+    if (*keys == NULL)
+    {
+        LOG_PERROR("Error allocating memory");
+        return -1;
+    }
+    return indice_value1_find(value1, exact, N_keys, *keys);
+}
+
+static int memoria_get_by_value1(char *value1, int **keys)
+{
+    if (!initialized || value1 == NULL || value1[0] == '\0' || keys == NULL)
+    {
+        return -1;
+    }
+    return find_value1(value1, 1, INT_MAX, keys);
+}
+
+static int memoria_prefix_value1(char *prefix, int limit, int **keys)
+{
+    if (!initialized || prefix == NULL || prefix[0] == '\0' || limit < 1 || keys == NULL)
+    {
+        return -1;
+    }
+    return find_value1(prefix, 0, limit, keys);
+}
+
+static int memoria_shared_read(int op, int key)
+{
+    // The lookups never change the indexes
+    (void)op;
+    (void)key;
+    return 1;
+}
+
+static int memoria_stats(char *buffer, int size)
+{
+    NivelesTuplas tiers;
+    indice_tuplas_stats(&tiers);
+    int len = snprintf(buffer, size, "tuplas_storage_tuples{tier=\"memory\"} %ld\n"
+                       "tuplas_tuple_cache_bytes %ld\n", tiers.hot, tiers.hot_bytes);
+    return len < size ? len : size - 1;
+}
+
+const Motor motor_memoria = {
+    "memory", NULL,
+    memoria_open, memoria_close, memoria_init,
+    memoria_set_value, memoria_get_value, memoria_modify_value, memoria_delete_key, memoria_exist,
+    memoria_scan_keys, memoria_aggregate_values, memoria_filter_keys, memoria_knn_search,
+    memoria_get_by_value1, memoria_prefix_value1,
+    memoria_shared_read, memoria_stats
+};
@@ -0,0 +1,14 @@
+#ifndef MOTOR_MEMORIA_H
+#define MOTOR_MEMORIA_H
+
+/*
+Storage engine that keeps the tuples only in memory, in the same indexes that the text engine uses as a cache
+(keys, tuples, vectors and value1): nothing is written to disk, so the tuples are lost when the server stops.
+It gives the upper bound of the server without any I/O.
+*/
+
+#include "motor.h"
+
+extern const Motor motor_memoria;
+
+#endif
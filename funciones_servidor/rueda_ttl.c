@@ -0,0 +1,267 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "rueda_ttl.h"
+#include "tabla_enteros.h"
+
+#define LEVELS 4
+#define SLOT_BITS 6
+#define SLOTS (1 << SLOT_BITS)
+#define MAX_DELTA ((uint64_t)1 << (LEVELS * SLOT_BITS))    // Ticks covered by the wheel
+#define EXPIRED_LIST (LEVELS * SLOTS)   // List of the keys that have expired and have not been removed yet
+#define N_LISTS (LEVELS * SLOTS + 1)
+#define NO_ENTRY -1
+
+typedef struct {
+    int key;
+    uint64_t deadline;      /* Expiration time (ms of the monotonic clock) */
+    uint64_t tick;          /* Tick at which it expires (deadline rounded up to a tick) */
+    int list;               /* List (slot) where the entry is, NO_ENTRY if the entry is free */
+    int prev;               /* Previous entry in the list */
+    int next;               /* Next entry in the list (or in the free entries) */
+} Temporizador;
+
+static Temporizador *entries = NULL;
+static int capacity = 0;
+static int N_used = 0;                  // Entries allocated (used or free)
+static int free_entries = NO_ENTRY;     // First free entry
+static long N_keys = 0;                 // Keys with a TTL
+static int heads[N_LISTS];              // First entry of each slot of each level, and of the expired keys
+static uint64_t current_tick = 0;       // Last tick processed
+static int started = 0;
+
+static TablaEnteros positions = TABLA_ENTEROS_INIT;   // Entry of each key
+
+static pthread_mutex_t mutex_wheel = PTHREAD_MUTEX_INITIALIZER;
+
+
+static uint64_t now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void start()
+{
+    if (started)
+    {
+        return;
+    }
+    for (int i = 0; i < N_LISTS; i++)
+    {
+        heads[i] = NO_ENTRY;
+    }
+    current_tick = now_ms() / RUEDA_TTL_TICK_MS;
+    started = 1;
+}
+
+static int grow()
+{
+    // Double the entries
+    int new_capacity = capacity == 0 ? 1024 : 2 * capacity;
+    Temporizador *new_entries = realloc(entries, new_capacity * sizeof(Temporizador));
+    if (new_entries == NULL)
+    {
+        return -1;
+    }
+    entries = new_entries;
+    capacity = new_capacity;
+    return 0;
+}
+
+static void link_entry(int i, int list)
+{
+    entries[i].list = list;
+    entries[i].prev = NO_ENTRY;
+    entries[i].next = heads[list];
+    if (heads[list] != NO_ENTRY)
+    {
+        entries[heads[list]].prev = i;
+    }
+    heads[list] = i;
+}
+
+static void unlink_entry(int i)
+{
+    Temporizador *e = &entries[i];
+    if (e->prev != NO_ENTRY)
+    {
+        entries[e->prev].next = e->next;
+    }
+    else
+    {
+        heads[e->list] = e->next;
+    }
+    if (e->next != NO_ENTRY)
+    {
+        entries[e->next].prev = e->prev;
+    }
+}
+
+static void place(int i)
+{
+    // Put the entry in the slot of the lowest level whose turn covers its tick
+    uint64_t tick = entries[i].tick;
+    if (tick <= current_tick)
+    {
+        link_entry(i, EXPIRED_LIST);
+        return;
+    }
+    uint64_t delta = tick - current_tick;
+    if (delta >= MAX_DELTA)
+    {
+        // Beyond the wheel: wait in the last slot it reaches, it is placed again when that slot turns
+        delta = MAX_DELTA - 1;
+        tick = current_tick + delta;
+    }
+    int level = 0;
+    while (delta >= (uint64_t)1 << (SLOT_BITS * (level + 1)))
+    {
+        level++;
+    }
+    link_entry(i, level * SLOTS + ((tick >> (SLOT_BITS * level)) & (SLOTS - 1)));
+}
+
+static void move_list(int list)
+{
+    // Place again all the entries of the list (the slot has been reached)
+    int i = heads[list];
+    heads[list] = NO_ENTRY;
+    while (i != NO_ENTRY)
+    {
+        int next = entries[i].next;
+        place(i);
+        i = next;
+    }
+}
+
+static void advance_tick()
+{
+    current_tick++;
+
+    // At the start of each turn of a level, the slot of the next level that begins moves down
+    for (int level = 1; level < LEVELS; level++)
+    {
+        if ((current_tick & (((uint64_t)1 << (SLOT_BITS * level)) - 1)) != 0)
+        {
+            break;
+        }
+        move_list(level * SLOTS + ((current_tick >> (SLOT_BITS * level)) & (SLOTS - 1)));
+    }
+
+    // The keys of the slot of this tick expire
+    move_list(current_tick & (SLOTS - 1));
+}
+
+int rueda_ttl_set(int key, long ttl_ms)
+{
+    if (ttl_ms < 1)
+    {
+        return -1;
+    }
+    pthread_mutex_lock(&mutex_wheel);
+    start();
+    int i = tabla_enteros_get(&positions, key);
+    if (i >= 0)
+    {
+        unlink_entry(i);
+    }
+    else
+    {
+        if (free_entries == NO_ENTRY && N_used == capacity && grow() < 0)
+        {
+            pthread_mutex_unlock(&mutex_wheel);
+            return -1;
+        }
+        i = free_entries != NO_ENTRY ? free_entries : N_used;
+        if (tabla_enteros_put(&positions, key, i) < 0)
+        {
+            pthread_mutex_unlock(&mutex_wheel);
+            return -1;
+        }
+        if (i == free_entries)
+        {
+            free_entries = entries[i].next;
+        }
+        else
+        {
+            N_used++;
+        }
+        entries[i].key = key;
+        N_keys++;
+    }
+    entries[i].deadline = now_ms() + ttl_ms;
+    entries[i].tick = (entries[i].deadline + RUEDA_TTL_TICK_MS - 1) / RUEDA_TTL_TICK_MS;
+    place(i);
+    pthread_mutex_unlock(&mutex_wheel);
+    return 0;
+}
+
+void rueda_ttl_remove(int key)
+{
+    pthread_mutex_lock(&mutex_wheel);
+    int i = tabla_enteros_remove(&positions, key);
+    if (i >= 0)
+    {
+        unlink_entry(i);
+        entries[i].list = NO_ENTRY;
+        entries[i].next = free_entries;
+        free_entries = i;
+        N_keys--;
+    }
+    pthread_mutex_unlock(&mutex_wheel);
+}
+
+int rueda_ttl_expired(int key)
+{
+    // Most keys have no TTL: do not take the mutex if there is none at all
+    if (__atomic_load_n(&N_keys, __ATOMIC_RELAXED) == 0)
+    {
+        return 0;
+    }
+    pthread_mutex_lock(&mutex_wheel);
+    int i = tabla_enteros_get(&positions, key);
+    int expired = i >= 0 && entries[i].deadline <= now_ms();
+    pthread_mutex_unlock(&mutex_wheel);
+    return expired;
+}
+
+int rueda_ttl_advance(int *keys, int max_keys)
+{
+    pthread_mutex_lock(&mutex_wheel);
+    start();
+    uint64_t target = now_ms() / RUEDA_TTL_TICK_MS;
+    while (current_tick < target)
+    {
+        advance_tick();
+    }
+    int n = 0;
+    for (int i = heads[EXPIRED_LIST]; i != NO_ENTRY && n < max_keys; i = entries[i].next)
+    {
+        keys[n++] = entries[i].key;
+    }
+    pthread_mutex_unlock(&mutex_wheel);
+    return n;
+}
+
+void rueda_ttl_clear()
+{
+    pthread_mutex_lock(&mutex_wheel);
+    for (int i = 0; i < N_LISTS; i++)
+    {
+        heads[i] = NO_ENTRY;
+    }
+    tabla_enteros_clear(&positions);
+    N_used = 0;
+    free_entries = NO_ENTRY;
+    N_keys = 0;
+    pthread_mutex_unlock(&mutex_wheel);
+}
+
+long rueda_ttl_count()
+{
+    return __atomic_load_n(&N_keys, __ATOMIC_RELAXED);
+}
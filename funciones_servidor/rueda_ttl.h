@@ -0,0 +1,67 @@
+#ifndef RUEDA_TTL_H
+#define RUEDA_TTL_H
+
+/*
+Expiration times of the keys with a TTL, in a hierarchical timer wheel: 4 levels of 64 slots, the first one
+with a slot per tick (RUEDA_TTL_TICK_MS) and each of the next ones with a slot per turn of the previous one
+(about 46 hours in total; later deadlines wait in the last level and are placed again when it turns).
+Setting or removing the TTL of a key is O(1), and advancing the wheel only visits the slot of each tick (and,
+once per turn of a level, the slot of the next level, whose keys move down), never the keys that have not
+expired.
+The wheel does not delete anything: rueda_ttl_advance() returns the keys whose deadline has passed, which stay
+in the wheel (rueda_ttl_expired() returns 1 for them) until the caller deletes them and calls
+rueda_ttl_remove(). The times are those of the monotonic clock.
+The functions are thread-safe.
+*/
+
+#define RUEDA_TTL_TICK_MS 10    // Resolution of the wheel
+
+/**
+ * @brief Fija (o reemplaza) el tiempo de vida de la clave key: expira dentro de ttl_ms milisegundos.
+ * 
+ * @param key clave.
+ * @param ttl_ms tiempo de vida en milisegundos [>= 1].
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ * @retval 0 en caso de éxito.
+ * @retval -1 en caso de error.
+ */
+int rueda_ttl_set(int key, long ttl_ms);
+
+/**
+ * @brief Quita el tiempo de vida de la clave key (la clave deja de expirar).
+ * 
+ * @param key clave.
+ */
+void rueda_ttl_remove(int key);
+
+/**
+ * @brief Indica si la clave key tiene un tiempo de vida que ya ha pasado.
+ * 
+ * @param key clave.
+ * @return int La función devuelve 1 si la clave ha expirado y 0 si no (o si no tiene tiempo de vida).
+ */
+int rueda_ttl_expired(int key);
+
+/**
+ * @brief Avanza la rueda hasta el instante actual y copia en keys las claves que han expirado y todavía no se
+ * han quitado con rueda_ttl_remove(), como mucho max_keys.
+ * 
+ * @param keys vector donde se copian las claves [max_keys].
+ * @param max_keys número máximo de claves a copiar.
+ * @return int La función devuelve el número de claves copiadas.
+ */
+int rueda_ttl_advance(int *keys, int max_keys);
+
+/**
+ * @brief Quita el tiempo de vida de todas las claves.
+ */
+void rueda_ttl_clear();
+
+/**
+ * @brief Devuelve el número de claves con tiempo de vida.
+ * 
+ * @return long número de claves con tiempo de vida.
+ */
+long rueda_ttl_count();
+
+#endif
@@ -0,0 +1,136 @@
+#include <stdlib.h>
+
+#include "tabla_enteros.h"
+
+#define FREE_SLOT -1
+
+
+unsigned int tabla_enteros_hash(int key)
+{
+    unsigned int h = (unsigned int)key * 2654435761u;
+    return h ^ (h >> 16);
+}
+
+static int find_slot(const TablaEnteros *table, int key)
+{
+    // Return the slot of the key, or the free slot where it would go (the table must not be empty)
+    unsigned int mask = table->size - 1;
+    unsigned int i = tabla_enteros_hash(key) & mask;
+    while (table->values[i] != FREE_SLOT && table->keys[i] != key)
+    {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+static int grow(TablaEnteros *table)
+{
+    // Double the table and insert the entries again
+    int new_size = table->size == 0 ? 1024 : 2 * table->size;
+    int *new_keys = malloc(new_size * sizeof(int));
+    int *new_values = malloc(new_size * sizeof(int));
+    if (new_keys == NULL || new_values == NULL)
+    {
+        free(new_keys);
+        free(new_values);
+        return -1;
+    }
+    for (int i = 0; i < new_size; i++)
+    {
+        new_values[i] = FREE_SLOT;
+    }
+    TablaEnteros old = *table;
+    table->keys = new_keys;
+    table->values = new_values;
+    table->size = new_size;
+    for (int i = 0; i < old.size; i++)
+    {
+        if (old.values[i] != FREE_SLOT)
+        {
+            int slot = find_slot(table, old.keys[i]);
+            table->keys[slot] = old.keys[i];
+            table->values[slot] = old.values[i];
+        }
+    }
+    free(old.keys);
+    free(old.values);
+    return 0;
+}
+
+int tabla_enteros_get(const TablaEnteros *table, int key)
+{
+    if (table->size == 0)
+    {
+        return -1;
+    }
+    return table->values[find_slot(table, key)];
+}
+
+int tabla_enteros_put(TablaEnteros *table, int key, int value)
+{
+    if (value < 0)
+    {
+        return -1;
+    }
+    if (table->size > 0)
+    {
+        int slot = find_slot(table, key);
+        if (table->values[slot] != FREE_SLOT)
+        {
+            table->values[slot] = value;
+            return 0;
+        }
+    }
+
+    // A new key: keep the load factor <= 1/2
+    if (2 * (table->count + 1) > table->size && grow(table) < 0)
+    {
+        return -1;
+    }
+    int slot = find_slot(table, key);
+    table->keys[slot] = key;
+    table->values[slot] = value;
+    table->count++;
+    return 0;
+}
+
+int tabla_enteros_remove(TablaEnteros *table, int key)
+{
+    if (table->size == 0)
+    {
+        return -1;
+    }
+    unsigned int mask = table->size - 1;
+    unsigned int hole = find_slot(table, key);
+    int value = table->values[hole];
+    if (value == FREE_SLOT)
+    {
+        return -1;
+    }
+
+    // Backward-shift deletion: move back each next entry whose home is not between the hole and its slot
+    unsigned int i = (hole + 1) & mask;
+    while (table->values[i] != FREE_SLOT)
+    {
+        unsigned int home = tabla_enteros_hash(table->keys[i]) & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            table->keys[hole] = table->keys[i];
+            table->values[hole] = table->values[i];
+            hole = i;
+        }
+        i = (i + 1) & mask;
+    }
+    table->values[hole] = FREE_SLOT;
+    table->count--;
+    return value;
+}
+
+void tabla_enteros_clear(TablaEnteros *table)
+{
+    for (int i = 0; i < table->size; i++)
+    {
+        table->values[i] = FREE_SLOT;
+    }
+    table->count = 0;
+}
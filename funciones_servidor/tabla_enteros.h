@@ -0,0 +1,66 @@
+#ifndef TABLA_ENTEROS_H
+#define TABLA_ENTEROS_H
+
+/*
+Hash table from int keys to int values (>= 0), with open addressing and linear probing, shared by the indexes
+that map a key to a position in their own arrays (vectors, timers, versions). It doubles when it gets half
+full, and the deletions shift the next entries back, so that no tombstones are needed and the lookups never
+slow down after many deletions.
+The functions are not thread-safe: the caller must serialize the access to each table.
+*/
+
+#define TABLA_ENTEROS_INIT {NULL, NULL, 0, 0}  // Empty table (nothing allocated until the first insertion)
+
+typedef struct {
+    int *keys;
+    int *values;        /* -1 if the slot is free */
+    int size;           /* Number of slots, a power of 2 (0 until the first insertion) */
+    int count;          /* Number of keys */
+} TablaEnteros;
+
+/**
+ * @brief Dispersa la clave key (multiplicativa de Knuth, con los bits altos mezclados en los bajos).
+ * 
+ * @param key clave.
+ * @return unsigned int valor de dispersión.
+ */
+unsigned int tabla_enteros_hash(int key);
+
+/**
+ * @brief Busca la clave key en la tabla.
+ * 
+ * @param table tabla.
+ * @param key clave.
+ * @return int La función devuelve el valor de la clave, o -1 si no está en la tabla.
+ */
+int tabla_enteros_get(const TablaEnteros *table, int key);
+
+/**
+ * @brief Inserta la clave key con el valor value, o reemplaza su valor si ya estaba en la tabla.
+ * 
+ * @param table tabla.
+ * @param key clave.
+ * @param value valor [>= 0].
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ * @retval 0 en caso de éxito.
+ * @retval -1 en caso de error.
+ */
+int tabla_enteros_put(TablaEnteros *table, int key, int value);
+
+/**
+ * @brief Elimina la clave key de la tabla.
+ * 
+ * @param table tabla.
+ * @param key clave.
+ * @return int La función devuelve el valor que tenía la clave, o -1 si no estaba en la tabla.
+ */
+int tabla_enteros_remove(TablaEnteros *table, int key);
+
+/**
+ * @brief Elimina todas las claves de la tabla (sin liberar su memoria).
+ * 
+ * @param table tabla.
+ */
+void tabla_enteros_clear(TablaEnteros *table);
+
+#endif
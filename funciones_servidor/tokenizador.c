@@ -0,0 +1,142 @@
+#include <stdint.h>
+#include <pthread.h>
+
+#include "tokenizador.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86 1
+#endif
+
+
+// Scalar version (also used for the tail of the vectorized ones)
+// previous_space is 1 if the byte before line[start] is a separator (or line[start] is the first one)
+
+static int tokenizar_scalar(char *line, int start, int len, char **tokens, int n_tokens, int max_tokens, int previous_space)
+{
+    for (int i = start; i < len; i++)
+    {
+        if (line[i] == ' ')
+        {
+            line[i] = '\0';
+            previous_space = 1;
+        }
+        else
+        {
+            if (previous_space)
+            {
+                if (n_tokens == max_tokens)
+                {
+                    return -1;
+                }
+                tokens[n_tokens++] = line + i;
+            }
+            previous_space = 0;
+        }
+    }
+    return n_tokens;
+}
+
+#ifdef HAVE_X86
+
+// SSE2 version (always available on x86-64), 16 bytes at a time
+// For each block: bit i of spaces is set if byte i is a separator, and a token starts at byte i
+// if it is not a separator and the previous one is
+
+static int tokenizar_sse2(char *line, int len, char **tokens, int max_tokens)
+{
+    const __m128i space = _mm_set1_epi8(' ');
+    unsigned previous_space = 1;
+    int n_tokens = 0;
+    int i = 0;
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(line + i));
+        __m128i is_space = _mm_cmpeq_epi8(x, space);
+        unsigned spaces = _mm_movemask_epi8(is_space);
+        if (spaces != 0)
+        {
+            _mm_storeu_si128((__m128i *)(line + i), _mm_andnot_si128(is_space, x));
+        }
+
+        unsigned starts = ~spaces & ((spaces << 1) | previous_space) & 0xffff;
+        while (starts != 0)
+        {
+            if (n_tokens == max_tokens)
+            {
+                return -1;
+            }
+            tokens[n_tokens++] = line + i + __builtin_ctz(starts);
+            starts &= starts - 1;
+        }
+        previous_space = spaces >> 15;
+    }
+    return tokenizar_scalar(line, i, len, tokens, n_tokens, max_tokens, previous_space);
+}
+
+// AVX2 version, 32 bytes at a time (only used if the CPU supports AVX2)
+
+__attribute__((target("avx2")))
+static int tokenizar_avx2(char *line, int len, char **tokens, int max_tokens)
+{
+    const __m256i space = _mm256_set1_epi8(' ');
+    uint32_t previous_space = 1;
+    int n_tokens = 0;
+    int i = 0;
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(line + i));
+        __m256i is_space = _mm256_cmpeq_epi8(x, space);
+        uint32_t spaces = (uint32_t)_mm256_movemask_epi8(is_space);
+        if (spaces != 0)
+        {
+            _mm256_storeu_si256((__m256i *)(line + i), _mm256_andnot_si256(is_space, x));
+        }
+
+        uint32_t starts = ~spaces & ((spaces << 1) | previous_space);
+        while (starts != 0)
+        {
+            if (n_tokens == max_tokens)
+            {
+                return -1;
+            }
+            tokens[n_tokens++] = line + i + __builtin_ctz(starts);
+            starts &= starts - 1;
+        }
+        previous_space = spaces >> 31;
+    }
+    return tokenizar_scalar(line, i, len, tokens, n_tokens, max_tokens, previous_space);
+}
+
+#endif
+
+
+// Kernel selected at run time depending on the CPU
+static int tokenizar_generic(char *line, int len, char **tokens, int max_tokens)
+{
+    return tokenizar_scalar(line, 0, len, tokens, 0, max_tokens, 1);
+}
+
+static int (*tokenizar_impl)(char *, int, char **, int) = tokenizar_generic;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+static void select_kernels()
+{
+#ifdef HAVE_X86
+    if (__builtin_cpu_supports("avx2"))
+    {
+        tokenizar_impl = tokenizar_avx2;
+    }
+    else
+    {
+        tokenizar_impl = tokenizar_sse2;
+    }
+#endif
+}
+
+
+int tokenizar(char *line, int len, char **tokens, int max_tokens)
+{
+    pthread_once(&kernels_once, select_kernels);
+    return tokenizar_impl(line, len, tokens, max_tokens);
+}
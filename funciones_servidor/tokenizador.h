@@ -0,0 +1,22 @@
+#ifndef TOKENIZADOR_H
+#define TOKENIZADOR_H
+
+/*
+Tokenizer of the request lines (tokens separated by one or more spaces, like strtok(line, " ")).
+The separators are found 16 bytes at a time with SSE2 (32 with AVX2 when the CPU supports it,
+detected at run time), with a scalar fallback for the rest of architectures. The spaces are replaced
+by '\0' in place, so each token is a string.
+*/
+
+/**
+ * @brief Divide line en tokens separados por espacios.
+ * 
+ * @param line línea a dividir (se modifica: los espacios se sustituyen por '\0').
+ * @param len longitud de la línea.
+ * @param tokens vector donde se guarda el comienzo de cada token [max_tokens].
+ * @param max_tokens número máximo de tokens.
+ * @return int La función devuelve el número de tokens, o -1 si hay más de max_tokens.
+ */
+int tokenizar(char *line, int len, char **tokens, int max_tokens);
+
+#endif
@@ -0,0 +1,71 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "versiones.h"
+#include "tabla_enteros.h"
+
+static TablaEnteros positions = TABLA_ENTEROS_INIT;   // Position of each key in versions
+static uint64_t *versions = NULL;
+static int capacity = 0;
+static int N_keys = 0;
+static uint64_t last_version = 0;           // Last version given
+static uint64_t base = 0;                   // Version of the keys not written since the start or the last clear
+
+
+static int grow()
+{
+    // Double the capacity of the versions
+    int new_capacity = capacity == 0 ? 1024 : 2 * capacity;
+    uint64_t *new_versions = realloc(versions, new_capacity * sizeof(uint64_t));
+    if (new_versions == NULL)
+    {
+        return -1;
+    }
+    versions = new_versions;
+    capacity = new_capacity;
+    return 0;
+}
+
+void versiones_start()
+{
+    // Start after the versions that a previous run of the server could have given (one per ns at most)
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    base = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    last_version = base;
+}
+
+uint64_t version_get(int key)
+{
+    int pos = tabla_enteros_get(&positions, key);
+    return pos < 0 || versions[pos] < base ? base : versions[pos];
+}
+
+int version_bump(int key)
+{
+    int pos = tabla_enteros_get(&positions, key);
+    if (pos < 0)
+    {
+        if ((N_keys == capacity && grow() < 0) || tabla_enteros_put(&positions, key, N_keys) < 0)
+        {
+            return -1;
+        }
+        pos = N_keys++;
+    }
+    versions[pos] = ++last_version;
+    return 0;
+}
+
+uint64_t versiones_last()
+{
+    return last_version;
+}
+
+void versiones_clear()
+{
+    // Every key gets a version greater than all the ones given before, so none of them can be matched again
+    base = ++last_version;
+    tabla_enteros_clear(&positions);
+    N_keys = 0;
+}
@@ -0,0 +1,55 @@
+#ifndef VERSIONES_H
+#define VERSIONES_H
+
+/*
+Versions of the tuples, for the optimistic transactions (TRANSACTION): every write of a key (set, modify,
+delete, expiration) gives it a new version, taken from a counter shared by all the keys that starts at the
+current time (ns) when the server starts, so that a version is never repeated, not even after a restart.
+A key not written since the server started (or since the last INIT) has the base version: the start time, raised
+by INIT above every version given before. So a version read before INIT or a restart never matches again, even
+for a key that did not exist then.
+The versions are kept only in memory, in a hash table (open addressing). The functions are not thread-safe:
+the server calls them with the storage locked (shared for version_get() and versiones_last(), exclusive for
+the rest).
+*/
+
+#include <stdint.h>
+
+/**
+ * @brief Fija la versión base a partir de la hora actual (al arrancar el servidor, antes de usar las versiones).
+ */
+void versiones_start();
+
+/**
+ * @brief Devuelve la versión de la clave key (la versión base si no se ha escrito desde que arrancó el servidor
+ * o desde el último INIT).
+ * 
+ * @param key clave.
+ * @return uint64_t versión de la clave.
+ */
+uint64_t version_get(int key);
+
+/**
+ * @brief Asigna una versión nueva a la clave key, tras escribirla.
+ * 
+ * @param key clave.
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ * @retval 0 en caso de éxito.
+ * @retval -1 en caso de error.
+ */
+int version_bump(int key);
+
+/**
+ * @brief Devuelve la última versión asignada (la versión base si todavía no se ha escrito ninguna clave).
+ * 
+ * @return uint64_t última versión asignada.
+ */
+uint64_t versiones_last();
+
+/**
+ * @brief Olvida las versiones de todas las claves (tras INIT): la versión base pasa a ser mayor que todas las
+ * anteriores.
+ */
+void versiones_clear();
+
+#endif
@@ -0,0 +1,130 @@
+#include <string.h>
+
+#include "funciones_traza.h"
+
+static int write_varint(FILE *file, uint64_t value)
+{
+    unsigned char bytes[10];
+    int len = 0;
+    do
+    {
+        bytes[len] = value & 0x7f;
+        value >>= 7;
+        if (value != 0)
+        {
+            bytes[len] |= 0x80;
+        }
+        len++;
+    } while (value != 0);
+    return fwrite(bytes, 1, len, file) == (size_t)len ? 0 : -1;
+}
+
+static int read_varint(FILE *file, uint64_t *value)
+{
+    // Returns 0 if the value was read, 1 at the end of the file and -1 if the value is truncated
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        int byte = fgetc(file);
+        if (byte == EOF)
+        {
+            return shift == 0 ? 1 : -1;
+        }
+        *value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+        {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int traza_open_write(Traza *trace, const char *path)
+{
+    memset(trace, 0, sizeof(Traza));
+    trace->file = fopen(path, "wb");
+    if (trace->file == NULL)
+    {
+        perror("Error creating the trace file\n");
+        return -1;
+    }
+    if (fwrite(TRACE_MAGIC, 1, TRACE_MAGIC_LEN, trace->file) != TRACE_MAGIC_LEN)
+    {
+        perror("Error writing the trace file\n");
+        fclose(trace->file);
+        trace->file = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int traza_write(Traza *trace, uint64_t timestamp, const char *line, int len)
+{
+    if (trace->records == 0)
+    {
+        trace->first = timestamp;
+    }
+    uint64_t offset = timestamp > trace->first ? timestamp - trace->first : 0;
+    uint64_t delta = offset > trace->last ? offset - trace->last : 0;
+    trace->last += delta;
+
+    if (write_varint(trace->file, delta) < 0 || write_varint(trace->file, len) < 0 ||
+        fwrite(line, 1, len, trace->file) != (size_t)len)
+    {
+        perror("Error writing the trace file\n");
+        return -1;
+    }
+    trace->records++;
+    return 0;
+}
+
+int traza_open_read(Traza *trace, const char *path)
+{
+    memset(trace, 0, sizeof(Traza));
+    trace->file = fopen(path, "rb");
+    if (trace->file == NULL)
+    {
+        perror("Error opening the trace file\n");
+        return -1;
+    }
+    char magic[TRACE_MAGIC_LEN];
+    if (fread(magic, 1, TRACE_MAGIC_LEN, trace->file) != TRACE_MAGIC_LEN || memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_LEN) != 0)
+    {
+        fprintf(stderr, "%s is not a trace file\n", path);
+        fclose(trace->file);
+        trace->file = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int traza_read(Traza *trace, uint64_t *offset, char *line)
+{
+    uint64_t delta, len;
+    int res = read_varint(trace->file, &delta);
+    if (res != 0)
+    {
+        return res > 0 ? 0 : -1;
+    }
+    if (read_varint(trace->file, &len) != 0 || len >= TRACE_MAX_LINE || fread(line, 1, len, trace->file) != len)
+    {
+        fprintf(stderr, "Truncated or corrupted trace record %ld\n", trace->records);
+        return -1;
+    }
+    line[len] = '\0';
+    trace->last += delta;
+    *offset = trace->last;
+    trace->records++;
+    return (int)len;
+}
+
+int traza_close(Traza *trace)
+{
+    if (trace->file == NULL)
+    {
+        return 0;
+    }
+    int res = fclose(trace->file);
+    trace->file = NULL;
+    return res == 0 ? 0 : -1;
+}
@@ -0,0 +1,73 @@
+#ifndef FUNCIONES_TRAZA_H
+#define FUNCIONES_TRAZA_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+Trace of the requests received by the server, to replay them later.
+The file starts with TRACE_MAGIC and is followed by one record per request:
+    varint (ns since the previous request) varint (length of the line) line (without '\n')
+where varint is an unsigned LEB128 integer (7 bits per byte, the highest bit set in all the bytes
+but the last one). A typical request takes its length plus 3 to 5 bytes.
+*/
+
+#define TRACE_MAGIC "TUPTRZ1\n"
+#define TRACE_MAGIC_LEN 8
+#define TRACE_MAX_LINE 10706    // Same size as the buffer of the server
+
+typedef struct {
+    FILE *file;         /* Trace file */
+    uint64_t first;     /* Timestamp of the first record (writer) */
+    uint64_t last;      /* Timestamp of the last record, relative to the first one */
+    long records;       /* Records written or read */
+} Traza;
+
+/**
+ * @brief Crea el fichero de traza path (si existe, se sobrescribe).
+ * 
+ * @param trace traza.
+ * @param path ruta del fichero.
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ */
+int traza_open_write(Traza *trace, const char *path);
+
+/**
+ * @brief Añade una petición a la traza.
+ * 
+ * @param trace traza abierta con traza_open_write.
+ * @param timestamp instante de llegada de la petición (ns, reloj monótono).
+ * @param line petición.
+ * @param len longitud de la petición.
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ */
+int traza_write(Traza *trace, uint64_t timestamp, const char *line, int len);
+
+/**
+ * @brief Abre el fichero de traza path para leerlo.
+ * 
+ * @param trace traza.
+ * @param path ruta del fichero.
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error (incluido un fichero que no es una traza).
+ */
+int traza_open_read(Traza *trace, const char *path);
+
+/**
+ * @brief Lee la siguiente petición de la traza.
+ * 
+ * @param trace traza abierta con traza_open_read.
+ * @param offset instante de llegada de la petición, relativo a la primera petición de la traza (ns).
+ * @param line petición (terminada en '\0'), de al menos TRACE_MAX_LINE bytes.
+ * @return int La función devuelve la longitud de la petición, 0 al final de la traza y -1 en caso de error.
+ */
+int traza_read(Traza *trace, uint64_t *offset, char *line);
+
+/**
+ * @brief Cierra la traza (escribiendo los datos pendientes).
+ * 
+ * @param trace traza.
+ * @return int La función devuelve 0 en caso de éxito y -1 en caso de error.
+ */
+int traza_close(Traza *trace);
+
+#endif
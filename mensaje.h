@@ -7,17 +7,75 @@ Header for the message structure for the message queue
     - V_value2: vector of doubles (double *) (32 elements)
 */
 
+#include <stdint.h>
+
 #define MAX 256
 
+// Field mask for the GET_FIELDS operation (projection of a GET_VALUE)
+#define FIELD_VALUE1    1   /* Return value1 */
+#define FIELD_N_VALUE2  2   /* Return N_value2 */
+#define FIELD_V_VALUE2  4   /* Return the slice [first, first + count) of V_value2 */
+
+// Predicates for the FILTER operation
+#define FILTER_GREATER 0    /* Some element > threshold */
+#define FILTER_LESS 1       /* Some element < threshold */
+
+// Metrics for the KNN operation
+#define KNN_L2 0            /* Euclidean distance */
+#define KNN_COSINE 1        /* Cosine distance (1 - cosine similarity) */
+#define KNN_MAX_K 256       /* Maximum number of neighbours returned */
+
+// Transactions (TRANSACTION)
+#define TXN_MAX_KEYS 16     /* Maximum number of keys in the read set and in the write set */
+#define TXN_PUT 0           /* Write: store the tuple (set_value if the key does not exist, modify_value if it does) */
+#define TXN_DELETE 1        /* Write: delete the key (nothing if it does not exist) */
+
+// Write of a transaction
+typedef struct {
+    int kind;               /* TXN_PUT or TXN_DELETE */
+    int key;                /* Key written */
+    char value1[MAX];       /* Value1 of the tuple (TXN_PUT) */
+    int N_value2;           /* Number of elements in the vector (TXN_PUT) */
+    double V_value2[32];    /* Vector of doubles (TXN_PUT) */
+} Escritura;
+
+// Transaction: applied only if every key of the read set still has the version it was read at
+typedef struct {
+    int N_reads;                                /* Number of keys read */
+    int read_keys[TXN_MAX_KEYS];                /* Keys read */
+    uint64_t read_versions[TXN_MAX_KEYS];       /* Version of each key when it was read */
+    int N_writes;                               /* Number of writes */
+    Escritura writes[TXN_MAX_KEYS];             /* Writes, applied in order */
+} Transaccion;
+
 // Request message
 
 typedef struct {
-    int op;                 /* Operation code: 0 -> init, 1 -> set_value, 2 -> get_value, 3 -> modify_value, 4 -> delete_key, 5 -> exist */
-    int key;                /* Key of the message */
-    char value1[MAX];       /* Value1 of the message */
+    int op;                 /* Operation code: 0 -> init, 1 -> set_value, 2 -> get_value, 3 -> modify_value, 4 -> delete_key, 5 -> exist, 6 -> get_fields, 7 -> scan, 8 -> aggregate, 9 -> filter, 10 -> knn, 11 -> get_by_value1, 12 -> prefix_value1, 13 -> stats, 14 -> get_versioned, 15 -> transaction, 16 -> snapshot, 17 -> release_snapshot */
+    int key;                /* Key of the message (first key of the range for SCAN) */
+    char value1[MAX];       /* Value1 of the message (value1 or prefix to look for in GET_BY_VALUE1 and PREFIX_VALUE1) */
     int N_value2;           /* Number of elements in the vector */
-    double V_value2[32];    /* Vector of doubles */
+    double V_value2[32];    /* Vector of doubles (query vector for KNN) */
+    int end_key;            /* Last key of the range (SCAN) */
+    int limit;              /* Maximum number of keys to return (SCAN), number of neighbours (KNN), maximum number of keys (PREFIX_VALUE1) */
+    int metric;             /* Distance: KNN_L2 or KNN_COSINE (KNN) */
+    int cursor;             /* Key from which the scan is resumed (SCAN) */
+    int element;            /* Element of V_value2 to consider, -1 for all of them (AGGREGATE, FILTER) */
+    int cmp;                /* Predicate: FILTER_GREATER or FILTER_LESS (FILTER) */
+    double threshold;       /* Threshold of the predicate (FILTER) */
+    int mask;               /* Fields to return (GET_FIELDS): FIELD_VALUE1 | FIELD_N_VALUE2 | FIELD_V_VALUE2 */
+    int first;              /* First element of V_value2 to return (GET_FIELDS) */
+    int count;              /* Number of elements of V_value2 to return, -1 for all of them (GET_FIELDS) */
+    int ttl;                /* Time to live of the tuple in ms, 0 for none (SET_VALUE, MODIFY_VALUE) */
+    Transaccion *txn;       /* Transaction (TRANSACTION, allocated with malloc) */
+    long snapshot;          /* Snapshot read (SCAN, AGGREGATE) or released (RELEASE_SNAPSHOT), 0 for the current state */
     int client_sd;          /* Socket descriptor of the client */
+    uint64_t arrival;       /* Time at which the connection was accepted (ns, monotonic clock) */
+    uint64_t received;      /* Time at which the request was read (only with the slow-request log) */
+    uint64_t parsed;        /* Time at which the request was parsed (only with the slow-request log) */
+    uint64_t lock_wait;     /* Time at which the processing thread started waiting for the storage (only with the slow-request log) */
+    uint64_t locked;        /* Time at which the storage was locked (only with the slow-request log) */
+    uint64_t processed;     /* Time at which the storage call returned (only with the slow-request log) */
 } Request;
 
 // Response message
@@ -26,5 +84,7 @@ typedef struct {
     char value1[MAX];       /* Value1 of the message */
     int N_value2;           /* Number of elements in the vector */
     double V_value2[32];    /* Vector of doubles */
+    uint64_t version;       /* Version of the tuple (GET_VERSIONED) */
+    long snapshot;          /* Snapshot opened (SNAPSHOT) */
     int res;                /* Result of the operation: 0 -> success, -1 -> error */
 } Response;
\ No newline at end of file
@@ -0,0 +1,306 @@
+/*
+Replays a trace captured with servidor.out --capture against a running server.
+The requests are sent exactly as they were received (one connection per request, as claves.c does),
+either keeping the original gaps between them (optionally scaled) or as fast as possible. At the end
+it reports the throughput and the latency percentiles of each operation.
+The server is given by the environment variables IP_TUPLAS and PORT_TUPLAS.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>    /* For signal handling */
+#include <time.h>      /* For clock_gettime() */
+#include <errno.h>
+#include <pthread.h>
+#include <getopt.h>    /* For the command line options */
+#include <unistd.h>
+#include <sys/socket.h> /* For sockets */
+#include <arpa/inet.h>
+
+#include "funciones_sockets/funciones_sockets.h"
+#include "funciones_histograma/funciones_histograma.h"
+#include "funciones_traza/funciones_traza.h"
+
+#define N_OPS 13    // Number of operation codes (see mensaje.h)
+#define MAX_THREADS 1024
+#define LOCALHOST "127.0.0.1"
+
+const char *op_names[N_OPS + 1] = {"init", "set", "get", "modify", "delete", "exist", "get_fields", "scan",
+                                   "aggregate", "filter", "knn", "by_value1", "prefix", "other"};
+
+typedef struct {
+    uint64_t offset;    /* Arrival time relative to the first request (ns) */
+    int op;             /* Operation code (N_OPS if it is not a valid one) */
+    char *line;         /* Request */
+    int len;
+} Peticion;
+
+typedef struct {
+    Histograma latency[N_OPS + 1];  /* Latency of each operation (ns) */
+    long failed[N_OPS + 1];         /* Requests whose response starts with -1 */
+    long errors;                    /* Requests that could not be sent or got no response */
+} Worker;
+
+// Configuration of the replay
+int n_threads = 8;              // Number of threads sending requests
+int fast = 0;                   // Ignore the original timing
+double speed = 1.0;             // Speed factor of the original timing
+struct sockaddr_in server_addr = {0};
+
+Peticion *requests = NULL;
+long n_requests = 0;
+long next_request = 0;          // Next request to send (shared by the threads)
+uint64_t start;
+
+volatile sig_atomic_t stop = 0; // Set by SIGINT to end the replay early
+
+void end(int sig){
+    // Signal handler for the SIGINT signal (Ctrl+C): end the replay and print the report
+    stop = 1;
+}
+
+uint64_t now_ns(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+int load_trace(char *path){
+    Traza trace;
+    if (traza_open_read(&trace, path) == -1){
+        return -1;
+    }
+
+    char line[TRACE_MAX_LINE];
+    uint64_t offset;
+    long capacity = 0;
+    int len;
+    while ((len = traza_read(&trace, &offset, line)) > 0)
+    {
+        if (n_requests == capacity){
+            capacity = capacity == 0 ? 1024 : capacity * 2;
+            Peticion *new_requests = realloc(requests, capacity * sizeof(Peticion));
+            if (new_requests == NULL){
+                perror("Error allocating memory\n");
+                traza_close(&trace);
+                return -1;
+            }
+            requests = new_requests;
+        }
+        Peticion *request = &requests[n_requests++];
+        request->offset = offset;
+        request->line = strdup(line);
+        request->len = len;
+        request->op = (line[0] >= '0' && line[0] <= '9') ? atoi(line) : N_OPS;
+        if (request->op < 0 || request->op >= N_OPS){
+            request->op = N_OPS;
+        }
+    }
+    traza_close(&trace);
+    return len < 0 ? -1 : 0;
+}
+
+int send_request(Peticion *request, char *response){
+    // Send the request and read the whole response (the server closes the connection after it)
+    int sd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sd < 0){
+        perror("Error creating the socket\n");
+        return -1;
+    }
+    if (connect(sd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0){
+        perror("Error connecting to the server\n");
+        close(sd);
+        return -1;
+    }
+    if (sendMessage(sd, request->line, request->len + 1) == -1){
+        perror("Error sending the request\n");
+        close(sd);
+        return -1;
+    }
+
+    // Only the beginning of the response is kept (to tell whether it failed)
+    int len = 0;
+    char chunk[4096];
+    ssize_t n;
+    while ((n = read(sd, chunk, sizeof(chunk))) != 0)
+    {
+        if (n < 0){
+            if (errno == EINTR){
+                continue;
+            }
+            break;
+        }
+        if (len < 15){
+            int copy = n < 15 - len ? n : 15 - len;
+            memcpy(response + len, chunk, copy);
+            len += copy;
+        }
+    }
+    close(sd);
+    response[len] = '\0';
+    return len > 0 ? 0 : -1;
+}
+
+void *run_worker(void *arg){
+    Worker *worker = arg;
+    char response[16];
+
+    while (!stop)
+    {
+        long i = __atomic_fetch_add(&next_request, 1, __ATOMIC_RELAXED);
+        if (i >= n_requests){
+            break;
+        }
+        Peticion *request = &requests[i];
+
+        // With the original timing the latency is measured from the time the request should have been
+        // sent, so that a slow server is not hidden by the replay falling behind (coordinated omission)
+        uint64_t t0;
+        if (!fast){
+            t0 = start + (uint64_t)(request->offset / speed);
+            uint64_t t = now_ns();
+            if (t0 > t){
+                struct timespec ts = {(t0 - t) / 1000000000ull, (t0 - t) % 1000000000ull};
+                nanosleep(&ts, NULL);
+            }
+        } else {
+            t0 = now_ns();
+        }
+
+        if (send_request(request, response) == -1){
+            worker->errors++;
+            continue;
+        }
+        if (strncmp(response, "-1", 2) == 0){
+            worker->failed[request->op]++;
+        }
+        histograma_record(&worker->latency[request->op], now_ns() - t0);
+    }
+    return NULL;
+}
+
+void usage(char *program){
+    printf("Usage: %s [options] <trace>\n", program);
+    printf("Options:\n");
+    printf("  -t <threads>          number of threads sending requests, 1 keeps the order of the trace (default %d)\n", n_threads);
+    printf("  -f                    send the requests as fast as possible (default original timing)\n");
+    printf("  -s <factor>           speed factor of the original timing (default %.0f)\n", speed);
+}
+
+int main(int argc, char *argv[])
+{
+    signal (SIGINT, end);
+    signal (SIGPIPE, SIG_IGN);
+
+    int option;
+    while ((option = getopt(argc, argv, "t:fs:h")) != -1){
+        switch (option){
+            case 't': n_threads = atoi(optarg); break;
+            case 'f': fast = 1; break;
+            case 's': speed = atof(optarg); break;
+            default:
+                usage(argv[0]);
+                return -1;
+        }
+    }
+    if (optind != argc - 1 || n_threads < 1 || n_threads > MAX_THREADS || speed <= 0.0){
+        usage(argv[0]);
+        return -1;
+    }
+
+    char *port = getenv("PORT_TUPLAS");
+    char *ip = getenv("IP_TUPLAS");
+    if (port == NULL || ip == NULL){
+        perror("Error getting environment variables\n");
+        return -1;
+    }
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(atoi(port));
+    server_addr.sin_addr.s_addr = inet_addr(strcmp(ip, "localhost") == 0 ? LOCALHOST : ip);
+
+    if (load_trace(argv[optind]) == -1){
+        return -1;
+    }
+    if (n_requests == 0){
+        printf("The trace is empty\n");
+        return 0;
+    }
+
+    Worker *workers = calloc(n_threads, sizeof(Worker));
+    pthread_t *threads = malloc(n_threads * sizeof(pthread_t));
+    if (workers == NULL || threads == NULL){
+        perror("Error allocating memory\n");
+        return -1;
+    }
+
+    start = now_ns();
+    for (int i = 0; i < n_threads; i++)
+    {
+        for (int j = 0; j <= N_OPS; j++)
+        {
+            histograma_init(&workers[i].latency[j]);
+        }
+        if (pthread_create(&threads[i], NULL, run_worker, &workers[i]) != 0){
+            perror("Error creating the thread\n");
+            return -1;
+        }
+    }
+
+    Histograma latency[N_OPS + 1], total;
+    long failed[N_OPS + 1] = {0};
+    long errors = 0, total_failed = 0;
+    histograma_init(&total);
+    for (int j = 0; j <= N_OPS; j++)
+    {
+        histograma_init(&latency[j]);
+    }
+    for (int i = 0; i < n_threads; i++)
+    {
+        pthread_join(threads[i], NULL);
+        for (int j = 0; j <= N_OPS; j++)
+        {
+            histograma_merge(&latency[j], &workers[i].latency[j]);
+            failed[j] += workers[i].failed[j];
+        }
+        errors += workers[i].errors;
+    }
+    double elapsed = (now_ns() - start) / 1e9;
+    for (int j = 0; j <= N_OPS; j++)
+    {
+        histograma_merge(&total, &latency[j]);
+        total_failed += failed[j];
+    }
+
+    printf("Trace: %s, %ld requests over %.2f s\n", argv[optind], n_requests, requests[n_requests - 1].offset / 1e9);
+    printf("Threads: %d, timing: ", n_threads);
+    if (fast){
+        printf("as fast as possible");
+    } else {
+        printf("original x%.2f", speed);
+    }
+    printf(", duration: %.2f s, errors: %ld\n", elapsed, errors);
+    printf("Throughput: %.1f req/s\n\n", total.total / elapsed);
+
+    printf("%-10s %10s %8s %10s %10s %10s %10s %10s %10s\n", "op", "requests", "failed", "req/s", "mean(us)", "p50(us)", "p99(us)", "p999(us)", "max(us)");
+    for (int i = 0; i <= N_OPS + 1; i++)
+    {
+        Histograma *h = i <= N_OPS ? &latency[i] : &total;
+        if (h->total == 0){
+            continue;
+        }
+        printf("%-10s %10lu %8ld %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", i <= N_OPS ? op_names[i] : "total",
+               (unsigned long)h->total, i <= N_OPS ? failed[i] : total_failed, h->total / elapsed, histograma_mean(h) / 1e3,
+               histograma_percentile(h, 50) / 1e3, histograma_percentile(h, 99) / 1e3,
+               histograma_percentile(h, 99.9) / 1e3, h->max / 1e3);
+    }
+
+    for (long i = 0; i < n_requests; i++)
+    {
+        free(requests[i].line);
+    }
+    free(requests);
+    free(workers);
+    free(threads);
+    return 0;
+}
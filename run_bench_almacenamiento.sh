@@ -0,0 +1,4 @@
+#!/bin/bash
+# Add the current directory to the library path so that the linker can find the shared library
+export LD_LIBRARY_PATH=$LD_LIBRARY_PATH:.
+./bench_almacenamiento.out "$@"
@@ -3,4 +3,4 @@
 export LD_LIBRARY_PATH=$LD_LIBRARY_PATH:.
 export PORT_TUPLAS=8080
 export IP_TUPLAS=localhost
-./cliente_concurrente.out
\ No newline at end of file
+./cliente_concurrente.out "$@"
\ No newline at end of file
@@ -1,148 +1,1303 @@
+#define _GNU_SOURCE     /* For pthread_rwlockattr_setkind_np() */
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>   /* For mode constants */
 #include <string.h>
 #include <pthread.h>    /* For threads */
 #include <signal.h>    /* For signal handling */
+#include <poll.h>       /* For poll() */
+#include <unistd.h>     /* For pipe2() and write() */
+#include <fcntl.h>      /* For O_NONBLOCK */
+#include <errno.h>
 #include <sys/socket.h> /* For sockets */
 #include <arpa/inet.h>
+#include <getopt.h>     /* For the command line options */
+#include <time.h>       /* For clock_gettime() */
+#include <limits.h>     /* For INT_MIN and INT_MAX */
 
 #include "mensaje.h"
 #include "funciones_servidor/funciones_servidor.h"
+#include "funciones_servidor/tokenizador.h"
+#include "funciones_servidor/motor.h"
+#include "funciones_servidor/rueda_ttl.h"
+#include "funciones_servidor/versiones.h"
+#include "funciones_servidor/instantaneas.h"
+#include "funciones_servidor/tabla_enteros.h"
 #include "funciones_sockets/funciones_sockets.h"
+#include "funciones_traza/funciones_traza.h"
+#include "funciones_estadisticas/funciones_estadisticas.h"
+#include "funciones_log/funciones_log.h"
+#include "funciones_perf/funciones_perf.h"
+#include "funciones_dobles/funciones_dobles.h"
 
+#define SCAN_CHUNK 64   // Maximum number of keys sent in each line of a SCAN response
+#define METRICS_SIZE 65536  // Maximum size of the metrics dump
+#define REQUEST_SIZE 10706  // Maximum size of a request (line)
+#define RESPONSE_SIZE 10695 // Maximum size of a response (except the streams of keys)
+#define COALESCE_SLOTS 256  // Number of GET_VALUE that can be read at a time for other requests (coalescing)
+#define EXPIRE_BATCH 256    // Maximum number of expired keys deleted in each tick of the expiration thread
 
-int server_sd, client_sd;                        // Server and client socket descriptors
-char buffer[10706];                                 // Buffer for the messages
+// Names of the operation codes in the statistics (the index is the operation code)
+const char *op_names[] = {"init", "set_value", "get_value", "modify_value", "delete_key", "exist", "get_fields",
+                          "scan", "aggregate", "filter", "knn", "get_by_value1", "prefix_value1", "stats",
+                          "get_versioned", "transaction", "snapshot", "release_snapshot"};
 
-pthread_cond_t cond_message;    // Condition variable to signal the arrival of a new message
-pthread_mutex_t mutex_message;  // Mutex to protect the access to the message
-int processed_request = 0;      // Flag to indicate if the request has been processed
+int server_sd;                  // Server socket descriptor
+volatile sig_atomic_t stopping = 0; // Set by SIGINT and SIGTERM: the main thread stops the server
+int stop_pipe[2];               // Written by the signal handler, so that the main thread wakes up from poll()
+
+pthread_rwlock_t lock_storage;  // Lock of the storage: shared by the read-only operations, exclusive for the rest
+const Motor *engine;            // Storage engine (--engine)
+char *storage_path = NULL;      // File or directory of the engine (--storage), NULL for its default
+long ttl_expired_lazy = 0;      // Keys deleted because their TTL had passed when a request used them
+long ttl_expired_background = 0;    // Keys deleted by the expiration thread
+
+// Connection slot: the buffer where a request is read and the request parsed from it
+typedef struct Conexion {
+    char buffer[REQUEST_SIZE];
+    Request request;
+    struct Conexion *next_waiter;   /* Next GET_VALUE waiting for the same read (coalescing) */
+} Conexion;
+
+// State of a worker thread, reused by all the requests it processes
+typedef struct {
+    Response response;
+    char response_buffer[RESPONSE_SIZE];
+    Agregado aggregate;                 // Result of AGGREGATE
+    int knn_keys[KNN_MAX_K];            // Result of KNN
+    double knn_distances[KNN_MAX_K];
+    ContadoresPerf perf;                // Counters of the thread (--perf)
+} Worker;
+
+// The slots and the workers are allocated once at startup and recycled, so the memory used does not grow with
+// the number of clients: when every slot is in use the main thread stops accepting (the clients wait in the
+// listen backlog) until a worker releases one
+int n_workers = 8;              // Number of worker threads (--workers)
+int max_connections = 256;      // Number of connection slots (--max-connections)
+Conexion **free_connections;    // Stack of the free slots
+int n_free = 0;
+Conexion **pending;             // Queue (ring) of the requests parsed and waiting for a worker
+int first_pending = 0, n_pending = 0;
+pthread_mutex_t mutex_pool = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t cond_pending = PTHREAD_COND_INITIALIZER;  // Signaled when a request is queued
+pthread_cond_t cond_free = PTHREAD_COND_INITIALIZER;     // Signaled when a slot is released
+
+// GET_VALUE in flight: while a worker reads a key (with the storage locked), the GET_VALUE of the same key that
+// arrive join its read instead of locking the storage again, and it sends them the same response. No write can
+// happen until the read ends, so the joined requests get the value the key had when they arrived
+typedef struct {
+    pthread_mutex_t mutex;
+    int active;                 /* A worker is reading key */
+    int key;
+    Conexion *waiters;          /* GET_VALUE of key waiting for the response */
+} LecturaEnCurso;
+
+LecturaEnCurso in_flight[COALESCE_SLOTS];
+long coalesced = 0;             // GET_VALUE answered with the read of another request
+
+Traza trace;                    // Trace where the requests are captured (--capture)
+int capture = 0;                // Flag to indicate if the requests are captured
+
+char *metrics_file = NULL;      // File where the metrics are dumped every second (--metrics-file)
+int metrics_port = 0;           // Local port where the metrics are served (--metrics-port)
+
+FILE *slow_log = NULL;          // Log of the requests slower than slow_threshold (--slow-log), NULL if disabled
+uint64_t slow_threshold = 10000000; // Minimum latency of the requests logged (ns, --slow-threshold in us)
+pthread_mutex_t mutex_slow_log = PTHREAD_MUTEX_INITIALIZER;
+
+int perf = 0;                   // Read the perf counters around parse_request() and the storage calls (--perf)
+ContadoresPerf perf_main;       // Counters of the main thread (parse_request)
+AcumuladorPerf perf_parse;      // Counters of parse_request()
+AcumuladorPerf perf_storage[STATS_MAX_OPS]; // Counters of the storage call of each operation code
+pthread_mutex_t mutex_perf = PTHREAD_MUTEX_INITIALIZER;
+
+int format_perf(char *buffer, int size){
+    // Mean of each perf counter per request, for parse_request() and for the storage call of each operation code
+    // (one metric per line, like the statistics; counters that are not available are left out)
+    int len = 0;
+    pthread_mutex_lock(&mutex_perf);
+    for (int op = -1; op < (int)(sizeof(op_names) / sizeof(op_names[0])) && len < size; op++)
+    {
+        AcumuladorPerf *acc = op < 0 ? &perf_parse : &perf_storage[op];
+        if (acc->samples == 0){
+            continue;
+        }
+        for (int i = 0; i < PERF_N_COUNTERS && len < size; i++)
+        {
+            if (!perf_available(&perf_main, i)){
+                continue;
+            }
+            len += snprintf(buffer + len, size - len, "tuplas_perf_%s_per_request{phase=\"%s\",op=\"%s\"} %.1f\n",
+                            perf_counter_names[i], op < 0 ? "parse" : "storage", op < 0 ? "all" : op_names[op],
+                            perf_acc_mean(acc, i));
+        }
+    }
+    pthread_mutex_unlock(&mutex_perf);
+    return len < size ? len : size - 1;
+}
 
 void end(int sig){
-    // Signal handler for the SIGINT signal (Ctrl+C)
+    // Signal handler for the SIGINT and SIGTERM signals (Ctrl+C)
+    // It only does async-signal-safe calls: the main thread stops the server when it sees the flag (it may run in
+    // any thread, even in a worker that holds the storage lock)
+    (void)sig;
+    int saved_errno = errno;
+    stopping = 1;
+    if (write(stop_pipe[1], "", 1) == -1){
+        // The pipe is full (it is non-blocking), so the main thread is already awake
+    }
+    errno = saved_errno;
+}
+
+void take_storage(int shared){
+    // Take the storage lock, and tell the text engine whether other threads may be reading its indexes (it only
+    // rebuilds them with the lock exclusive)
+    if (shared){
+        pthread_rwlock_rdlock(&lock_storage);
+    } else {
+        pthread_rwlock_wrlock(&lock_storage);
+    }
+    set_shared_lookups(shared);
+}
 
+void stop_server(){
+    // Called by the main thread after SIGINT or SIGTERM
     printf("Exiting the server...\n");
 
     // Close the server socket
     close(server_sd);
 
-    // Close the client socket
-    close(client_sd);
+    // Stop the storage engine once no request is using it
+    take_storage(0);
+    engine->close();
+
+    // Write the requests captured and the log records that are still buffered
+    if (capture){
+        traza_close(&trace);
+    }
+    log_flush();
+
+    // Report the perf counters
+    if (perf){
+        char text[8192];
+        format_perf(text, sizeof(text));
+        printf("%s", text);
+    }
 
     // Exit the program    
     exit(0);
 }
 
-int process_request(Request *request){
+uint64_t now_ns(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void log_slow_request(Request *request, int failed, uint64_t sent){
+    // Write the time spent in each phase of the request to the slow-request log:
+    // read (accept -> readLine), parse (parse_request), dispatch (waiting for a worker), lock (waiting for lock_storage),
+    // storage (storage call), send (formatting and sendMessage, the whole stream for SCAN, FILTER...)
+    char date[32];
+    time_t t = time(NULL);
+    struct tm tm;
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime_r(&t, &tm));
+
+    int n_ops = sizeof(op_names) / sizeof(op_names[0]);
+    pthread_mutex_lock(&mutex_slow_log);
+    fprintf(slow_log, "%s op=%s key=%d res=%s total_us=%.1f read_us=%.1f parse_us=%.1f dispatch_us=%.1f lock_us=%.1f storage_us=%.1f send_us=%.1f\n",
+            date, request->op >= 0 && request->op < n_ops ? op_names[request->op] : "unknown", request->key,
+            failed ? "error" : "ok", (sent - request->arrival) / 1e3, (request->received - request->arrival) / 1e3,
+            (request->parsed - request->received) / 1e3, (request->lock_wait - request->parsed) / 1e3,
+            (request->locked - request->lock_wait) / 1e3, (request->processed - request->locked) / 1e3,
+            (sent - request->processed) / 1e3);
+    fflush(slow_log);
+    pthread_mutex_unlock(&mutex_slow_log);
+}
+
+int finish_request(Request *request, int failed, int res){
+    // Record the request in the statistics and close the connection with the client (one request per connection)
+    // The response has already been sent, so the client may send its next request (even a STATS) before this one is
+    // recorded: the counters are eventually consistent, not read-your-writes
+    uint64_t sent = now_ns();
+    estadisticas_record(request->op, failed, sent - request->arrival);
+    close(request->client_sd);
+    estadisticas_connections(-1);
+    if (slow_log != NULL && sent - request->arrival >= slow_threshold){
+        log_slow_request(request, failed, sent);
+    }
+    return res;
+}
+
+Conexion *get_connection(){
+    // Take a free slot, waiting for a worker to release one if all of them are in use
+    pthread_mutex_lock(&mutex_pool);
+    while (n_free == 0)
+    {
+        pthread_cond_wait(&cond_free, &mutex_pool);
+    }
+    Conexion *connection = free_connections[--n_free];
+    pthread_mutex_unlock(&mutex_pool);
+    return connection;
+}
+
+void release_connection(Conexion *connection){
+    pthread_mutex_lock(&mutex_pool);
+    free_connections[n_free++] = connection;
+    pthread_cond_signal(&cond_free);
+    pthread_mutex_unlock(&mutex_pool);
+}
+
+void queue_request(Conexion *connection){
+    // There are never more requests queued than slots, so the queue cannot overflow
+    pthread_mutex_lock(&mutex_pool);
+    pending[(first_pending + n_pending++) % max_connections] = connection;
+    pthread_cond_signal(&cond_pending);
+    pthread_mutex_unlock(&mutex_pool);
+}
+
+Conexion *next_request(){
+    pthread_mutex_lock(&mutex_pool);
+    while (n_pending == 0)
+    {
+        pthread_cond_wait(&cond_pending, &mutex_pool);
+    }
+    Conexion *connection = pending[first_pending];
+    first_pending = (first_pending + 1) % max_connections;
+    n_pending--;
+    pthread_mutex_unlock(&mutex_pool);
+    return connection;
+}
+
+int read_only(int op){
+    // Operations that do not modify the storage (they can run at the same time, under the shared lock)
+    return op == GET_VALUE || op == GET_FIELDS || op == EXIST || op == SCAN || op == AGGREGATE || op == FILTER ||
+           op == KNN || op == GET_BY_VALUE1 || op == PREFIX_VALUE1 || op == STATS || op == GET_VERSIONED ||
+           op == SNAPSHOT || op == RELEASE_SNAPSHOT;
+}
+
+int keyed(int op){
+    // Operations on the tuple of request->key
+    return op == SET_VALUE || op == GET_VALUE || op == GET_FIELDS || op == MODIFY_VALUE || op == DELETE_KEY ||
+           op == EXIST || op == GET_VERSIONED;
+}
+
+int keep_tuple(int key, Escritura *before){
+    // Read the tuple of key before writing it, if a snapshot may need it (kind is TXN_DELETE if the key does not
+    // exist); returns 1 if it has been read
+    if (instantaneas_count() == 0){
+        return 0;
+    }
+    before->kind = engine->get_value(key, before->value1, &before->N_value2, before->V_value2) == 0 ? TXN_PUT : TXN_DELETE;
+    return 1;
+}
+
+void key_written(int key, Escritura *before, int kept){
+    // A write of key has succeeded: it gets a new version, and the snapshots open keep the tuple it replaced
+    if (version_bump(key) < 0){
+        LOG_PERROR("Error setting the version");
+    }
+    if (kept && instantanea_record(key, version_get(key), before->kind == TXN_PUT, before->value1, before->N_value2,
+                                   before->V_value2) < 0){
+        LOG_PERROR("Error keeping the tuple for the snapshots");
+    }
+}
+
+void expire_key(int key, long *counter){
+    // Delete the tuple of key if its TTL has passed (with the exclusive lock of the storage)
+    if (rueda_ttl_expired(key)){
+        Escritura before;
+        int kept = keep_tuple(key, &before);
+        engine->delete_key(key);
+        rueda_ttl_remove(key);
+        key_written(key, &before, kept);
+        __atomic_add_fetch(counter, 1, __ATOMIC_RELAXED);
+    }
+}
+
+LecturaEnCurso *in_flight_slot(int key){
+    return &in_flight[tabla_enteros_hash(key) % COALESCE_SLOTS];
+}
+
+int coalesce_lead(int key){
+    // Announce that the storage is being read for key (with the lock taken), returns 0 if the slot is busy
+    LecturaEnCurso *slot = in_flight_slot(key);
+    pthread_mutex_lock(&slot->mutex);
+    int lead = !slot->active;
+    if (lead){
+        slot->active = 1;
+        slot->key = key;
+        slot->waiters = NULL;
+    }
+    pthread_mutex_unlock(&slot->mutex);
+    return lead;
+}
+
+Conexion *coalesce_end(int key){
+    // End the read of key (before releasing the lock) and return the requests that joined it
+    LecturaEnCurso *slot = in_flight_slot(key);
+    pthread_mutex_lock(&slot->mutex);
+    Conexion *waiters = slot->waiters;
+    slot->active = 0;
+    pthread_mutex_unlock(&slot->mutex);
+    return waiters;
+}
+
+int coalesce_join(Conexion *connection){
+    // Join the read of the key of a GET_VALUE in flight, returns 0 if there is none
+    Request *request = &connection->request;
+    LecturaEnCurso *slot = in_flight_slot(request->key);
+    pthread_mutex_lock(&slot->mutex);
+    int joined = slot->active && slot->key == request->key;
+    if (joined){
+        if (slow_log != NULL){
+            request->lock_wait = request->locked = request->processed = now_ns();
+        }
+        connection->next_waiter = slot->waiters;
+        slot->waiters = connection;
+    }
+    pthread_mutex_unlock(&slot->mutex);
+    return joined;
+}
+
+void send_waiters(Conexion *waiters, char *response_buffer, int failed){
+    // Send the response of a GET_VALUE to the requests that joined its read, and release their slots
+    while (waiters != NULL)
+    {
+        Conexion *next = waiters->next_waiter;
+        estadisticas_queue(-1);
+        if (sendMessage(waiters->request.client_sd, response_buffer, strlen(response_buffer) + 1) == -1){
+            LOG_PERROR("Error sending the response");
+            finish_request(&waiters->request, 1, -1);
+        } else {
+            finish_request(&waiters->request, failed, 0);
+        }
+        __atomic_add_fetch(&coalesced, 1, __ATOMIC_RELAXED);
+        release_connection(waiters);
+        waiters = next;
+    }
+}
+
+void lock_storage_for(int op, int key){
+    // Take the shared lock for the read-only operations and the exclusive one for the rest
+    // Some reads of the engine may need to write (the text engine rebuilds its indexes if the file has changed,
+    // or loads again an evicted tuple), and so does a read of a key whose TTL has passed (it is deleted first):
+    // in those cases the exclusive lock is taken instead
+    if (read_only(op)){
+        take_storage(1);
+        if ((op == STATS || engine->shared_read(op, key)) && !(keyed(op) && rueda_ttl_expired(key))){
+            return;
+        }
+        pthread_rwlock_unlock(&lock_storage);
+    }
+    take_storage(0);
+    if (keyed(op)){
+        expire_key(key, &ttl_expired_lazy);
+    }
+}
+
+void *expire_keys(void *arg){
+    // Delete the keys whose TTL has passed, as the timer wheel reaches them (one key per exclusive lock, so that
+    // the requests are not held back by a burst of expirations)
+    int keys[EXPIRE_BATCH];
+    while (1)
+    {
+        int n = rueda_ttl_advance(keys, EXPIRE_BATCH);
+        for (int i = 0; i < n; i++)
+        {
+            take_storage(0);
+            expire_key(keys[i], &ttl_expired_background);
+            pthread_rwlock_unlock(&lock_storage);
+        }
+        if (n < EXPIRE_BATCH){
+            usleep(RUEDA_TTL_TICK_MS * 1000);
+        }
+    }
+    return NULL;
+}
+
+int apply_write(Escritura *write){
+    // Apply a write of a transaction (with the exclusive lock of the storage)
+    int exists = engine->exist(write->key);
+    if (exists < 0){
+        return -1;
+    }
+    if (write->kind == TXN_DELETE){
+        return exists ? engine->delete_key(write->key) : 0;
+    }
+    if (exists){
+        return engine->modify_value(write->key, write->value1, write->N_value2, write->V_value2);
+    }
+    return engine->set_value(write->key, write->value1, write->N_value2, write->V_value2);
+}
+
+int apply_transaction(Transaccion *txn){
+    // Validate the read set and apply the write set of a transaction, with the exclusive lock of the storage
+    // (taken only for this, the client read the keys before without locking anything)
+    // Returns 0 if it has been applied, 1 if a key read has been written since (nothing is applied) and -1 on
+    // error (the writes applied are undone)
+    for (int i = 0; i < txn->N_reads; i++)
+    {
+        expire_key(txn->read_keys[i], &ttl_expired_lazy);
+        if (version_get(txn->read_keys[i]) != txn->read_versions[i]){
+            return 1;
+        }
+    }
+    if (txn->N_writes == 0){
+        return 0;
+    }
+
+    // Keep the tuples written, to restore them if a write fails
+    Escritura *before = malloc(txn->N_writes * sizeof(Escritura));
+    if (before == NULL){
+        LOG_PERROR("Error allocating memory");
+        return -1;
+    }
+    for (int i = 0; i < txn->N_writes; i++)
+    {
+        Escritura *write = &txn->writes[i];
+        expire_key(write->key, &ttl_expired_lazy);
+        before[i].key = write->key;
+        before[i].kind = engine->get_value(write->key, before[i].value1, &before[i].N_value2, before[i].V_value2) == 0 ?
+                         TXN_PUT : TXN_DELETE;
+    }
+    for (int i = 0; i < txn->N_writes; i++)
+    {
+        if (apply_write(&txn->writes[i]) < 0){
+            for (int j = i; j >= 0; j--)
+            {
+                apply_write(&before[j]);
+            }
+            free(before);
+            return -1;
+        }
+    }
+
+    // The tuples written get a new version and lose their TTL, like with set_value and modify_value
+    int kept = instantaneas_count() > 0;
+    for (int i = 0; i < txn->N_writes; i++)
+    {
+        rueda_ttl_remove(txn->writes[i].key);
+        key_written(txn->writes[i].key, &before[i], kept);
+    }
+    free(before);
+    return 0;
+}
+
+int format_stats(char *response_buffer){
+    // Format the statistics (STATS)
+    // The response is as follows:
+    // 0 uptime active_connections queue_depth malformed N_ops
+    //   requests_0 failed_0 mean_0 p50_0 p90_0 p99_0 p999_0 max_0 ... (one group for each operation code, latencies in us)
+    Estadisticas *stats = malloc(sizeof(Estadisticas));
+    if (stats == NULL){
+        LOG_PERROR("Error allocating memory");
+        return sprintf(response_buffer, "-1");
+    }
+    estadisticas_snapshot(stats);
+
+    int len = sprintf(response_buffer, "0 %.3f %ld %ld %ld %d", stats->uptime, stats->active_connections,
+                      stats->queue_depth, stats->malformed, stats->n_ops);
+    for (int op = 0; op < stats->n_ops; op++)
+    {
+        Histograma *h = &stats->ops[op].latency;
+        len += sprintf(response_buffer + len, " %lu %ld %.1f %.1f %.1f %.1f %.1f %.1f", (unsigned long)h->total,
+                       stats->ops[op].failed, histograma_mean(h) / 1e3, histograma_percentile(h, 50) / 1e3,
+                       histograma_percentile(h, 90) / 1e3, histograma_percentile(h, 99) / 1e3,
+                       histograma_percentile(h, 99.9) / 1e3, h->max / 1e3);
+    }
+    free(stats);
+    return len;
+}
+
+int format_engine(char *buffer, int size){
+    // Metrics of the storage engine, one per line like the statistics, of the keys with a TTL, of the
+    // GET_VALUE coalesced and of the snapshots
+    take_storage(1);
+    int len = engine->stats(buffer, size);
+    pthread_rwlock_unlock(&lock_storage);
+    if (len < size){
+        len += snprintf(buffer + len, size - len, "tuplas_ttl_keys %ld\n"
+                        "tuplas_ttl_expired_total{path=\"lazy\"} %ld\n"
+                        "tuplas_ttl_expired_total{path=\"background\"} %ld\n"
+                        "tuplas_get_coalesced_total %ld\n"
+                        "tuplas_snapshots_open %d\n"
+                        "tuplas_snapshot_versions_kept %ld\n", rueda_ttl_count(),
+                        __atomic_load_n(&ttl_expired_lazy, __ATOMIC_RELAXED),
+                        __atomic_load_n(&ttl_expired_background, __ATOMIC_RELAXED),
+                        __atomic_load_n(&coalesced, __ATOMIC_RELAXED), instantaneas_count(), instantaneas_kept());
+    }
+    return len < size ? len : size - 1;
+}
+
+char *dump_metrics(){
+    // Text with the current statistics (allocated with malloc), or NULL on error
+    Estadisticas *stats = malloc(sizeof(Estadisticas));
+    char *text = malloc(METRICS_SIZE);
+    if (stats == NULL || text == NULL){
+        LOG_PERROR("Error allocating memory");
+        free(stats);
+        free(text);
+        return NULL;
+    }
+    estadisticas_snapshot(stats);
+    int len = estadisticas_format(stats, text, METRICS_SIZE);
+    len += format_engine(text + len, METRICS_SIZE - len);
+    if (perf){
+        format_perf(text + len, METRICS_SIZE - len);
+    }
+    free(stats);
+    return text;
+}
+
+void *write_metrics_file(void *arg){
+    // Rewrite metrics_file every second (through a temporary file, so that readers never see it half written)
+    char temp_name[1024];
+    snprintf(temp_name, sizeof(temp_name), "%s.tmp", metrics_file);
+    while (1)
+    {
+        sleep(1);
+        char *text = dump_metrics();
+        if (text == NULL){
+            continue;
+        }
+        FILE *file = fopen(temp_name, "w");
+        if (file == NULL){
+            LOG_PERROR("Error creating the metrics file");
+        } else {
+            fputs(text, file);
+            fclose(file);
+            rename(temp_name, metrics_file);
+        }
+        free(text);
+    }
+    return NULL;
+}
+
+void *serve_metrics(void *arg){
+    // Serve the metrics on 127.0.0.1:metrics_port (any connection gets the text with a minimal HTTP header)
+    int metrics_sd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (metrics_sd == -1){
+        LOG_PERROR("Error creating the metrics socket");
+        return NULL;
+    }
+    int enable = 1;
+    setsockopt(metrics_sd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    struct sockaddr_in metrics_addr = {0};
+    metrics_addr.sin_family = AF_INET;
+    metrics_addr.sin_port = htons(metrics_port);
+    metrics_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);    // Only local clients
+    if (bind(metrics_sd, (struct sockaddr *)&metrics_addr, sizeof(metrics_addr)) == -1 || listen(metrics_sd, 16) == -1){
+        LOG_PERROR("Error listening on the metrics port");
+        close(metrics_sd);
+        return NULL;
+    }
+
+    while (1)
+    {
+        int sd = accept(metrics_sd, NULL, NULL);
+        if (sd == -1){
+            continue;
+        }
+        char *text = dump_metrics();
+        if (text != NULL){
+            char header[128];
+            int len = sprintf(header, "HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\nContent-Length: %zu\r\n\r\n", strlen(text));
+            sendMessage(sd, header, len);
+            sendMessage(sd, text, strlen(text));
+            free(text);
+        }
+        close(sd);
+    }
+    return NULL;
+}
+
+void format_fields(char *response_buffer, Request *request, Response *response){
+    // Format only the fields selected by request->mask (GET_FIELDS)
+    // The response is as follows:
+    // error_code [value1] [N_value2] [N_slice V_value2[first] ... V_value2[first + N_slice - 1]]
+
+    int len = sprintf(response_buffer, "%d", response->res);
+
+    // If the key was not found, only the error code is sent
+    if (response->res == -1){
+        return;
+    }
+
+    if (request->mask & FIELD_VALUE1){
+        len += sprintf(response_buffer + len, " %s", response->value1);
+    }
+    if (request->mask & FIELD_N_VALUE2){
+        len += sprintf(response_buffer + len, " %d", response->N_value2);
+    }
+    if (request->mask & FIELD_V_VALUE2){
+        // Clamp the slice [first, first + count) to the elements stored
+        int first = request->first < response->N_value2 ? request->first : response->N_value2;
+        int last = response->N_value2;
+        // count comes from the client: compare it with the elements left instead of adding it (it may overflow)
+        if (request->count >= 0 && request->count < last - first){
+            last = first + request->count;
+        }
+
+        len += sprintf(response_buffer + len, " %d", last - first);
+        for (int i = first; i < last; i++)
+        {
+            response_buffer[len++] = ' ';
+            len += dobles_format(response->V_value2[i], response_buffer + len);
+        }
+    }
+}
+
+int send_keys(int client_sd, int *keys, int N_keys){
+    // Send a list of keys as a stream of lines of at most SCAN_CHUNK keys each:
+    // N_chunk key_0 ... key_(N_chunk - 1)\n
+    char response_buffer[16 + SCAN_CHUNK * 12];
+
+    for (int sent = 0; sent < N_keys; sent += SCAN_CHUNK)
+    {
+        int n = N_keys - sent < SCAN_CHUNK ? N_keys - sent : SCAN_CHUNK;
+        int len = sprintf(response_buffer, "%d", n);
+        for (int i = 0; i < n; i++)
+        {
+            len += sprintf(response_buffer + len, " %d", keys[sent + i]);
+        }
+        response_buffer[len++] = '\n';
+
+        if (sendMessage(client_sd, response_buffer, len) == -1){
+            LOG_PERROR("Error sending the response");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int send_keys_end(int client_sd, int res, int more, int cursor){
+    // Send the end of a stream of keys:
+    // 0 error_code more next_cursor
+    char response_buffer[64];
+
+    sprintf(response_buffer, "0 %d %d %d", res, more, cursor);
+    if (sendMessage(client_sd, response_buffer, strlen(response_buffer) + 1) == -1){
+        LOG_PERROR("Error sending the response");
+        return -1;
+    }
+    return 0;
+}
+
+int aggregate_snapshot(Request *request, Agregado *agg){
+    // Aggregate the tuples of the snapshot request->snapshot (AGGREGATE), in chunks of keys: the lock is only held
+    // while each chunk is read, and the writes that run in between keep the tuples they replace for the snapshot
+    int keys[SCAN_CHUNK];
+    char value1[MAX];
+    int N_value2;
+    double V_value2[32];
+    int start_key = INT_MIN;
+    if (request->element < -1 || request->element > 31){
+        return -1;
+    }
+    agregado_init(agg);
+    while (1)
+    {
+        // The text engine may have to rebuild its indexes or load evicted tuples, which needs the exclusive lock
+        uint64_t seq;
+        take_storage(1);
+        if (instantanea_seq(request->snapshot, &seq) < 0){
+            pthread_rwlock_unlock(&lock_storage);
+            return -1;
+        }
+        int shared = engine->shared_read(SCAN, 0);
+        int n = shared ? instantanea_scan_keys(engine, seq, start_key, INT_MAX, SCAN_CHUNK, keys) : 0;
+        for (int i = 0; i < n && shared; i++)
+        {
+            shared = engine->shared_read(GET_VALUE, keys[i]);
+        }
+        if (!shared){
+            pthread_rwlock_unlock(&lock_storage);
+            take_storage(0);
+            n = instantanea_scan_keys(engine, seq, start_key, INT_MAX, SCAN_CHUNK, keys);
+        }
+        for (int i = 0; i < n; i++)
+        {
+            if (instantanea_get_value(engine, seq, keys[i], value1, &N_value2, V_value2) < 0 ||
+                request->element >= N_value2){
+                continue;
+            }
+            if (request->element >= 0){
+                agregado_vector(agg, V_value2 + request->element, 1);
+            } else {
+                agregado_vector(agg, V_value2, N_value2);
+            }
+        }
+        pthread_rwlock_unlock(&lock_storage);
+
+        if (n < 0){
+            return -1;
+        }
+        if (n < SCAN_CHUNK || keys[n - 1] == INT_MAX){
+            return 0;
+        }
+        start_key = keys[n - 1] + 1;
+    }
+}
+
+int process_scan(Request *request){
+    // Stream the keys in [max(key, cursor), end_key] to the client, at most limit of them
+    // The response is as follows:
+    // N_chunk key_0 ... key_(N_chunk - 1)\n     (one line for each chunk of at most SCAN_CHUNK keys)
+    // ...
+    // 0 error_code more next_cursor            (end of the stream)
+    // The lock is only held while each chunk is read from the index, never while sending
+
+    int keys[SCAN_CHUNK];
+    int start_key = request->cursor > request->key ? request->cursor : request->key;
+    int remaining = request->limit;
+    int res = 0;
+    int more = 0;
+
+    while (remaining > 0 && start_key <= request->end_key)
+    {
+        int chunk = remaining < SCAN_CHUNK ? remaining : SCAN_CHUNK;
+
+        lock_storage_for(SCAN, 0);
+        int n;
+        uint64_t seq;
+        if (request->snapshot == 0){
+            n = engine->scan_keys(start_key, request->end_key, chunk, keys);
+        } else if (instantanea_seq(request->snapshot, &seq) == 0){
+            n = instantanea_scan_keys(engine, seq, start_key, request->end_key, chunk, keys);
+        } else {
+            n = -1;     // The snapshot is not open
+        }
+        pthread_rwlock_unlock(&lock_storage);
+
+        if (n < 0){
+            res = -1;
+            break;
+        }
+        if (n == 0){
+            break;
+        }
+
+        if (send_keys(request->client_sd, keys, n) == -1){
+            return -1;
+        }
+
+        remaining -= n;
+        if (n < chunk || keys[n - 1] == request->end_key){
+            break;  // There are no more keys in the range
+        }
+        start_key = keys[n - 1] + 1;
+        more = remaining == 0;  // The limit has been reached, the client may resume from start_key
+    }
+
+    return send_keys_end(request->client_sd, res, more, start_key);
+}
+
+int process_request(Worker *worker, Request *request){
     // Process the request (do the operations stated in the request and send the response)
+    // The buffers are the ones of the worker, so nothing is allocated for GET, SET, etc.
 
-    char response_buffer[10695];    // Buffer for the response
+    char *response_buffer = worker->response_buffer;
+    Response *response = &worker->response;
+    Agregado *aggregate = &worker->aggregate;
+    int *knn_keys = worker->knn_keys;
+    double *knn_distances = worker->knn_distances;
+    int *found_keys = NULL;     // Result of FILTER, GET_BY_VALUE1 and PREFIX_VALUE1 (allocated with malloc)
+    int coalescing;             // Other GET_VALUE of the key can join the read of this one
+    Conexion *waiters = NULL;   // GET_VALUE that joined the read of this one
+    Escritura before;           // Tuple replaced by SET_VALUE, MODIFY_VALUE and DELETE_KEY (for the snapshots)
+    int kept = 0;
 
-    // Lock the mutex
-    pthread_mutex_lock(&mutex_message);
-    
-    Response response;
-    // Copy the request to have a local copy of it
-    Request request_copy = *request;
+    // Lock the storage (the requests queued or waiting for it are the queue depth of the statistics)
+    // The phases are only timed with the slow-request log
+    if (slow_log != NULL){
+        request->lock_wait = now_ns();
+    }
+    lock_storage_for(request->op, request->key);
+    estadisticas_queue(-1);
+    if (slow_log != NULL){
+        request->locked = now_ns();
+    }
+
+    // Counters of this thread around the storage call
+    LecturaPerf perf_start, perf_end;
+    if (perf){
+        perf_read(&worker->perf, &perf_start);
+    }
+
+    if (request->op == SET_VALUE || request->op == MODIFY_VALUE || request->op == DELETE_KEY){
+        kept = keep_tuple(request->key, &before);
+    }
 
     // Process the request
-    switch (request_copy.op)
+    switch (request->op)
     {
         case INIT:
-            response.res = init();
+            response->res = engine->init();
             break;
         case SET_VALUE:
-            response.res = set_value(request_copy.key, request_copy.value1, request_copy.N_value2, request_copy.V_value2);
+            response->res = engine->set_value(request->key, request->value1, request->N_value2, request->V_value2);
             break;
         case GET_VALUE:
-            // Note: get_value() modifies response.value1, response.N_value and response.V_value2
-            response.res = get_value(request_copy.key, response.value1, &response.N_value2, response.V_value2);
+        case GET_FIELDS:
+            // Note: get_value() modifies response->value1, response->N_value and response->V_value2
+            // (GET_FIELDS only sends back the fields selected by request->mask)
+            coalescing = request->op == GET_VALUE && coalesce_lead(request->key);
+            response->res = engine->get_value(request->key, response->value1, &response->N_value2, response->V_value2);
+            if (coalescing){
+                waiters = coalesce_end(request->key);
+            }
             break;
         case MODIFY_VALUE:
-            response.res = modify_value(request_copy.key, request_copy.value1, request_copy.N_value2, request_copy.V_value2);
+            response->res = engine->modify_value(request->key, request->value1, request->N_value2, request->V_value2);
             break;
         case DELETE_KEY:
-            response.res = delete_key(request_copy.key);
+            response->res = engine->delete_key(request->key);
             break;
         case EXIST:
-            response.res = exist(request_copy.key);
+            response->res = engine->exist(request->key);
+            break;
+        case SCAN:
+            // The keys are read and sent in chunks by process_scan(), once the lock has been released
+            break;
+        case AGGREGATE:
+            // In a snapshot the tuples are aggregated in chunks by aggregate_snapshot(), once the lock has been
+            // released
+            if (request->snapshot == 0){
+                response->res = engine->aggregate_values(request->element, aggregate);
+            }
+            break;
+        case FILTER:
+            // Note: response->res is the number of keys found (or -1)
+            response->res = engine->filter_keys(request->element, request->cmp, request->threshold, &found_keys);
+            break;
+        case GET_BY_VALUE1:
+            // Note: response->res is the number of keys found (or -1)
+            response->res = engine->get_by_value1(request->value1, &found_keys);
+            break;
+        case PREFIX_VALUE1:
+            // Note: response->res is the number of keys found (or -1)
+            response->res = engine->prefix_value1(request->value1, request->limit, &found_keys);
+            break;
+        case KNN:
+            // Note: response->res is the number of neighbours found (or -1)
+            response->res = engine->knn_search(request->limit, request->metric, request->N_value2, request->V_value2, knn_keys, knn_distances);
+            break;
+        case STATS:
+            // The statistics do not need the storage, they are formatted once the lock has been released
+            response->res = 0;
+            break;
+        case GET_VERSIONED:
+            response->res = engine->get_value(request->key, response->value1, &response->N_value2, response->V_value2);
+            response->version = version_get(request->key);
+            break;
+        case TRANSACTION:
+            // Note: response->res is 1 if the transaction has been rejected because of a conflict
+            response->res = apply_transaction(request->txn);
+            break;
+        case SNAPSHOT:
+            // No write can run while the lock is shared, so the last version is the state of the whole store
+            response->snapshot = instantanea_open(versiones_last());
+            response->res = response->snapshot < 0 ? -1 : 0;
+            break;
+        case RELEASE_SNAPSHOT:
+            response->res = instantanea_release(request->snapshot);
             break;
         default:
-            response.res = -1;
+            response->res = -1;
             break;
     }
 
+    // TTL of the key (kept only in the memory of the server): a set or modify without TTL clears it
+    if (response->res == 0){
+        if ((request->op == SET_VALUE || request->op == MODIFY_VALUE) && request->ttl > 0){
+            if (rueda_ttl_set(request->key, request->ttl) < 0){
+                LOG_PERROR("Error setting the TTL");
+            }
+        } else if (request->op == SET_VALUE || request->op == MODIFY_VALUE || request->op == DELETE_KEY){
+            rueda_ttl_remove(request->key);
+        } else if (request->op == INIT){
+            rueda_ttl_clear();
+        }
+    }
+
+    // Version of the key, for the transactions, and the tuple it replaced, for the snapshots
+    if (response->res == 0){
+        if (request->op == SET_VALUE || request->op == MODIFY_VALUE || request->op == DELETE_KEY){
+            key_written(request->key, &before, kept);
+        } else if (request->op == INIT){
+            versiones_clear();
+            instantaneas_clear();
+        }
+    }
+    if (!read_only(request->op)){
+        instantaneas_reclaim();
+    }
+
+    if (slow_log != NULL){
+        request->processed = now_ns();
+    }
+    if (perf){
+        perf_read(&worker->perf, &perf_end);
+        if (request->op >= 0 && request->op < STATS_MAX_OPS){
+            pthread_mutex_lock(&mutex_perf);
+            perf_acc_add(&perf_storage[request->op], &perf_start, &perf_end);
+            pthread_mutex_unlock(&mutex_perf);
+        }
+    }
+
+    pthread_rwlock_unlock(&lock_storage);
 
-    processed_request = 1;
-    pthread_cond_signal(&cond_message);
-    pthread_mutex_unlock(&mutex_message);
+    if (request->op == TRANSACTION){
+        free(request->txn);
+        request->txn = NULL;
+    }
+
+    if (request->op == AGGREGATE && request->snapshot != 0){
+        response->res = aggregate_snapshot(request, aggregate);
+    }
+
+    if (request->op == SCAN){
+        int res = process_scan(request);
+        return finish_request(request, res < 0, res);
+    }
+
+    if (request->op == FILTER || request->op == GET_BY_VALUE1 || request->op == PREFIX_VALUE1){
+        // Stream the keys found, like a SCAN
+        int res = 0;
+        if (response->res >= 0){
+            res = send_keys(request->client_sd, found_keys, response->res);
+            free(found_keys);
+        }
+        if (res == 0){
+            res = send_keys_end(request->client_sd, response->res < 0 ? -1 : 0, 0, 0);
+        }
+        return finish_request(request, response->res < 0 || res < 0, res);
+    }
 
     // Parse the response to the buffer
-    if (request_copy.op == GET_VALUE){
+    if (request->op == GET_VALUE){
         // Copy the error code, value1 and N_value2 to the buffer
-        sprintf(response_buffer, "%d %s %d", response.res, response.value1, response.N_value2);
+        int len = sprintf(response_buffer, "%d %s %d", response->res, response->value1, response->N_value2);
 
         // Add the values of the vector V_value2 to the buffer next to the N_value2
-        for (int i = 0; i < response.N_value2; i++)
+        for (int i = 0; i < response->N_value2; i++)
         {
-            sprintf(response_buffer + strlen(response_buffer), " %lf", response.V_value2[i]);
+            response_buffer[len++] = ' ';
+            len += dobles_format(response->V_value2[i], response_buffer + len);
         }
+    } else if (request->op == AGGREGATE && response->res == 0){
+        // error_code count sum min max (min and max are 0 if there are no elements)
+        if (aggregate->count == 0){
+            aggregate->min = aggregate->max = 0.0;
+        }
+        int len = sprintf(response_buffer, "%d %ld", response->res, aggregate->count);
+        double values[3] = {aggregate->sum, aggregate->min, aggregate->max};
+        for (int i = 0; i < 3; i++)
+        {
+            response_buffer[len++] = ' ';
+            len += dobles_format(values[i], response_buffer + len);
+        }
+    } else if (request->op == KNN && response->res >= 0){
+        // 0 N_found key_0 distance_0 ... key_(N_found - 1) distance_(N_found - 1)
+        int len = sprintf(response_buffer, "0 %d", response->res);
+        for (int i = 0; i < response->res; i++)
+        {
+            len += sprintf(response_buffer + len, " %d ", knn_keys[i]);
+            len += dobles_format(knn_distances[i], response_buffer + len);
+        }
+    } else if (request->op == GET_VERSIONED){
+        // error_code version [value1 N_value2 V_value2[0] ... V_value2[N_value2 - 1]] (the version also if the key
+        // does not exist, so that its absence can be part of the read set of a transaction)
+        int len = sprintf(response_buffer, "%d %llu", response->res, (unsigned long long)response->version);
+        if (response->res == 0){
+            len += sprintf(response_buffer + len, " %s %d", response->value1, response->N_value2);
+            for (int i = 0; i < response->N_value2; i++)
+            {
+                response_buffer[len++] = ' ';
+                len += dobles_format(response->V_value2[i], response_buffer + len);
+            }
+        }
+    } else if (request->op == SNAPSHOT && response->res == 0){
+        sprintf(response_buffer, "0 %ld", response->snapshot);
+    } else if (request->op == GET_FIELDS){
+        format_fields(response_buffer, request, response);
+    } else if (request->op == STATS){
+        format_stats(response_buffer);
     } else {
-        sprintf(response_buffer, "%d", response.res);
+        sprintf(response_buffer, "%d", response->res);
     }
 
-    // Send the response
-    if (sendMessage(request_copy.client_sd, response_buffer, strlen(response_buffer) + 1) == -1){
-        perror("Error sending the response\n");
-        return -1;
+    // Send the response (and the same one to the GET_VALUE that joined the read)
+    int sent = sendMessage(request->client_sd, response_buffer, strlen(response_buffer) + 1);
+    send_waiters(waiters, response_buffer, response->res < 0);
+    if (sent == -1){
+        LOG_PERROR("Error sending the response");
+        return finish_request(request, 1, -1);
     }
 
+    // Close the connection with the client (one request per connection)
+    return finish_request(request, response->res < 0, 0);
+}
+
+int parse_transaction(char **tokens, int n_tokens, Request *request){
+    // op N_reads key_0 version_0 ... N_writes kind_0 key_0 [value1_0 N_value2_0 V_value2_0[0] ...] ...
+    // (a TXN_DELETE write has only the kind and the key)
+    Transaccion *txn = malloc(sizeof(Transaccion));
+    if (txn == NULL){
+        LOG_PERROR("Error allocating memory");
+        return -1;
+    }
+    int t = 1;
+    if (t >= n_tokens || (txn->N_reads = atoi(tokens[t++])) < 0 || txn->N_reads > TXN_MAX_KEYS ||
+        t + 2 * txn->N_reads >= n_tokens){
+        free(txn);
+        return -1;
+    }
+    for (int i = 0; i < txn->N_reads; i++)
+    {
+        txn->read_keys[i] = atoi(tokens[t++]);
+        txn->read_versions[i] = strtoull(tokens[t++], NULL, 10);
+    }
+    if ((txn->N_writes = atoi(tokens[t++])) < 0 || txn->N_writes > TXN_MAX_KEYS){
+        free(txn);
+        return -1;
+    }
+    for (int i = 0; i < txn->N_writes; i++)
+    {
+        Escritura *write = &txn->writes[i];
+        if (t + 2 > n_tokens){
+            free(txn);
+            return -1;
+        }
+        write->kind = atoi(tokens[t++]);
+        write->key = atoi(tokens[t++]);
+        if (write->kind == TXN_DELETE){
+            continue;
+        }
+        if (write->kind != TXN_PUT || t + 2 > n_tokens || strlen(tokens[t]) >= MAX){
+            free(txn);
+            return -1;
+        }
+        strcpy(write->value1, tokens[t++]);
+        write->N_value2 = atoi(tokens[t++]);
+        if (write->N_value2 < 1 || write->N_value2 > 32 || t + write->N_value2 > n_tokens){
+            free(txn);
+            return -1;
+        }
+        for (int j = 0; j < write->N_value2; j++)
+        {
+            write->V_value2[j] = dobles_parse(tokens[t++], NULL);
+        }
+    }
+    if (t != n_tokens){
+        free(txn);
+        return -1;
+    }
+    request->txn = txn;
     return 0;
 }
 
 int parse_request(char *buffer, Request *request){
     // Parse the request from the buffer
     // printf("Parsing request\n");
-    char *token;
-    int i = 0;
-
-    // Get the first token
-    token = strtok(buffer, " ");
-    while (token != NULL)
-    {   
-        if (token[0] != '\0') {
-            // printf("i: %d, token: %s\n", i, token);
-            switch (i)
+    // The longest request is a TRANSACTION: op, N_reads, the keys read with their versions, N_writes and the
+    // writes (kind, key, value1, N_value2 and up to 32 doubles each)
+    char *tokens[3 + 2 * TXN_MAX_KEYS + TXN_MAX_KEYS * (4 + 32)];
+
+    // Split the buffer into tokens separated by spaces (more tokens than the longest request is malformed)
+    int n_tokens = tokenizar(buffer, strlen(buffer), tokens, sizeof(tokens) / sizeof(tokens[0]));
+
+    if (n_tokens <= 0){
+        return -1;
+    }
+
+    // The first token is the operation code, the meaning of the rest depends on it
+    request->op = atoi(tokens[0]);
+    request->key = n_tokens > 1 ? atoi(tokens[1]) : 0;
+
+    switch (request->op)
+    {
+        case TRANSACTION:
+            return parse_transaction(tokens, n_tokens, request);
+        case SCAN:
+            // op start_key end_key limit cursor [snapshot]
+            if (n_tokens != 5 && n_tokens != 6){
+                return -1;
+            }
+            request->end_key = atoi(tokens[2]);
+            request->limit = atoi(tokens[3]);
+            request->cursor = atoi(tokens[4]);
+            request->snapshot = n_tokens == 6 ? atol(tokens[5]) : 0;
+            if (request->limit < 1 || (n_tokens == 6 && request->snapshot < 1)){
+                return -1;
+            }
+            break;
+        case AGGREGATE:
+            // op element [snapshot]
+            if (n_tokens != 2 && n_tokens != 3){
+                return -1;
+            }
+            request->element = atoi(tokens[1]);
+            request->snapshot = n_tokens == 3 ? atol(tokens[2]) : 0;
+            if (n_tokens == 3 && request->snapshot < 1){
+                return -1;
+            }
+            break;
+        case SNAPSHOT:
+            // op
+            if (n_tokens != 1){
+                return -1;
+            }
+            break;
+        case RELEASE_SNAPSHOT:
+            // op snapshot
+            if (n_tokens != 2){
+                return -1;
+            }
+            request->snapshot = atol(tokens[1]);
+            break;
+        case FILTER:
+            // op element cmp threshold
+            if (n_tokens != 4){
+                return -1;
+            }
+            request->element = atoi(tokens[1]);
+            request->cmp = atoi(tokens[2]);
+            request->threshold = dobles_parse(tokens[3], NULL);
+            break;
+        case KNN:
+            // op k metric N_value2 V_value2[0] ... V_value2[N_value2 - 1]
+            if (n_tokens < 5){
+                return -1;
+            }
+            request->limit = atoi(tokens[1]);
+            request->metric = atoi(tokens[2]);
+            request->N_value2 = atoi(tokens[3]);
+            if (request->N_value2 < 1 || request->N_value2 > 32 || n_tokens != 4 + request->N_value2){
+                return -1;
+            }
+            for (int i = 0; i < request->N_value2; i++)
             {
-                case 0: // The first token is the operation code
-                    request->op = atoi(token);
-                    break;
-                case 1: // The second token is the key
-                    request->key = atoi(token);
-                    break;
-                case 2: // ...
-                    strcpy(request->value1, token);
-                    break;
-                case 3:
-                    request->N_value2 = atoi(token);
-                    break;
-                default:
-                    request->V_value2[i - 4] = atof(token); // -4 to start from 0
-                    break;
+                request->V_value2[i] = dobles_parse(tokens[4 + i], NULL);
             }
-        }
-        i++;
-        token = strtok(NULL, " ");
+            break;
+        case GET_BY_VALUE1:
+            // op value1
+            if (n_tokens != 2 || strlen(tokens[1]) >= MAX){
+                return -1;
+            }
+            strcpy(request->value1, tokens[1]);
+            break;
+        case PREFIX_VALUE1:
+            // op prefix limit
+            if (n_tokens != 3 || strlen(tokens[1]) >= MAX){
+                return -1;
+            }
+            strcpy(request->value1, tokens[1]);
+            request->limit = atoi(tokens[2]);
+            break;
+        case STATS:
+            // op
+            if (n_tokens != 1){
+                return -1;
+            }
+            break;
+        case GET_FIELDS:
+            // op key mask first count
+            if (n_tokens != 5){
+                return -1;
+            }
+            request->mask = atoi(tokens[2]);
+            request->first = atoi(tokens[3]);
+            request->count = atoi(tokens[4]);
+            if (request->mask <= 0 || request->first < 0){
+                return -1;
+            }
+            break;
+        case SET_VALUE:
+        case MODIFY_VALUE:
+            // op key value1 N_value2 V_value2[0] ... V_value2[N_value2 - 1] [ttl]
+            if (n_tokens < 4 || strlen(tokens[2]) >= MAX){
+                return -1;
+            }
+            strcpy(request->value1, tokens[2]);
+            request->N_value2 = atoi(tokens[3]);
+            if (request->N_value2 < 1 || request->N_value2 > 32 ||
+                (n_tokens != 4 + request->N_value2 && n_tokens != 5 + request->N_value2)){
+                return -1;
+            }
+            for (int i = 0; i < request->N_value2; i++)
+            {
+                request->V_value2[i] = dobles_parse(tokens[4 + i], NULL);
+            }
+            request->ttl = 0;
+            if (n_tokens == 5 + request->N_value2){
+                request->ttl = atoi(tokens[4 + request->N_value2]);
+                if (request->ttl < 1){
+                    return -1;
+                }
+            }
+            break;
+        default:
+            // op [key]
+            break;
     }
     // printf("Request parsed\n");
     return 0;
 }
 
 
+void *run_worker(void *arg){
+    // Process the requests queued by the main thread, one at a time
+    Worker *worker = arg;
+    if (perf){
+        perf_open(&worker->perf);
+    }
+    while (1)
+    {
+        Conexion *connection = next_request();
+        if (connection->request.op == GET_VALUE && coalesce_join(connection)){
+            // The worker reading the key sends the response and releases the slot
+            continue;
+        }
+        process_request(worker, &connection->request);
+        release_connection(connection);
+    }
+    return NULL;
+}
+
+
+void usage(char *program){
+    printf("Usage: %s <port> [options]\n", program);
+    printf("Options:\n");
+    printf("  --value1-index        maintain a secondary index over value1 (GET_BY_VALUE1, PREFIX_VALUE1)\n");
+    printf("  --tuple-cache <MiB>   memory for the tuples cached by the text engine (not its key, vector and value1\n");
+    printf("                        indexes), the least recently used are evicted (default no limit)\n");
+    printf("  --engine <name>       storage engine: text (file %s), memory or lsm (directory %s) (default text)\n",
+           motor_find("text")->default_path, motor_find("lsm")->default_path);
+    printf("  --storage <path>      file or directory where the engine stores the tuples\n");
+    printf("  --capture <file>      record every request with its arrival time in a trace (see replay_trazas)\n");
+    printf("  --metrics-file <file> dump the statistics as plain text to file every second\n");
+    printf("  --metrics-port <port> serve the statistics as plain text on 127.0.0.1:port\n");
+    printf("  --slow-log <file>     log the time spent in each phase of the requests slower than the threshold\n");
+    printf("  --slow-threshold <us> threshold of the slow-request log (default 10000 us)\n");
+    printf("  --log-level <level>   minimum level of the log: debug, info, warn, error or off (default info)\n");
+    printf("  --log-file <file>     write the log to file instead of stderr\n");
+    printf("  --perf                read the perf counters around parse_request() and the storage calls\n");
+    printf("  --workers <n>         number of threads processing the requests (default 8)\n");
+    printf("  --max-connections <n> number of requests read and not yet answered at a time (default 256)\n");
+}
+
 int main(int argc, char *argv[])
 {
+    if (pipe2(stop_pipe, O_NONBLOCK) == -1){
+        perror("Error creating the pipe of the signals\n");
+        return -1;
+    }
     signal (SIGINT, end);
+    signal (SIGTERM, end);
+    signal (SIGPIPE, SIG_IGN);  // A client that closes the connection early must not kill the server
 
     pthread_t thread_id;
     pthread_attr_t t_attr;
@@ -151,15 +1306,142 @@ int main(int argc, char *argv[])
     socklen_t client_addr_len = sizeof(client_addr);    // Length of the client address
     
     char *port;                                     // Server port number
+    char *log_file = NULL;                          // File of the log (stderr if NULL)
+    double tuple_cache = 0.0;                       // Memory of the tuple cache (MiB, 0 if there is no limit)
+
+    // Parse the options
+    engine = motor_find("text");
+    static struct option long_options[] = {
+        {"value1-index", no_argument, NULL, 'v'},   // Maintain the secondary index over value1
+        {"tuple-cache", required_argument, NULL, 'M'},  // Memory budget of the tuple cache of the text engine
+        {"engine", required_argument, NULL, 'e'},       // Storage engine
+        {"storage", required_argument, NULL, 'S'},      // File or directory of the storage engine
+        {"capture", required_argument, NULL, 'c'},  // Record the requests in a trace file
+        {"metrics-file", required_argument, NULL, 'f'}, // Dump the statistics to a file
+        {"metrics-port", required_argument, NULL, 'm'}, // Serve the statistics on a local port
+        {"slow-log", required_argument, NULL, 's'},     // Log the slow requests
+        {"slow-threshold", required_argument, NULL, 't'},   // Threshold of the slow-request log
+        {"log-level", required_argument, NULL, 'l'},    // Minimum level of the log
+        {"log-file", required_argument, NULL, 'o'},     // File of the log
+        {"perf", no_argument, NULL, 'p'},               // Read the perf counters
+        {"workers", required_argument, NULL, 'w'},      // Number of worker threads
+        {"max-connections", required_argument, NULL, 'n'},  // Number of connection slots
+        {0, 0, 0, 0}
+    };
+    int option;
+    while ((option = getopt_long(argc, argv, "", long_options, NULL)) != -1){
+        switch (option){
+            case 'v':
+                enable_value1_index(1);
+                break;
+            case 'M':
+                if ((tuple_cache = atof(optarg)) <= 0.0){
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'e':
+                if ((engine = motor_find(optarg)) == NULL){
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'S':
+                storage_path = optarg;
+                break;
+            case 'c':
+                if (traza_open_write(&trace, optarg) == -1){
+                    return -1;
+                }
+                capture = 1;
+                break;
+            case 'f':
+                metrics_file = optarg;
+                break;
+            case 'm':
+                metrics_port = atoi(optarg);
+                if (metrics_port <= 0 || metrics_port > 65535){
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 's':
+                if ((slow_log = fopen(optarg, "a")) == NULL){
+                    perror("Error opening the slow-request log\n");
+                    return -1;
+                }
+                break;
+            case 't':
+                if (atof(optarg) < 0.0){
+                    usage(argv[0]);
+                    return -1;
+                }
+                slow_threshold = (uint64_t)(atof(optarg) * 1e3);
+                break;
+            case 'l':
+                if ((log_level = log_parse_level(optarg)) == -1){
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'o':
+                log_file = optarg;
+                break;
+            case 'p':
+                perf = 1;
+                break;
+            case 'w':
+                if ((n_workers = atoi(optarg)) < 1){
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'n':
+                if ((max_connections = atoi(optarg)) < 1){
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return -1;
+        }
+    }
 
     // Check the number of arguments
-    if (argc != 2){
-        printf("Incorrect number of arguments. Usage: %s <port>\n", argv[0]);
+    if (optind != argc - 1){
+        printf("Incorrect number of arguments. ");
+        usage(argv[0]);
         return -1;
     }
 
+    // Only the text engine has a tuple cache: the memory engine keeps every tuple and the LSM tree its memtable
+    if (tuple_cache > 0.0 && strcmp(engine->name, "text") != 0){
+        printf("--tuple-cache is only supported by the text engine. ");
+        usage(argv[0]);
+        return -1;
+    }
+    set_max_memory((long)(tuple_cache * 1024 * 1024));
+
     // Get the port number
-    port = argv[1];
+    port = argv[optind];
+
+    // Start the thread that writes the log
+    if (log_init(log_file) == -1){
+        return -1;
+    }
+
+    // Open the storage engine (the LSM tree recovers the writes in its log and starts its compaction thread)
+    if (engine->open(storage_path) == -1){
+        printf("Error opening the %s storage engine\n", engine->name);
+        return -1;
+    }
+
+    // Open the perf counters of the main thread (the processing threads open their own)
+    if (perf && perf_open(&perf_main) == 0){
+        printf("No perf counter is available (see /proc/sys/kernel/perf_event_paranoid)\n");
+        perf = 0;
+    }
 
     // Create the server socket
     if ((server_sd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) == -1){
@@ -185,12 +1467,59 @@ int main(int argc, char *argv[])
         return -1;
     }
 
-    // Initialize the mutex and condition variable
-    pthread_mutex_init(&mutex_message, NULL);
-    pthread_cond_init(&cond_message, NULL);
+    // Initialize the lock of the storage (the writers go first, so that a steady flow of reads cannot starve them)
+    pthread_rwlockattr_t lock_attr;
+    pthread_rwlockattr_init(&lock_attr);
+    pthread_rwlockattr_setkind_np(&lock_attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&lock_storage, &lock_attr);
     pthread_attr_init(&t_attr); // IMPORTANT: Initialize the thread attributes (the thread creation failed sometimes without this line)
     pthread_attr_setdetachstate(&t_attr, PTHREAD_CREATE_DETACHED);
 
+    // Start the versions of the tuples after the ones that a previous run could have given
+    versiones_start();
+
+    // Start the statistics and the threads that export them
+    estadisticas_init(op_names, sizeof(op_names) / sizeof(op_names[0]));
+    if (metrics_file != NULL && pthread_create(&thread_id, &t_attr, write_metrics_file, NULL) != 0){
+        perror("Error creating the metrics thread\n");
+        return -1;
+    }
+    if (metrics_port != 0 && pthread_create(&thread_id, &t_attr, serve_metrics, NULL) != 0){
+        perror("Error creating the metrics thread\n");
+        return -1;
+    }
+
+    // Start the thread that deletes the keys whose TTL has passed
+    if (pthread_create(&thread_id, &t_attr, expire_keys, NULL) != 0){
+        perror("Error creating the expiration thread\n");
+        return -1;
+    }
+
+    // Allocate the connection slots and start the workers
+    Conexion *connections = calloc(max_connections, sizeof(Conexion));
+    free_connections = malloc(max_connections * sizeof(Conexion *));
+    pending = malloc(max_connections * sizeof(Conexion *));
+    Worker *workers = calloc(n_workers, sizeof(Worker));
+    if (connections == NULL || free_connections == NULL || pending == NULL || workers == NULL){
+        perror("Error allocating memory\n");
+        return -1;
+    }
+    for (int i = 0; i < max_connections; i++)
+    {
+        free_connections[n_free++] = &connections[i];
+    }
+    for (int i = 0; i < COALESCE_SLOTS; i++)
+    {
+        pthread_mutex_init(&in_flight[i].mutex, NULL);
+    }
+    for (int i = 0; i < n_workers; i++)
+    {
+        if (pthread_create(&thread_id, &t_attr, run_worker, &workers[i]) != 0){
+            perror("Error creating the worker thread\n");
+            return -1;
+        }
+    }
+
     // Listen for connections
     if (listen(server_sd, SOMAXCONN) == -1){    // SOMAXCONN is the maximum number of pending connections (1024 by default)
         perror("Error listening for connections\n");
@@ -201,59 +1530,89 @@ int main(int argc, char *argv[])
     // Keep listening for requests
     while (1)
     {
-        Request request;
+        // Take a free slot for the next request
+        Conexion *connection = get_connection();
+        Request *request = &connection->request;
+
+        LOG_DEBUG("Waiting for a connection...");
 
-        printf("Waiting for a connection...\n");
+        // Wait for a client or for SIGINT/SIGTERM (the signal handler writes to stop_pipe)
+        struct pollfd fds[2] = {{server_sd, POLLIN, 0}, {stop_pipe[0], POLLIN, 0}};
+        int ready;
+        do
+        {
+            ready = poll(fds, 2, -1);
+        } while (ready == -1 && errno == EINTR && !stopping);
+        if (stopping){
+            stop_server();
+        }
 
         // Connect with the client
-        client_sd = accept(server_sd, (struct sockaddr *)&client_addr, &client_addr_len);
+        int client_sd = accept(server_sd, (struct sockaddr *)&client_addr, &client_addr_len);
         if (client_sd == -1){
-            perror("Error accepting the connection\n");
-            close(client_sd);
+            LOG_PERROR("Error accepting the connection");
+            release_connection(connection);
             continue;
         }
+        uint64_t arrival = now_ns();
+        estadisticas_connections(1);
 
         // printf("Connection accepted from IP: %s, Port: %d\n", inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
 
         // Receive the request
-        if (readLine(client_sd, buffer, sizeof(buffer)) == -1){
-            perror("Error receiving the request\n");
+        if (readLine(client_sd, connection->buffer, sizeof(connection->buffer)) == -1){
+            LOG_PERROR("Error receiving the request");
             close(client_sd);
+            estadisticas_connections(-1);
+            release_connection(connection);
             continue;
         }
 
-        // printf("Request received: %s\n", buffer);
+        // printf("Request received: %s\n", connection->buffer);
+        if (slow_log != NULL){
+            request->received = now_ns();
+        }
+
+        // Capture the request before parse_request() splits it
+        if (capture && connection->buffer[0] != '\0'){
+            traza_write(&trace, now_ns(), connection->buffer, strlen(connection->buffer));
+        }
 
         // Parse the request
-        if (parse_request(buffer, &request) == -1){
-            perror("Error parsing the request\n");
+        LecturaPerf perf_start, perf_end;
+        if (perf){
+            perf_read(&perf_main, &perf_start);
+        }
+        int parsed = parse_request(connection->buffer, request);
+        if (perf){
+            perf_read(&perf_main, &perf_end);
+            pthread_mutex_lock(&mutex_perf);
+            perf_acc_add(&perf_parse, &perf_start, &perf_end);
+            pthread_mutex_unlock(&mutex_perf);
+        }
+        if (parsed == -1){
+            LOG_WARN("Malformed request");
+            sendMessage(client_sd, "-1", 3);    // Let the client know that the request was malformed
             close(client_sd);
+            estadisticas_connections(-1);
+            estadisticas_malformed();
+            release_connection(connection);
             continue;
         }
 
         // printf("Request parsed");
-
-        // Copy the client_sd to the request
-        request.client_sd = client_sd;
-
-        // printf("Request received: op = %d, key = %d, value1 = %s, N_value2 = %d\n", request.op, request.key, request.value1, request.N_value2);
-
-        // Create a new thread to process the request
-        if (pthread_create(&thread_id, &t_attr, (void *)process_request, &request) != 0){
-            perror("Error creating the thread\n");
-            continue;
+        if (slow_log != NULL){
+            request->parsed = now_ns();
         }
 
-        // printf("Thread created\n");
+        // Copy the client_sd and the arrival time to the request
+        request->client_sd = client_sd;
+        request->arrival = arrival;
 
-        // Lock the mutex
-        pthread_mutex_lock(&mutex_message);
-        while (!processed_request)
-        {
-            pthread_cond_wait(&cond_message, &mutex_message);
-        }
-        processed_request = 0;
-        pthread_mutex_unlock(&mutex_message);
-        // printf("Request processed\n");
+        // printf("Request received: op = %d, key = %d, value1 = %s, N_value2 = %d\n", request->op, request->key, request->value1, request->N_value2);
+
+        // Queue the request for the workers (the worker releases the slot once the response has been sent)
+        estadisticas_queue(1);
+        queue_request(connection);
     }
 }